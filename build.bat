@@ -17,7 +17,9 @@ if %errorlevel% neq 0 exit /b %errorlevel%
 
 
 echo 🔧 Compiling truss analysis engine...
-gcc src\truss.c -o truss_engine.exe -lm
+gcc -O2 -fno-math-errno -fopenmp -static src\truss.c src\truss_lib.c -o truss_engine.exe -lm -lpsapi
+gcc -O2 -fno-math-errno -fopenmp -static -shared -DTRUSS_BUILD_DLL src\truss_lib.c -o truss.dll -lm -lpsapi
+gcc -O2 -fno-math-errno -fopenmp -static src\truss_bench.c src\truss_lib.c -o truss_bench.exe -lm -lpsapi
 
 REM Build with Nuitka
 python -m nuitka ^
@@ -29,6 +31,7 @@ python -m nuitka ^
     --include-data-dir=src/assets=assets ^
     --include-data-file=version.py=version.py ^
     --include-data-file=truss_engine.exe=truss_engine.exe ^
+    --include-data-file=truss.dll=truss.dll ^
     --windows-icon-from-ico=src/assets/icon.ico ^
     --output-dir=dist ^
     src/truss.py
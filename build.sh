@@ -6,9 +6,11 @@ rm -rf dist build package
 rm -f truss-*-linux.tar.gz
 mkdir -p dist
 
-# Compile C program
+# Compile C program and the engine library used by the GUI
 echo "🔧 Compiling truss analysis engine..."
-gcc src/truss.c -o dist/truss_engine -lm
+gcc -O2 -fno-math-errno -fopenmp src/truss.c src/truss_lib.c -o dist/truss_engine -lm
+gcc -O2 -fno-math-errno -fopenmp -shared -fPIC -fvisibility=hidden src/truss_lib.c -o dist/libtruss.so -lm
+gcc -O2 -fno-math-errno -fopenmp src/truss_bench.c src/truss_lib.c -o dist/truss_bench -lm
 
 # === Install application dependencies ===
 python3 -m pip install --upgrade pip
@@ -27,6 +29,7 @@ python3 -m nuitka \
   --include-data-dir=src/assets=assets \
   --include-data-file=version.py=version.py \
   --include-data-file=dist/truss_engine=truss_engine \
+  --include-data-file=dist/libtruss.so=libtruss.so \
   --output-dir=dist \
   src/truss.py
 
@@ -1,9 +1,12 @@
 #!/bin/bash
 
-# Compile C program if needed
+# Compile C program and engine library if needed
 if [ ! -f "truss_engine" ]; then
     echo "🔧 Compiling truss analysis engine..."
-    gcc src/truss.c -o truss_engine -lm
+    gcc -O2 -fno-math-errno -fopenmp src/truss.c src/truss_lib.c -o truss_engine -lm
+fi
+if [ ! -f "libtruss.so" ]; then
+    gcc -O2 -fno-math-errno -fopenmp -shared -fPIC -fvisibility=hidden src/truss_lib.c -o libtruss.so -lm
 fi
 
 # Run Python GUI
@@ -0,0 +1,296 @@
+#ifndef TRUSS_H
+#define TRUSS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Truss analysis engine library. All state lives in a TrussContext, so
+// independent contexts can be used from different threads. Functions that
+// can fail return a TrussStatus; the reason is available from
+// truss_error_message() until the next call on the same context.
+
+#if defined(_WIN32) && defined(TRUSS_BUILD_DLL)
+#define TRUSS_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define TRUSS_API __attribute__((visibility("default")))
+#else
+#define TRUSS_API
+#endif
+
+typedef enum {
+    TRUSS_OK = 0,
+    TRUSS_ERROR_IO = -1,          // file cannot be opened, mapped or written
+    TRUSS_ERROR_FORMAT = -2,      // malformed model file
+    TRUSS_ERROR_INVALID = -3,     // bad argument, option or node reference
+    TRUSS_ERROR_MEMORY = -4,
+    TRUSS_ERROR_UNSTABLE = -5,    // stiffness matrix is singular, or a nonlinear load step diverged
+    TRUSS_ERROR_STATE = -6        // call out of order, e.g. results before a solve
+} TrussStatus;
+
+typedef struct {
+    int id;
+    double x, y, z;
+    int constraints[3];   // nonzero where the DOF is fixed
+    double loads[3];
+} TrussNode;
+
+// node1/node2 are indices into the node array
+typedef struct {
+    int id;
+    int node1, node2;
+    double E, A;
+} TrussMember;
+
+typedef enum {
+    TRUSS_COMPRESSION = 0,      // also for members without axial force
+    TRUSS_TENSION = 1
+} TrussMemberStatus;
+
+typedef struct {
+    double force;
+    double stress;
+    double length;
+    int status;           // TrussMemberStatus
+    int reserved;
+} TrussMemberResult;
+
+// Outcome of one variant of a batch analysis. The extremes cover every
+// load case; cases count from 0 and are -1 when there is no extreme.
+typedef struct {
+    int status;                 // TrussStatus of the variant's analysis
+    int node;                   // ID of the node with the largest displacement
+    int displacement_case;
+    int member;                 // ID of the member with the largest stress
+    int stress_case;
+    double max_displacement;    // magnitude of the largest displacement
+    double max_stress;          // stress of largest magnitude, with its sign
+} TrussVariantSummary;
+
+// Phases of an analysis timed by the engine
+typedef enum {
+    TRUSS_PHASE_READ,           // loading the model file or text
+    TRUSS_PHASE_ASSEMBLE,       // stiffness matrix and load vectors
+    TRUSS_PHASE_REDUCE,         // reduced system and its factorization
+    TRUSS_PHASE_SOLVE,          // substitutions or PCG iterations
+    TRUSS_PHASE_REACTIONS,
+    TRUSS_PHASE_MEMBER_FORCES,
+    TRUSS_PHASE_OUTPUT,         // writing results
+    TRUSS_PHASE_COUNT
+} TrussPhase;
+
+// Resources used by one TrussPhase. Allocations count the engine's own
+// model, matrix and result storage; peak_rss is the process's high-water
+// mark when the phase ended.
+typedef struct {
+    double wall_time;           // seconds
+    double cpu_time;            // CPU seconds of all threads of the process
+    long long allocated;        // bytes
+    long long peak_rss;         // bytes, 0 where the platform cannot tell
+} TrussPhaseProfile;
+
+// Linear solver statistics of the latest solve. The matrix and factor
+// describe the factorization in use, which a solve may have reused.
+typedef struct {
+    char solver[8];             // "dense", "sparse" or "pcg"; empty before a solve
+    int n_free;                 // equations of the reduced system
+    int supernodes;             // sparse Cholesky only
+    int iterations;             // PCG: most iterations taken by any load case
+    int reused;                 // 1 if the factorization of an earlier solve was reused
+    int single_precision;       // 1 if the sparse factor is held in single precision
+    int refinements;            // mixed precision: most refinement steps taken by any solve
+    long long matrix_nnz;       // nonzeros of the reduced stiffness, both triangles
+    long long factor_nnz;       // nonzeros of the Cholesky factor, 0 for PCG
+    long long fill_in;          // factor nonzeros beyond the matrix's lower triangle
+    long long factor_bytes;     // memory held by the factorization or PCG setup
+    long long bandwidth;        // half-bandwidth of the reduced stiffness as numbered
+    long long envelope;         // entries between each row's first nonzero and the diagonal
+    double min_pivot;           // smallest and largest Cholesky pivots
+    double max_pivot;
+    double residual;            // largest |F - K D| / |F| of any load case, -1 if not computed
+    double imbalance;           // largest |sum of reactions and loads| relative to their magnitudes
+    double condition;           // 1-norm condition estimate of a single precision factor, 0 if none
+    double backward_error;      // mixed precision: largest |F - K D| / (|K| |D| + |F|), -1 if not refined
+    long long spilled_bytes;    // out-of-core sparse factor: bytes written to its scratch file, 0 in memory
+    long long spill_read_bytes; // bytes read back from it by the factorization and solves since
+    double io_wait;             // seconds spent waiting for the scratch file
+} TrussSolverStats;
+
+// One load step of a geometrically nonlinear analysis
+typedef struct {
+    int load_case;
+    int step;                   // 1 to the number of load steps
+    int iterations;             // Newton iterations to equilibrium
+    int factorizations;         // tangent stiffness factorizations
+    int line_search_trials;     // residual evaluations of line searches beyond the first per iteration
+    int reserved;
+    double load_factor;         // fraction of the load case applied
+    double residual;            // |F - f| / |F| of the out-of-balance force at the end
+    double wall_time;           // seconds
+} TrussStepReport;
+
+// Natural mode of a modal analysis. The participation factor in a
+// direction is phi^T M r for the mass-normalized mode shape phi and r
+// 1 at every free DOF in that direction; its square, the effective
+// modal mass, is given as a fraction of the free DOFs' mass there.
+typedef struct {
+    double frequency;           // Hz
+    double period;              // seconds
+    double circular_frequency;  // rad/s, the square root of the eigenvalue
+    double participation[3];    // in X, Y and Z
+    double mass_ratio[3];       // effective modal mass over the free mass in X, Y and Z
+    double residual;            // Lanczos estimate of the relative residual of the eigenpair
+} TrussMode;
+
+typedef struct TrussContext TrussContext;
+
+TRUSS_API TrussContext *truss_create(void);
+TRUSS_API void truss_destroy(TrussContext *ctx);
+TRUSS_API const char *truss_error_message(const TrussContext *ctx);
+
+// Options by command-line name without the leading dashes: "solver",
+// "precond", "tol", "max-iter", "threads", "decimals", "reorder" ("rcm",
+// the default, or "none" to number equations in node order), "precision"
+// ("double", the default, or "mixed" for a single precision sparse
+// Cholesky factor with iterative refinement), "profile"
+// (1 to also check the residual of direct solves for truss_solver_stats)
+// and "analysis": "linear", "nonlinear" (geometrically nonlinear, with
+// "steps", "newton" ("full" or "modified"), "line-search" (0 or 1),
+// "nl-tol" and "nl-max-iter") or "modal" (natural modes, with "modes",
+// "mass" ("lumped" or "consistent") and "density", the members' mass
+// per unit volume), "condense" (1, the default, to solve substructure
+// instances by static condensation, or 0 to solve them with the model),
+// "memory-budget" (megabytes of sparse Cholesky factor to hold in memory,
+// beyond which it is factored out of core; 0, the default, for no limit)
+// and "scratch-dir" (where an out-of-core factor is written; empty, the
+// default, for the system's temporary directory)
+TRUSS_API int truss_set_option(TrussContext *ctx, const char *name, const char *value);
+
+// Progress messages go to log and warnings and timings to diagnostics;
+// either may be NULL (the default) to keep the library silent
+TRUSS_API void truss_set_streams(TrussContext *ctx, FILE *log, FILE *diagnostics);
+
+// Replace the model with one read from a CSV or binary (.trb) file, or
+// from CSV text in memory
+TRUSS_API int truss_load_file(TrussContext *ctx, const char *filename);
+TRUSS_API int truss_load_text(TrussContext *ctx, const char *text, size_t length);
+
+// Build a model directly. truss_set_nodes starts a new model; xyz, loads
+// and constraints hold 3 values per node and loads may be NULL. Members
+// refer to nodes by ID (node_ids holds 2 per member). Each load case added
+// holds n_loads records of a node ID and 3 load components. As with the
+// input file, the node loads form a case of their own unless load cases
+// are added and the node loads are all zero.
+TRUSS_API int truss_set_nodes(TrussContext *ctx, int n_nodes, const int *ids, const double *xyz,
+                              const int *constraints, const double *loads);
+TRUSS_API int truss_set_members(TrussContext *ctx, int n_members, const int *ids, const int *node_ids,
+                                const double *E, const double *A);
+TRUSS_API int truss_add_load_case(TrussContext *ctx, const char *name, int n_loads,
+                                  const int *node_ids, const double *loads);
+
+// Assemble, solve and recover results for every load case. A nonlinear
+// analysis reports displacements, member forces and lengths, and
+// reactions in the deformed geometry. A modal analysis finds the lowest
+// natural modes instead, and has no load case results.
+TRUSS_API int truss_solve(TrussContext *ctx);
+
+// Session use: the assembled stiffness and its factorization are kept
+// after a solve. When only loads change, the next solve just repeats the
+// substitutions; when member E or A change, the stiffness is patched in
+// place and the factorization is corrected by a low-rank update, or
+// redone once many members have changed. Replacing the nodes, members or
+// whole model starts over.
+TRUSS_API int truss_set_member_properties(TrussContext *ctx, int n_members, const int *ids,
+                                          const double *E, const double *A);
+TRUSS_API int truss_set_node_loads(TrussContext *ctx, int n_loads, const int *node_ids, const double *loads);
+TRUSS_API int truss_set_load_case_loads(TrussContext *ctx, int load_case, int n_loads,
+                                        const int *node_ids, const double *loads);
+
+// Take the loads, load cases and member properties of source, e.g. a
+// reloaded input file, keeping the factorization. Fails with
+// TRUSS_ERROR_INVALID, leaving ctx as it was, if the nodes, supports or
+// member connectivity differ.
+TRUSS_API int truss_update_model(TrussContext *ctx, const TrussContext *source);
+
+// Substructures: repeated modules of the loaded model, each copied into
+// it by instances. A substructures file holds one section per module, a
+// MODULE[, name] header followed by node and member records as in the
+// model file, with module-local IDs and coordinates, and
+//   BOUNDARY, id, ...                the module nodes instances join to
+//   INSTANCE, offset, dx, dy, dz, node_id, ...
+// Each instance adds the module's other (interior) nodes and its members,
+// with offset added to their IDs and the shift to their coordinates, and
+// joins the boundary nodes, in BOUNDARY order, to the given model nodes,
+// which must lie at their shifted positions. A linear solve condenses
+// each instance onto its boundary, reuses that condensation for every
+// instance with the same member stiffness and directions and for later
+// solves, and recovers the interior displacements instance by instance.
+TRUSS_API int truss_load_substructures(TrussContext *ctx, const char *filename);
+
+// Batch analysis of many variants of the loaded model. A variants file
+// holds one section per variant, a VARIANT[, name] header followed by
+// overrides of the loaded model:
+//   NODE, id, x, y, z          node coordinates
+//   MEMBER, id, E, A           member properties
+//   LOAD, id, fx, fy, fz       node-table loads
+// Each variant starts from the loaded model, not from the one before.
+// truss_solve_variants analyzes them concurrently, each worker thread on
+// its own copy of the model; variants that only change loads or a few
+// members reuse the worker's factorization of the loaded model. A variant
+// that fails does not stop the batch; its status is in its summary.
+TRUSS_API int truss_load_variants(TrussContext *ctx, const char *filename);
+TRUSS_API int truss_solve_variants(TrussContext *ctx);
+
+// One summary line per variant in format "table", "csv" or "tsv"
+TRUSS_API int truss_write_variant_summary(TrussContext *ctx, const char *filename, const char *format);
+TRUSS_API int truss_variant_count(const TrussContext *ctx);
+TRUSS_API const char *truss_variant_name(const TrussContext *ctx, int variant);
+TRUSS_API const TrussVariantSummary *truss_variant_summaries(const TrussContext *ctx);   // NULL before solving
+
+// Wall-clock seconds spent in a TrussPhase by the latest load, solve and
+// write; phases a solve skips by reusing earlier work count as 0. Names
+// are lower case identifiers such as "member_forces".
+TRUSS_API double truss_phase_time(const TrussContext *ctx, int phase);
+TRUSS_API const char *truss_phase_name(int phase);
+TRUSS_API const TrussPhaseProfile *truss_phase_profile(const TrussContext *ctx, int phase);  // NULL for no phase
+TRUSS_API const TrussSolverStats *truss_solver_stats(const TrussContext *ctx);
+
+// Load steps of the latest nonlinear analysis, load case by load case;
+// none after a linear one
+TRUSS_API int truss_step_count(const TrussContext *ctx);
+TRUSS_API const TrussStepReport *truss_step_reports(const TrussContext *ctx);   // NULL without steps
+
+// Modes of the latest modal analysis, lowest frequency first, and their
+// mass-normalized shapes, n_modes x n_nodes x 3 like the displacements
+// and 0 at fixed DOFs; none after a static analysis
+TRUSS_API int truss_mode_count(const TrussContext *ctx);
+TRUSS_API const TrussMode *truss_modes(const TrussContext *ctx);         // NULL without modes
+TRUSS_API const double *truss_mode_shapes(const TrussContext *ctx);      // NULL without modes
+
+// Write the phase profiles and solver statistics in format "table" or
+// "json" to filename, or to stderr when filename is NULL
+TRUSS_API int truss_write_profile(TrussContext *ctx, const char *filename, const char *format);
+
+// Write results in format "table", "csv", "tsv" or "binary" to filename,
+// or to stdout when filename is NULL (not allowed for binary). Modal
+// results have no binary form.
+TRUSS_API int truss_write_results(TrussContext *ctx, const char *filename, const char *format);
+
+// Model and results, owned by the context and valid until the model is
+// replaced, solved again or the context is destroyed. Displacements and
+// reactions are n_load_cases x n_nodes x 3, with reactions only at fixed
+// DOFs and 0 elsewhere; member results are n_load_cases x n_members. The
+// equilibrium check holds n_load_cases x 3 sums of reactions and loads in
+// X, Y and Z, zero at exact equilibrium. Results are NULL before truss_solve.
+TRUSS_API int truss_node_count(const TrussContext *ctx);
+TRUSS_API int truss_member_count(const TrussContext *ctx);
+TRUSS_API int truss_load_case_count(const TrussContext *ctx);
+TRUSS_API const char *truss_load_case_name(const TrussContext *ctx, int load_case);
+TRUSS_API int truss_node_loads_case(const TrussContext *ctx);   // case of the node-table loads, or -1
+TRUSS_API const TrussNode *truss_nodes(const TrussContext *ctx);
+TRUSS_API const TrussMember *truss_members(const TrussContext *ctx);
+TRUSS_API const double *truss_displacements(const TrussContext *ctx);
+TRUSS_API const double *truss_reactions(const TrussContext *ctx);
+TRUSS_API const double *truss_equilibrium(const TrussContext *ctx);
+TRUSS_API const TrussMemberResult *truss_member_results(const TrussContext *ctx);
+
+#endif
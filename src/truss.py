@@ -1,7 +1,5 @@
 import os
-import subprocess
 import sys
-import tempfile
 
 from PySide6.QtCore import Qt
 from PySide6.QtGui import QColor, QFont, QIcon, QPalette, QTextCursor
@@ -11,6 +9,9 @@ from PySide6.QtWidgets import (QApplication, QFileDialog, QGroupBox,
                                QStatusBar, QStyle, QTabWidget, QTextEdit,
                                QVBoxLayout, QWidget)
 
+import truss_binding
+import truss_format
+
 def resource_path(relative_path):
     """Get path relative to the executable or script."""
     if getattr(sys, 'frozen', False):
@@ -29,6 +30,9 @@ class TrussAnalysisGUI(QMainWindow):
         # Set application icon
         self.set_app_icon()
 
+        # Engine holding the last successful analysis, kept for saving
+        self.engine = None
+
         # Initialize UI
         self.init_ui()
         self.create_actions()
@@ -180,6 +184,19 @@ class TrussAnalysisGUI(QMainWindow):
 
         layout.addWidget(output_group)
 
+        # Time, memory and solver statistics of the last analysis
+        profile_group = QGroupBox("Performance")
+        profile_layout = QVBoxLayout(profile_group)
+
+        self.profile_display = QTextEdit()
+        self.profile_display.setReadOnly(True)
+        self.profile_display.setFont(QFont("Consolas", 9))
+        self.profile_display.setLineWrapMode(QTextEdit.NoWrap)
+        self.profile_display.setFixedHeight(150)
+        profile_layout.addWidget(self.profile_display)
+
+        layout.addWidget(profile_group)
+
         # Output action buttons
         output_btn_layout = QHBoxLayout()
         self.save_btn = QPushButton("Save Output")
@@ -205,10 +222,18 @@ class TrussAnalysisGUI(QMainWindow):
 
     def browse_file(self):
         file_path, _ = QFileDialog.getOpenFileName(
-            self, "Select CSV File", "", "CSV Files (*.csv);;All Files (*)"
+            self,
+            "Select Model File",
+            "",
+            "CSV Files (*.csv);;Binary Models (*.trb);;All Files (*)",
         )
         if file_path:
             self.file_path.setText(file_path)
+            if file_path.lower().endswith(".trb"):
+                # Binary models are loaded by the engine as they are
+                self.csv_editor.clear()
+                self.status_bar.showMessage(f"Loaded binary model: {os.path.basename(file_path)}")
+                return
             try:
                 with open(file_path, "r") as f:
                     self.csv_editor.setText(f.read())
@@ -239,58 +264,93 @@ class TrussAnalysisGUI(QMainWindow):
         QApplication.processEvents()  # Update UI
 
         try:
-            # Create temp file if using pasted data
+            engine = truss_binding.Truss()
+            engine.set_option("profile", 1)
+        except OSError as e:
+            QMessageBox.critical(self, "Engine Not Found", str(e))
+            self.status_bar.showMessage("Analysis failed")
+            return
+
+        try:
+            # The engine runs in-process; results are numpy views of its
+            # arrays rather than tables parsed from printed output
             if csv_data:
-                with tempfile.NamedTemporaryFile(
-                    mode="w+", suffix=".csv", delete=False
-                ) as tmpfile:
-                    tmpfile.write(csv_data)
-                    input_file = tmpfile.name
+                engine.load_text(csv_data)
             else:
-                input_file = file_path
-
-            # Run the C program
-            exe_path = resource_path("truss_engine")
-            if not os.path.exists(exe_path):
-                # Windows fallback
-                exe_path = resource_path("truss_engine.exe")
-
-            if not os.path.exists(exe_path):
-                QMessageBox.critical(
-                    self,
-                    "Executable Not Found",
-                    f"Could not find truss engine executable at: {exe_path}",
-                )
-                return
-
-            result = subprocess.run(
-                [exe_path, input_file, str(decimal_places)],
-                capture_output=True,
-                text=True,
+                engine.load_file(file_path)
+            read = engine.profile()[0]["read"]
+            # When only loads or member sizes changed since the last run,
+            # re-solve with the factorization the previous engine kept
+            if self.engine and self.engine.update_from(engine):
+                engine.close()
+                engine = self.engine
+            engine.solve()
+            phases, stats = engine.profile()
+            phases["read"] = read
+            self.show_profile(phases, stats)
+            data = engine.data()
+            summary = (
+                f"Found {engine.n_nodes} nodes and {engine.n_members} members\n"
+                f"Successfully read {engine.n_nodes} nodes and {engine.n_members} members\n"
             )
-
-            if result.returncode == 0:
-                self.output_display.setPlainText(result.stdout)
-                self.tabs.setCurrentIndex(1)  # Switch to output tab
-                self.status_bar.showMessage("Analysis completed successfully")
-            else:
-                error_msg = result.stderr if result.stderr else "Unknown error occurred"
-                QMessageBox.critical(
-                    self,
-                    "Analysis Error",
-                    f"Analysis failed with error:\n\n{error_msg}",
-                )
-                self.status_bar.showMessage("Analysis failed")
-
+            if not (len(data.load_case_names) == 1 and data.node_loads_case == 0):
+                summary += f"Found {len(data.load_case_names)} load cases\n"
+            self.output_display.setPlainText(
+                summary + truss_format.format_results(data, decimal_places)
+            )
+            del data
+            if self.engine and self.engine is not engine:
+                self.engine.close()
+            self.engine = engine
+            self.tabs.setCurrentIndex(1)  # Switch to output tab
+            self.status_bar.showMessage("Analysis completed successfully")
+
+        except truss_binding.TrussError as e:
+            if engine is not self.engine:
+                engine.close()
+            QMessageBox.critical(
+                self,
+                "Analysis Error",
+                f"Analysis failed with error:\n\n{e}",
+            )
+            self.status_bar.showMessage("Analysis failed")
         except Exception as e:
+            if engine is not self.engine:
+                engine.close()
             QMessageBox.critical(
                 self, "Error", f"An unexpected error occurred: {str(e)}"
             )
             self.status_bar.showMessage("Error occurred")
-        finally:
-            # Clean up temp file
-            if csv_data and "tmpfile" in locals():
-                os.unlink(input_file)
+
+    def show_profile(self, phases, stats):
+        lines = [f"{'Phase':<14}{'Wall (ms)':>11}{'CPU (ms)':>11}{'Allocated (MB)':>16}{'Peak RSS (MB)':>15}"]
+        for name, phase in phases.items():
+            if name == "output":
+                continue  # the GUI formats results itself
+            lines.append(
+                f"{name:<14}{phase['wall_time'] * 1e3:>11.2f}{phase['cpu_time'] * 1e3:>11.2f}"
+                f"{phase['allocated'] / 1e6:>16.2f}{phase['peak_rss'] / 1e6:>15.1f}"
+            )
+        if stats["solver"]:
+            solver = (f"Solver {stats['solver']}: {stats['n_free']} equations, "
+                      f"{stats['matrix_nnz']} matrix nonzeros")
+            if stats["factor_nnz"]:
+                solver += f", {stats['factor_nnz']} factor nonzeros (fill-in {stats['fill_in']})"
+            else:
+                solver += f", {stats['iterations']} PCG iterations"
+            if stats["residual"] >= 0:
+                solver += f", relative residual {stats['residual']:.2e}"
+            solver += f", equilibrium {stats['imbalance']:.2e}"
+            if stats["reused"]:
+                solver += ", factorization reused"
+            lines.append(solver)
+        self.profile_display.setPlainText("\n".join(lines))
+
+    def closeEvent(self, event):
+        if self.engine:
+            self.engine.close()
+            self.engine = None
+        super().closeEvent(event)
 
     def save_output(self):
         content = self.output_display.toPlainText()
@@ -298,14 +358,20 @@ class TrussAnalysisGUI(QMainWindow):
             QMessageBox.warning(self, "No Output", "There is no output to save")
             return
 
-        file_path, _ = QFileDialog.getSaveFileName(
-            self, "Save Output", "", "Text Files (*.txt);;All Files (*)"
+        file_path, selected_filter = QFileDialog.getSaveFileName(
+            self,
+            "Save Output",
+            "",
+            "Text Files (*.txt);;Binary Results (*.trb);;All Files (*)",
         )
 
         if file_path:
             try:
-                with open(file_path, "w") as f:
-                    f.write(content)
+                if selected_filter.startswith("Binary") or file_path.lower().endswith(".trb"):
+                    self.engine.write_results(file_path, "binary")
+                else:
+                    with open(file_path, "w") as f:
+                        f.write(content)
                 self.status_bar.showMessage(f"Output saved to: {file_path}")
             except Exception as e:
                 QMessageBox.critical(
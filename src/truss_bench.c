@@ -0,0 +1,484 @@
+#include "truss.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Benchmark of the truss analysis library on generated models. Each
+// generator builds a family of trusses whose size is set by one integer;
+// the benchmark picks the size nearest to each target DOF count (10, 100,
+// ... up to --max-dofs), then loads, solves and writes every model and
+// reports the time of each phase, one row per model.
+
+#define BENCH_E 29000.0     // ksi
+#define SPAN_PANELS 16   // panels between supports of the planar trusses
+#define MAX_RUNS 64
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// CSV model text as the engine reads it
+typedef struct {
+    char *data;
+    size_t length, capacity;
+    int n_nodes, n_members;
+    int failed;
+} Model;
+
+typedef struct {
+    const char *name;
+    const char *description;
+    int min_size;
+    long (*dofs)(int size);
+    void (*build)(Model *model, int size);
+} Generator;
+
+typedef struct {
+    const Generator *generator;
+    int size;
+    int n_nodes, n_members;
+    int status;
+    double phase_time[TRUSS_PHASE_COUNT];
+    double total;
+} BenchRun;
+
+static const char *report_file = NULL;
+static const char *report_format = "table";
+static const char *results_format = "table";
+static const char *kinds = NULL;        // comma-separated generator names, NULL for all
+static long min_dofs = 10;
+static long max_dofs = 100000;
+static int repeat = 1;
+
+void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  --models=<list>                 comma-separated generators (default all):\n");
+    printf("                                  warren, pratt, grid, tower\n");
+    printf("  --min-dofs=<n>                  smallest target DOF count (default 10)\n");
+    printf("  --max-dofs=<n>                  largest target DOF count (default 100000)\n");
+    printf("  --repeat=<n>                    best of n runs per model (default 1)\n");
+    printf("  --write=table|csv|tsv|binary    results format timed as the output phase\n");
+    printf("  --format=table|csv|tsv          report format (default table)\n");
+    printf("  --output=<file>                 write the report to a file instead of stdout\n");
+    printf("Other engine options (--solver, --threads, ...) are passed to the engine.\n");
+}
+
+void model_printf(Model *model, const char *format, ...) {
+    if (model->failed) return;
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(model->data + model->length, model->capacity - model->length, format, args);
+        va_end(args);
+        if (length < 0) {
+            model->failed = 1;
+            return;
+        }
+        if ((size_t)length < model->capacity - model->length) {
+            model->length += length;
+            return;
+        }
+        size_t capacity = model->capacity > 0 ? 2 * model->capacity : 1 << 16;
+        while (capacity - model->length <= (size_t)length) capacity *= 2;
+        char *data = realloc(model->data, capacity);
+        if (!data) {
+            model->failed = 1;
+            return;
+        }
+        model->data = data;
+        model->capacity = capacity;
+    }
+}
+
+// Node IDs are 1-based in order of addition; returns the new ID
+int add_node(Model *model, double x, double y, double z, int fix_x, int fix_y, int fix_z,
+             double load_x, double load_y, double load_z) {
+    model_printf(model, "%d, %.6g, %.6g, %.6g, %d, %d, %d, %.6g, %.6g, %.6g\n", model->n_nodes + 1,
+                 x, y, z, fix_x, fix_y, fix_z, load_x, load_y, load_z);
+    return ++model->n_nodes;
+}
+
+void add_member(Model *model, int node1, int node2, double A) {
+    model_printf(model, "%d, %d, %d, %.6g, %.6g\n", model->n_members + 1, node1, node2, BENCH_E, A);
+    model->n_members++;
+}
+
+// Planar Warren truss of n panels: a bottom chord of n + 1 nodes, a top
+// chord of n nodes over the panel midpoints and alternating diagonals.
+// Continuous over spans of SPAN_PANELS panels, pinned at the left end
+// and on rollers elsewhere, with the out-of-plane DOFs fixed.
+long warren_dofs(int n) {
+    return 3L * (2L * n + 1);
+}
+
+void build_warren(Model *model, int n) {
+    for (int i = 0; i <= n; i++) {
+        add_node(model, 60.0 * i, 0.0, 0.0, i == 0, i % SPAN_PANELS == 0 || i == n, 1, 0.0, 0.0, 0.0);
+    }
+    for (int i = 0; i < n; i++) {
+        add_node(model, 60.0 * i + 30.0, 50.0, 0.0, 0, 0, 1, 0.0, -10.0, 0.0);
+    }
+    int top = n + 2;
+    for (int i = 0; i < n; i++) add_member(model, 1 + i, 2 + i, 1.0);
+    for (int i = 0; i + 1 < n; i++) add_member(model, top + i, top + i + 1, 1.2);
+    for (int i = 0; i < n; i++) {
+        add_member(model, 1 + i, top + i, 0.8);
+        add_member(model, top + i, 2 + i, 0.8);
+    }
+}
+
+// Planar Pratt truss of n panels: bottom and top chords of n + 1 nodes,
+// verticals at every panel point and diagonals sloping down towards
+// midspan, loaded along the bottom chord. Supported like the Warren truss.
+long pratt_dofs(int n) {
+    return 6L * (n + 1);
+}
+
+void build_pratt(Model *model, int n) {
+    for (int i = 0; i <= n; i++) {
+        int support = i % SPAN_PANELS == 0 || i == n;
+        add_node(model, 60.0 * i, 0.0, 0.0, i == 0, support, 1, 0.0, support ? 0.0 : -10.0, 0.0);
+    }
+    for (int i = 0; i <= n; i++) add_node(model, 60.0 * i, 60.0, 0.0, 0, 0, 1, 0.0, 0.0, 0.0);
+    int top = n + 2;
+    for (int i = 0; i < n; i++) {
+        add_member(model, 1 + i, 2 + i, 1.5);
+        add_member(model, top + i, top + i + 1, 1.5);
+    }
+    for (int i = 0; i <= n; i++) add_member(model, 1 + i, top + i, 1.0);
+    for (int i = 0; i < n; i++) {
+        int start = i - i % SPAN_PANELS;
+        int span = n - start < SPAN_PANELS ? n - start : SPAN_PANELS;
+        if (2 * (i - start) < span) {
+            add_member(model, top + i, 2 + i, 1.0);
+        } else {
+            add_member(model, 1 + i, top + i + 1, 1.0);
+        }
+    }
+}
+
+// Double-layer space grid, square on square offset: an n x n top layer,
+// an (n - 1) x (n - 1) bottom layer under the top layer's bay centres,
+// chords in both directions in each layer and four web members from
+// every bottom node. Pinned around the top perimeter, loaded at the
+// interior top nodes.
+long grid_dofs(int n) {
+    return 3L * ((long)n * n + (long)(n - 1) * (n - 1));
+}
+
+void build_grid(Model *model, int n) {
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            int edge = i == 0 || j == 0 || i == n - 1 || j == n - 1;
+            add_node(model, 60.0 * i, 60.0 * j, 45.0, edge, edge, edge, 0.0, 0.0, edge ? 0.0 : -5.0);
+        }
+    }
+    for (int j = 0; j + 1 < n; j++) {
+        for (int i = 0; i + 1 < n; i++) {
+            add_node(model, 60.0 * i + 30.0, 60.0 * j + 30.0, 0.0, 0, 0, 0, 0.0, 0.0, 0.0);
+        }
+    }
+    int bottom = n * n + 1;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i + 1 < n; i++) {
+            add_member(model, 1 + j * n + i, 2 + j * n + i, 1.0);
+            add_member(model, 1 + i * n + j, 1 + (i + 1) * n + j, 1.0);
+        }
+    }
+    for (int j = 0; j + 1 < n; j++) {
+        for (int i = 0; i + 2 < n; i++) {
+            add_member(model, bottom + j * (n - 1) + i, bottom + j * (n - 1) + i + 1, 1.0);
+            add_member(model, bottom + i * (n - 1) + j, bottom + (i + 1) * (n - 1) + j, 1.0);
+        }
+    }
+    for (int j = 0; j + 1 < n; j++) {
+        for (int i = 0; i + 1 < n; i++) {
+            int b = bottom + j * (n - 1) + i;
+            add_member(model, b, 1 + j * n + i, 0.6);
+            add_member(model, b, 2 + j * n + i, 0.6);
+            add_member(model, b, 1 + (j + 1) * n + i, 0.6);
+            add_member(model, b, 2 + (j + 1) * n + i, 0.6);
+        }
+    }
+}
+
+// Square lattice tower of n levels: four legs, horizontals and one plan
+// diagonal at every level and X-bracing on all four faces. Fixed at the
+// base, loaded by wind on one face and by a vertical load at the top.
+long tower_dofs(int n) {
+    return 12L * (n + 1);
+}
+
+void build_tower(Model *model, int n) {
+    static const double corner[4][2] = {{-60.0, -60.0}, {60.0, -60.0}, {60.0, 60.0}, {-60.0, 60.0}};
+    for (int k = 0; k <= n; k++) {
+        for (int c = 0; c < 4; c++) {
+            double wind = k > 0 && corner[c][0] < 0.0 ? 2.0 : 0.0;
+            add_node(model, corner[c][0], corner[c][1], 96.0 * k, k == 0, k == 0, k == 0,
+                     wind, 0.0, k == n ? -20.0 : 0.0);
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        int below = 1 + 4 * k;
+        int above = below + 4;
+        for (int c = 0; c < 4; c++) {
+            int next = (c + 1) % 4;
+            add_member(model, below + c, above + c, 2.0);
+            add_member(model, above + c, above + next, 0.8);
+            add_member(model, below + c, above + next, 0.6);
+            add_member(model, below + next, above + c, 0.6);
+        }
+        add_member(model, above, above + 2, 0.6);
+    }
+}
+
+static const Generator generators[] = {
+    {"warren", "planar Warren truss", 1, warren_dofs, build_warren},
+    {"pratt", "planar Pratt truss", 1, pratt_dofs, build_pratt},
+    {"grid", "double-layer space grid", 2, grid_dofs, build_grid},
+    {"tower", "square lattice tower", 1, tower_dofs, build_tower}
+};
+#define N_GENERATORS (int)(sizeof(generators) / sizeof(generators[0]))
+
+// Size whose DOF count is closest to target on a log scale
+int size_for_dofs(const Generator *generator, long target) {
+    int size = generator->min_size;
+    while (generator->dofs(size + 1) <= target) size++;
+    if (generator->dofs(size) < target &&
+        log((double)generator->dofs(size + 1) / target) < log((double)target / generator->dofs(size))) {
+        size++;
+    }
+    return size;
+}
+
+int model_selected(const Generator *generator) {
+    if (!kinds) return 1;
+    size_t length = strlen(generator->name);
+    for (const char *p = kinds; *p; ) {
+        const char *end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == length && strncmp(p, generator->name, n) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+// Load, solve and write one generated model, keeping the fastest of
+// repeat runs
+int run_model(TrussContext *ctx, const Generator *generator, int size, BenchRun *run) {
+    Model model = {0};
+    generator->build(&model, size);
+    if (model.failed) {
+        free(model.data);
+        fprintf(stderr, "Error: Out of memory generating %s model\n", generator->name);
+        return 0;
+    }
+
+    memset(run, 0, sizeof(BenchRun));
+    run->generator = generator;
+    run->size = size;
+    run->n_nodes = model.n_nodes;
+    run->n_members = model.n_members;
+    for (int r = 0; r < repeat; r++) {
+        int status = truss_load_text(ctx, model.data, model.length);
+        if (status == TRUSS_OK) status = truss_solve(ctx);
+        if (status == TRUSS_OK) status = truss_write_results(ctx, NULL_DEVICE, results_format);
+        if (status != TRUSS_OK) {
+            fprintf(stderr, "Warning: %s model of size %d: %s\n", generator->name, size, truss_error_message(ctx));
+            run->status = status;
+            break;
+        }
+        double total = 0.0;
+        for (int p = 0; p < TRUSS_PHASE_COUNT; p++) total += truss_phase_time(ctx, p);
+        if (r == 0 || total < run->total) {
+            run->total = total;
+            for (int p = 0; p < TRUSS_PHASE_COUNT; p++) run->phase_time[p] = truss_phase_time(ctx, p);
+        }
+    }
+    free(model.data);
+    return 1;
+}
+
+void write_header(FILE *out, int threads) {
+    if (strcmp(report_format, "table") == 0) {
+        fprintf(out, "%d threads, results written as %s\n\n", threads, results_format);
+        fprintf(out, "%-7s %8s %9s %9s %10s", "Model", "Size", "Nodes", "Members", "DOFs");
+        for (int p = 0; p < TRUSS_PHASE_COUNT; p++) fprintf(out, " %13s", truss_phase_name(p));
+        fprintf(out, " %13s\n", "total");
+        fprintf(out, "%-7s %8s %9s %9s %10s", "", "", "", "", "");
+        for (int p = 0; p <= TRUSS_PHASE_COUNT; p++) fprintf(out, " %13s", "(s)");
+        fprintf(out, "\n");
+        return;
+    }
+    char sep = strcmp(report_format, "csv") == 0 ? ',' : '\t';
+    fprintf(out, "model%csize%cnodes%cmembers%cdofs%cthreads%cstatus", sep, sep, sep, sep, sep, sep);
+    for (int p = 0; p < TRUSS_PHASE_COUNT; p++) fprintf(out, "%c%s", sep, truss_phase_name(p));
+    fprintf(out, "%ctotal\n", sep);
+}
+
+void write_run(FILE *out, const BenchRun *run, int threads) {
+    long dofs = run->generator->dofs(run->size);
+    if (strcmp(report_format, "table") == 0) {
+        fprintf(out, "%-7s %8d %9d %9d %10ld", run->generator->name, run->size, run->n_nodes, run->n_members, dofs);
+        if (run->status != TRUSS_OK) {
+            fprintf(out, " %13s\n", "failed");
+        } else {
+            for (int p = 0; p < TRUSS_PHASE_COUNT; p++) fprintf(out, " %13.6f", run->phase_time[p]);
+            fprintf(out, " %13.6f\n", run->total);
+        }
+        fflush(out);
+        return;
+    }
+    char sep = strcmp(report_format, "csv") == 0 ? ',' : '\t';
+    fprintf(out, "%s%c%d%c%d%c%d%c%ld%c%d%c%d", run->generator->name, sep, run->size, sep, run->n_nodes,
+            sep, run->n_members, sep, dofs, sep, threads, sep, run->status);
+    for (int p = 0; p < TRUSS_PHASE_COUNT; p++) {
+        if (run->status == TRUSS_OK) {
+            fprintf(out, "%c%.9g", sep, run->phase_time[p]);
+        } else {
+            fputc(sep, out);
+        }
+    }
+    if (run->status == TRUSS_OK) {
+        fprintf(out, "%c%.9g\n", sep, run->total);
+    } else {
+        fprintf(out, "%c\n", sep);
+    }
+    fflush(out);
+}
+
+// Growth of the total time with model size between the two largest
+// models of each generator, as the exponent k of time ~ DOFs^k
+void write_scaling(FILE *out, const BenchRun *runs, int n_runs) {
+    int header = 0;
+    for (int g = 0; g < N_GENERATORS; g++) {
+        const BenchRun *last = NULL, *previous = NULL;
+        for (int r = 0; r < n_runs; r++) {
+            if (runs[r].generator != &generators[g] || runs[r].status != TRUSS_OK) continue;
+            previous = last;
+            last = &runs[r];
+        }
+        if (!previous || previous->total <= 0.0 || last->total <= 0.0) continue;
+        double ratio = (double)last->generator->dofs(last->size) / previous->generator->dofs(previous->size);
+        if (ratio <= 1.0) continue;
+        if (!header) {
+            fprintf(out, "\nScaling of total time with DOFs between the two largest models:\n");
+            header = 1;
+        }
+        fprintf(out, "  %-7s %-24s time ~ DOFs^%.2f\n", generators[g].name, generators[g].description,
+                log(last->total / previous->total) / log(ratio));
+    }
+}
+
+// Parse one --name=value option; returns 0 if it is not recognized
+int parse_option(TrussContext *ctx, const char *arg) {
+    const char *value = strchr(arg, '=');
+    if (!value) return 0;
+
+    char name[32];
+    size_t length = value - (arg + 2);
+    if (length >= sizeof(name)) return 0;
+    memcpy(name, arg + 2, length);
+    name[length] = '\0';
+    value++;
+
+    char *end;
+    if (strcmp(name, "output") == 0) {
+        if (*value == '\0') return 0;
+        report_file = value;
+    } else if (strcmp(name, "format") == 0) {
+        if (strcmp(value, "table") != 0 && strcmp(value, "csv") != 0 && strcmp(value, "tsv") != 0) return 0;
+        report_format = value;
+    } else if (strcmp(name, "write") == 0) {
+        if (strcmp(value, "table") != 0 && strcmp(value, "csv") != 0 &&
+            strcmp(value, "tsv") != 0 && strcmp(value, "binary") != 0) return 0;
+        results_format = value;
+    } else if (strcmp(name, "models") == 0) {
+        kinds = value;
+    } else if (strcmp(name, "min-dofs") == 0) {
+        min_dofs = strtol(value, &end, 10);
+        if (*end != '\0' || min_dofs < 1) return 0;
+    } else if (strcmp(name, "max-dofs") == 0) {
+        max_dofs = strtol(value, &end, 10);
+        if (*end != '\0' || max_dofs < 1) return 0;
+    } else if (strcmp(name, "repeat") == 0) {
+        repeat = (int)strtol(value, &end, 10);
+        if (*end != '\0' || repeat < 1) return 0;
+    } else {
+        return truss_set_option(ctx, name, value) == TRUSS_OK;
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    TrussContext *ctx = truss_create();
+    if (!ctx) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+
+    for (int a = 1; a < argc; a++) {
+        if (strncmp(argv[a], "--", 2) != 0 || !parse_option(ctx, argv[a])) {
+            fprintf(stderr, "Error: Invalid option %s\n", argv[a]);
+            print_usage(argv[0]);
+            truss_destroy(ctx);
+            return 1;
+        }
+        if (strncmp(argv[a], "--threads=", 10) == 0) threads = atoi(argv[a] + 10);
+    }
+    for (int g = 0; g < N_GENERATORS && kinds; g++) {
+        if (model_selected(&generators[g])) break;
+        if (g == N_GENERATORS - 1) {
+            fprintf(stderr, "Error: No known model in --models=%s\n", kinds);
+            truss_destroy(ctx);
+            return 1;
+        }
+    }
+
+    FILE *out = report_file ? fopen(report_file, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Error: Could not open output file %s\n", report_file);
+        truss_destroy(ctx);
+        return 1;
+    }
+
+    BenchRun runs[MAX_RUNS];
+    int n_runs = 0;
+    write_header(out, threads);
+    for (int g = 0; g < N_GENERATORS; g++) {
+        if (!model_selected(&generators[g])) continue;
+        int last_size = -1;
+        for (long target = 10; target <= max_dofs && n_runs < MAX_RUNS; target *= 10) {
+            if (target < min_dofs) continue;
+            int size = size_for_dofs(&generators[g], target);
+            if (size == last_size) continue;
+            last_size = size;
+            if (!run_model(ctx, &generators[g], size, &runs[n_runs])) continue;
+            write_run(out, &runs[n_runs], threads);
+            n_runs++;
+        }
+    }
+    if (strcmp(report_format, "table") == 0) write_scaling(out, runs, n_runs);
+
+    int failed = 0;
+    for (int r = 0; r < n_runs; r++) failed |= runs[r].status != TRUSS_OK;
+    if (report_file && fclose(out) != 0) {
+        fprintf(stderr, "Error: Could not write output file %s\n", report_file);
+        failed = 1;
+    }
+    truss_destroy(ctx);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,441 @@
+"""ctypes binding for the truss engine library (libtruss.so / truss.dll).
+
+The engine runs in-process: models are loaded or built through the C API
+and results are returned as numpy views of the engine's own arrays, so
+nothing is copied or parsed. Views stay valid until the model is
+replaced, solved again or the engine is closed.
+"""
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+import truss_format
+
+# In-memory layouts of TrussNode, TrussMember and TrussMemberResult
+# (truss.h), including the compiler's alignment padding
+NODE = np.dtype([
+    ("id", "i4"),
+    ("xyz", "f8", 3),
+    ("constraints", "i4", 3),
+    ("loads", "f8", 3),
+], align=True)
+
+MEMBER = np.dtype([
+    ("id", "i4"),
+    ("node1", "i4"),
+    ("node2", "i4"),
+    ("E", "f8"),
+    ("A", "f8"),
+], align=True)
+
+# status is 1 for tension, 0 for compression
+MEMBER_RESULT = np.dtype([
+    ("force", "f8"),
+    ("stress", "f8"),
+    ("length", "f8"),
+    ("status", "i4"),
+    ("reserved", "i4"),
+], align=True)
+
+# Number of TrussPhase values (truss.h)
+PHASE_COUNT = 7
+
+PHASE_PROFILE = np.dtype([
+    ("wall_time", "f8"),
+    ("cpu_time", "f8"),
+    ("allocated", "i8"),
+    ("peak_rss", "i8"),
+], align=True)
+
+SOLVER_STATS = np.dtype([
+    ("solver", "S8"),
+    ("n_free", "i4"),
+    ("supernodes", "i4"),
+    ("iterations", "i4"),
+    ("reused", "i4"),
+    ("single_precision", "i4"),
+    ("refinements", "i4"),
+    ("matrix_nnz", "i8"),
+    ("factor_nnz", "i8"),
+    ("fill_in", "i8"),
+    ("factor_bytes", "i8"),
+    ("bandwidth", "i8"),
+    ("envelope", "i8"),
+    ("min_pivot", "f8"),
+    ("max_pivot", "f8"),
+    ("residual", "f8"),
+    ("imbalance", "f8"),
+    ("condition", "f8"),
+    ("backward_error", "f8"),
+    ("spilled_bytes", "i8"),
+    ("spill_read_bytes", "i8"),
+    ("io_wait", "f8"),
+], align=True)
+
+VARIANT_SUMMARY = np.dtype([
+    ("status", "i4"),
+    ("node", "i4"),
+    ("displacement_case", "i4"),
+    ("member", "i4"),
+    ("stress_case", "i4"),
+    ("max_displacement", "f8"),
+    ("max_stress", "f8"),
+], align=True)
+
+STEP_REPORT = np.dtype([
+    ("load_case", "i4"),
+    ("step", "i4"),
+    ("iterations", "i4"),
+    ("factorizations", "i4"),
+    ("line_search_trials", "i4"),
+    ("reserved", "i4"),
+    ("load_factor", "f8"),
+    ("residual", "f8"),
+    ("wall_time", "f8"),
+], align=True)
+
+MODE = np.dtype([
+    ("frequency", "f8"),
+    ("period", "f8"),
+    ("circular_frequency", "f8"),
+    ("participation", "f8", (3,)),
+    ("mass_ratio", "f8", (3,)),
+    ("residual", "f8"),
+], align=True)
+
+LIBRARY_NAMES = ("libtruss.so", "libtruss.dylib", "truss.dll")
+
+
+class TrussError(RuntimeError):
+    """Raised when an engine call fails; status is the TrussStatus code."""
+
+    def __init__(self, status, message):
+        super().__init__(message)
+        self.status = status
+
+
+def library_dir():
+    if getattr(sys, "frozen", False):
+        return os.path.dirname(sys.executable)
+    return os.path.dirname(os.path.abspath(__file__))
+
+
+def find_library():
+    """Path of the engine library next to the application, or None."""
+    for directory in (library_dir(), os.path.dirname(library_dir())):
+        for name in LIBRARY_NAMES:
+            path = os.path.join(directory, name)
+            if os.path.exists(path):
+                return path
+    return None
+
+
+def load_library(path=None):
+    path = path or find_library()
+    if path is None:
+        raise OSError(f"Could not find the truss engine library ({', '.join(LIBRARY_NAMES)}) "
+                      f"in {library_dir()}")
+    lib = ctypes.CDLL(path)
+
+    ctx = ctypes.c_void_p
+    int_p = ctypes.POINTER(ctypes.c_int)
+    double_p = ctypes.POINTER(ctypes.c_double)
+    signatures = {
+        "truss_create": (ctx, []),
+        "truss_destroy": (None, [ctx]),
+        "truss_error_message": (ctypes.c_char_p, [ctx]),
+        "truss_set_option": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_char_p]),
+        "truss_load_file": (ctypes.c_int, [ctx, ctypes.c_char_p]),
+        "truss_load_text": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_size_t]),
+        "truss_set_nodes": (ctypes.c_int, [ctx, ctypes.c_int, int_p, double_p, int_p, double_p]),
+        "truss_set_members": (ctypes.c_int, [ctx, ctypes.c_int, int_p, int_p, double_p, double_p]),
+        "truss_add_load_case": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_int, int_p, double_p]),
+        "truss_solve": (ctypes.c_int, [ctx]),
+        "truss_set_member_properties": (ctypes.c_int, [ctx, ctypes.c_int, int_p, double_p, double_p]),
+        "truss_set_node_loads": (ctypes.c_int, [ctx, ctypes.c_int, int_p, double_p]),
+        "truss_set_load_case_loads": (ctypes.c_int, [ctx, ctypes.c_int, ctypes.c_int, int_p, double_p]),
+        "truss_update_model": (ctypes.c_int, [ctx, ctx]),
+        "truss_load_substructures": (ctypes.c_int, [ctx, ctypes.c_char_p]),
+        "truss_load_variants": (ctypes.c_int, [ctx, ctypes.c_char_p]),
+        "truss_solve_variants": (ctypes.c_int, [ctx]),
+        "truss_write_variant_summary": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_char_p]),
+        "truss_variant_count": (ctypes.c_int, [ctx]),
+        "truss_variant_name": (ctypes.c_char_p, [ctx, ctypes.c_int]),
+        "truss_variant_summaries": (ctypes.c_void_p, [ctx]),
+        "truss_write_results": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_char_p]),
+        "truss_phase_time": (ctypes.c_double, [ctx, ctypes.c_int]),
+        "truss_phase_name": (ctypes.c_char_p, [ctypes.c_int]),
+        "truss_phase_profile": (ctypes.c_void_p, [ctx, ctypes.c_int]),
+        "truss_solver_stats": (ctypes.c_void_p, [ctx]),
+        "truss_step_count": (ctypes.c_int, [ctx]),
+        "truss_step_reports": (ctypes.c_void_p, [ctx]),
+        "truss_mode_count": (ctypes.c_int, [ctx]),
+        "truss_modes": (ctypes.c_void_p, [ctx]),
+        "truss_mode_shapes": (ctypes.c_void_p, [ctx]),
+        "truss_write_profile": (ctypes.c_int, [ctx, ctypes.c_char_p, ctypes.c_char_p]),
+        "truss_node_count": (ctypes.c_int, [ctx]),
+        "truss_member_count": (ctypes.c_int, [ctx]),
+        "truss_load_case_count": (ctypes.c_int, [ctx]),
+        "truss_load_case_name": (ctypes.c_char_p, [ctx, ctypes.c_int]),
+        "truss_node_loads_case": (ctypes.c_int, [ctx]),
+        "truss_nodes": (ctypes.c_void_p, [ctx]),
+        "truss_members": (ctypes.c_void_p, [ctx]),
+        "truss_displacements": (ctypes.c_void_p, [ctx]),
+        "truss_reactions": (ctypes.c_void_p, [ctx]),
+        "truss_equilibrium": (ctypes.c_void_p, [ctx]),
+        "truss_member_results": (ctypes.c_void_p, [ctx]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    return lib
+
+
+def _view(address, dtype, count):
+    """numpy view of count records of dtype at a C address, without copying."""
+    if not address or count == 0:
+        return np.zeros(0, dtype=dtype)
+    buffer = (ctypes.c_char * (dtype.itemsize * count)).from_address(address)
+    return np.frombuffer(buffer, dtype=dtype, count=count)
+
+
+def _pointer(array, ctype):
+    return array.ctypes.data_as(ctypes.POINTER(ctype))
+
+
+class Truss:
+    """One engine context: a model, its options and its results."""
+
+    def __init__(self, library=None):
+        self._lib = load_library(library)
+        self._ctx = self._lib.truss_create()
+        if not self._ctx:
+            raise MemoryError("Could not create a truss engine context")
+
+    def close(self):
+        if self._ctx:
+            self._lib.truss_destroy(self._ctx)
+            self._ctx = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def _check(self, status):
+        if status != 0:
+            message = self._lib.truss_error_message(self._ctx).decode("utf-8", "replace")
+            raise TrussError(status, message)
+
+    def set_option(self, name, value):
+        """Set a command-line option by name, e.g. set_option("solver", "pcg")."""
+        self._check(self._lib.truss_set_option(self._ctx, name.encode(), str(value).encode()))
+
+    def load_file(self, path):
+        """Load a CSV or binary (.trb) model file."""
+        self._check(self._lib.truss_load_file(self._ctx, os.fsencode(path)))
+
+    def load_text(self, text):
+        """Load a model from CSV text."""
+        data = text.encode("utf-8")
+        self._check(self._lib.truss_load_text(self._ctx, data, len(data)))
+
+    def set_nodes(self, ids, xyz, constraints, loads=None):
+        """Start a new model from node arrays: ids (n), xyz (n, 3),
+        constraints (n, 3, nonzero where fixed) and optional loads (n, 3)."""
+        ids = np.ascontiguousarray(ids, dtype=np.intc)
+        xyz = np.ascontiguousarray(xyz, dtype=np.double).reshape(len(ids), 3)
+        constraints = np.ascontiguousarray(constraints, dtype=np.intc).reshape(len(ids), 3)
+        loads_p = None
+        if loads is not None:
+            loads = np.ascontiguousarray(loads, dtype=np.double).reshape(len(ids), 3)
+            loads_p = _pointer(loads, ctypes.c_double)
+        self._check(self._lib.truss_set_nodes(
+            self._ctx, len(ids), _pointer(ids, ctypes.c_int), _pointer(xyz, ctypes.c_double),
+            _pointer(constraints, ctypes.c_int), loads_p))
+
+    def set_members(self, ids, node_ids, E, A):
+        """Set the members: ids (m), end node IDs (m, 2), E (m) and A (m)."""
+        ids = np.ascontiguousarray(ids, dtype=np.intc)
+        node_ids = np.ascontiguousarray(node_ids, dtype=np.intc).reshape(len(ids), 2)
+        E = np.ascontiguousarray(E, dtype=np.double)
+        A = np.ascontiguousarray(A, dtype=np.double)
+        self._check(self._lib.truss_set_members(
+            self._ctx, len(ids), _pointer(ids, ctypes.c_int), _pointer(node_ids, ctypes.c_int),
+            _pointer(E, ctypes.c_double), _pointer(A, ctypes.c_double)))
+
+    def add_load_case(self, name, node_ids, loads):
+        """Add a load case of node IDs (k) and load components (k, 3)."""
+        node_ids = np.ascontiguousarray(node_ids, dtype=np.intc)
+        loads = np.ascontiguousarray(loads, dtype=np.double).reshape(len(node_ids), 3)
+        self._check(self._lib.truss_add_load_case(
+            self._ctx, name.encode("utf-8") if name else None, len(node_ids),
+            _pointer(node_ids, ctypes.c_int), _pointer(loads, ctypes.c_double)))
+
+    def solve(self):
+        self._check(self._lib.truss_solve(self._ctx))
+
+    # Changes that keep the factorization of the last solve (see truss.h)
+
+    def set_member_properties(self, ids, E, A):
+        """Change E and A of the members with the given IDs."""
+        ids = np.ascontiguousarray(ids, dtype=np.intc)
+        E = np.ascontiguousarray(E, dtype=np.double)
+        A = np.ascontiguousarray(A, dtype=np.double)
+        self._check(self._lib.truss_set_member_properties(
+            self._ctx, len(ids), _pointer(ids, ctypes.c_int),
+            _pointer(E, ctypes.c_double), _pointer(A, ctypes.c_double)))
+
+    def set_node_loads(self, node_ids, loads):
+        """Change the node-table loads (k, 3) of the given nodes."""
+        node_ids = np.ascontiguousarray(node_ids, dtype=np.intc)
+        loads = np.ascontiguousarray(loads, dtype=np.double).reshape(len(node_ids), 3)
+        self._check(self._lib.truss_set_node_loads(
+            self._ctx, len(node_ids), _pointer(node_ids, ctypes.c_int), _pointer(loads, ctypes.c_double)))
+
+    def set_load_case_loads(self, load_case, node_ids, loads):
+        """Replace the loads of load case index load_case."""
+        node_ids = np.ascontiguousarray(node_ids, dtype=np.intc)
+        loads = np.ascontiguousarray(loads, dtype=np.double).reshape(len(node_ids), 3)
+        self._check(self._lib.truss_set_load_case_loads(
+            self._ctx, load_case, len(node_ids), _pointer(node_ids, ctypes.c_int),
+            _pointer(loads, ctypes.c_double)))
+
+    def update_from(self, other):
+        """Take loads and member properties from another engine holding the
+        same structure. Returns False, changing nothing, if the nodes,
+        supports or connectivity differ."""
+        return self._lib.truss_update_model(self._ctx, other._ctx) == 0
+
+    def load_substructures(self, path):
+        """Add the module instances of a substructures file (see truss.h)
+        to the loaded model."""
+        self._check(self._lib.truss_load_substructures(self._ctx, os.fsencode(path)))
+
+    # Batch analysis of model variants (see truss.h for the file format)
+
+    def load_variants(self, path):
+        self._check(self._lib.truss_load_variants(self._ctx, os.fsencode(path)))
+
+    def solve_variants(self):
+        self._check(self._lib.truss_solve_variants(self._ctx))
+
+    def write_variant_summary(self, path=None, format="table"):
+        self._check(self._lib.truss_write_variant_summary(
+            self._ctx, os.fsencode(path) if path is not None else None, format.encode()))
+
+    @property
+    def variant_names(self):
+        return [
+            self._lib.truss_variant_name(self._ctx, v).decode("utf-8", "replace")
+            for v in range(self._lib.truss_variant_count(self._ctx))
+        ]
+
+    def variant_summaries(self):
+        """VARIANT_SUMMARY view with one record per variant, empty before
+        solve_variants()."""
+        return _view(self._lib.truss_variant_summaries(self._ctx), VARIANT_SUMMARY,
+                     self._lib.truss_variant_count(self._ctx))
+
+    def write_results(self, path=None, format="table"):
+        """Write results as "table", "csv", "tsv" or "binary" to path, or
+        to the process's standard output when path is None."""
+        self._check(self._lib.truss_write_results(
+            self._ctx, os.fsencode(path) if path is not None else None, format.encode()))
+
+    def phase_times(self):
+        """Seconds spent in each phase of the latest load, solve and write,
+        keyed by phase name ("read", "assemble", ... "output")."""
+        return {
+            self._lib.truss_phase_name(p).decode(): self._lib.truss_phase_time(self._ctx, p)
+            for p in range(PHASE_COUNT)
+        }
+
+    def profile(self):
+        """Resources used by each phase of the latest load, solve and write
+        as {name: {"wall_time", "cpu_time", "allocated", "peak_rss"}}, and
+        the solver statistics as a dict (see TrussSolverStats in truss.h)."""
+        phases = {}
+        for p in range(PHASE_COUNT):
+            record = _view(self._lib.truss_phase_profile(self._ctx, p), PHASE_PROFILE, 1)[0]
+            phases[self._lib.truss_phase_name(p).decode()] = {
+                name: record[name].item() for name in PHASE_PROFILE.names
+            }
+        record = _view(self._lib.truss_solver_stats(self._ctx), SOLVER_STATS, 1)[0]
+        stats = {name: record[name].item() for name in SOLVER_STATS.names}
+        stats["solver"] = stats["solver"].decode()
+        return phases, stats
+
+    def step_reports(self):
+        """STEP_REPORT view with one record per load step of the latest
+        nonlinear analysis; empty after a linear one."""
+        return _view(self._lib.truss_step_reports(self._ctx), STEP_REPORT,
+                     self._lib.truss_step_count(self._ctx))
+
+    def modes(self):
+        """MODE view with one record per natural mode of the latest modal
+        analysis, and the (n_modes, n_nodes, 3) mass-normalized shapes."""
+        n_modes = self._lib.truss_mode_count(self._ctx)
+        n_nodes = self._lib.truss_node_count(self._ctx)
+        shapes = _view(self._lib.truss_mode_shapes(self._ctx), np.dtype(np.double), n_modes * n_nodes * 3)
+        return (_view(self._lib.truss_modes(self._ctx), MODE, n_modes),
+                shapes.reshape(n_modes, n_nodes, 3))
+
+    def equilibrium(self):
+        """(n_load_cases, 3) sums of reactions and loads in X, Y and Z,
+        zero at exact equilibrium; empty before solve()."""
+        n_cases = self._lib.truss_load_case_count(self._ctx)
+        address = self._lib.truss_equilibrium(self._ctx)
+        return _view(address, np.dtype(np.double), n_cases * 3 if address else 0).reshape(-1, 3)
+
+    def write_profile(self, path=None, format="table"):
+        """Write the profile as "table" or "json" to path, or to stderr."""
+        self._check(self._lib.truss_write_profile(
+            self._ctx, os.fsencode(path) if path is not None else None, format.encode()))
+
+    @property
+    def n_nodes(self):
+        return self._lib.truss_node_count(self._ctx)
+
+    @property
+    def n_members(self):
+        return self._lib.truss_member_count(self._ctx)
+
+    @property
+    def load_case_names(self):
+        return [
+            self._lib.truss_load_case_name(self._ctx, c).decode("utf-8", "replace")
+            for c in range(self._lib.truss_load_case_count(self._ctx))
+        ]
+
+    def data(self):
+        """Model and results as a truss_format.TrussData of zero-copy views.
+
+        Results are present only after solve(). Member node1/node2 are node
+        indices, as in the binary format.
+        """
+        lib, ctx = self._lib, self._ctx
+        n_nodes = lib.truss_node_count(ctx)
+        n_members = lib.truss_member_count(ctx)
+        n_cases = lib.truss_load_case_count(ctx)
+
+        data = truss_format.TrussData()
+        data.nodes = _view(lib.truss_nodes(ctx), NODE, n_nodes)
+        data.members = _view(lib.truss_members(ctx), MEMBER, n_members)
+        data.load_case_names = self.load_case_names
+        data.node_loads_case = lib.truss_node_loads_case(ctx)
+        displacements = lib.truss_displacements(ctx)
+        if displacements:
+            double = np.dtype(np.double)
+            data.displacements = _view(displacements, double, n_cases * n_nodes * 3).reshape(n_cases, n_nodes, 3)
+            data.reactions = _view(lib.truss_reactions(ctx), double, n_cases * n_nodes * 3).reshape(n_cases, n_nodes, 3)
+            data.member_results = _view(lib.truss_member_results(ctx), MEMBER_RESULT,
+                                        n_cases * n_members).reshape(n_cases, n_members)
+        return data
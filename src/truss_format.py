@@ -0,0 +1,212 @@
+"""Reader and writer for the truss engine's binary model/results format.
+
+The file is a 64-byte header followed by contiguous little-endian arrays
+(see the layout comment in truss_lib.c). Arrays are returned as numpy views
+into a read-only memory map, so loading does not copy or parse anything.
+"""
+import numpy as np
+
+MAGIC = b"TRUSSBIN"
+VERSION = 1
+HAS_RESULTS = 1
+
+HEADER = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("flags", "<u4"),
+    ("n_nodes", "<u4"),
+    ("n_members", "<u4"),
+    ("n_load_cases", "<u4"),
+    ("n_case_loads", "<u4"),
+    ("node_loads_case", "<i4"),
+    ("reserved", "<u4", 7),
+])
+
+NODE = np.dtype([
+    ("id", "<i4"),
+    ("constraints", "<i4", 3),
+    ("xyz", "<f8", 3),
+    ("loads", "<f8", 3),
+])
+
+# node1/node2 are indices into the node array, not node IDs
+MEMBER = np.dtype([
+    ("id", "<i4"),
+    ("node1", "<i4"),
+    ("node2", "<i4"),
+    ("reserved", "<i4"),
+    ("E", "<f8"),
+    ("A", "<f8"),
+])
+
+LOAD_CASE = np.dtype([("name", "S64")])
+
+NODE_LOAD = np.dtype([
+    ("load_case", "<i4"),
+    ("node", "<i4"),
+    ("loads", "<f8", 3),
+])
+
+# status is 1 for tension, 0 for compression
+MEMBER_RESULT = np.dtype([
+    ("force", "<f8"),
+    ("stress", "<f8"),
+    ("length", "<f8"),
+    ("status", "<i4"),
+    ("reserved", "<i4"),
+])
+
+
+class TrussData:
+    """Model arrays and, for results files, per-load-case result arrays.
+
+    displacements and reactions have shape (n_load_cases, n_nodes, 3);
+    member_results has shape (n_load_cases, n_members).
+    """
+
+    def __init__(self):
+        self.nodes = None
+        self.members = None
+        self.load_case_names = []
+        self.case_loads = None
+        self.node_loads_case = 0
+        self.displacements = None
+        self.reactions = None
+        self.member_results = None
+
+    @property
+    def has_results(self):
+        return self.displacements is not None
+
+
+def read(path):
+    """Map a binary model or results file and return a TrussData."""
+    buffer = np.memmap(path, dtype=np.uint8, mode="r")
+    if buffer.size < HEADER.itemsize:
+        raise ValueError(f"{path}: file is truncated")
+    header = np.frombuffer(buffer, dtype=HEADER, count=1)[0]
+    if header["magic"] != MAGIC:
+        raise ValueError(f"{path}: not a truss binary file")
+    if header["version"] != VERSION:
+        raise ValueError(
+            f"{path}: unsupported version {header['version']} (expected {VERSION})"
+        )
+
+    n_nodes = int(header["n_nodes"])
+    n_members = int(header["n_members"])
+    n_cases = int(header["n_load_cases"])
+    n_loads = int(header["n_case_loads"])
+    offset = HEADER.itemsize
+
+    def take(dtype, count):
+        nonlocal offset
+        end = offset + dtype.itemsize * count
+        if end > buffer.size:
+            raise ValueError(f"{path}: file is truncated")
+        array = np.frombuffer(buffer, dtype=dtype, count=count, offset=offset)
+        offset = end
+        return array
+
+    data = TrussData()
+    data.node_loads_case = int(header["node_loads_case"])
+    data.nodes = take(NODE, n_nodes)
+    data.members = take(MEMBER, n_members)
+    data.load_case_names = [
+        name.decode("utf-8", "replace") for name in take(LOAD_CASE, n_cases)["name"]
+    ]
+    data.case_loads = take(NODE_LOAD, n_loads)
+    if header["flags"] & HAS_RESULTS:
+        data.displacements = take(np.dtype("<f8"), n_cases * n_nodes * 3).reshape(n_cases, n_nodes, 3)
+        data.reactions = take(np.dtype("<f8"), n_cases * n_nodes * 3).reshape(n_cases, n_nodes, 3)
+        data.member_results = take(MEMBER_RESULT, n_cases * n_members).reshape(n_cases, n_members)
+    return data
+
+
+def write_model(path, nodes, members, load_case_names=("Node loads",), case_loads=None,
+                node_loads_case=0):
+    """Write a model file the engine can analyze directly.
+
+    nodes, members and case_loads are arrays (or sequences of tuples)
+    matching NODE, MEMBER and NODE_LOAD.
+    """
+    nodes = np.asarray(nodes, dtype=NODE)
+    members = np.asarray(members, dtype=MEMBER)
+    if case_loads is None:
+        case_loads = np.zeros(0, dtype=NODE_LOAD)
+    case_loads = np.asarray(case_loads, dtype=NODE_LOAD)
+    names = np.array([name.encode("utf-8")[:63] for name in load_case_names], dtype=LOAD_CASE)
+
+    header = np.zeros(1, dtype=HEADER)
+    header["magic"] = MAGIC
+    header["version"] = VERSION
+    header["n_nodes"] = len(nodes)
+    header["n_members"] = len(members)
+    header["n_load_cases"] = len(names)
+    header["n_case_loads"] = len(case_loads)
+    header["node_loads_case"] = node_loads_case
+
+    with open(path, "wb") as f:
+        for array in (header, nodes, members, names, case_loads):
+            f.write(array.tobytes())
+
+
+def _format_number(value, decimals):
+    return "0" if abs(value) < 1e-10 else f"{value:.{decimals}f}"
+
+
+def _is_numeric(text):
+    return bool(text) and (text[0].isdigit() or text[0] in "+-") and all(
+        ch.isdigit() or ch in ".eE+-" for ch in text[1:]
+    )
+
+
+def _table(title, rows):
+    widths = [max(3, max(len(row[j]) for row in rows)) for j in range(len(rows[0]))]
+    border = "+" + "+".join("-" * (w + 2) for w in widths) + "+"
+    lines = ["", f"{title}:", border]
+    for i, row in enumerate(rows):
+        cells = [
+            f" {cell:>{w}} " if _is_numeric(cell) else f" {cell:<{w}} "
+            for cell, w in zip(row, widths)
+        ]
+        lines.append("|" + "|".join(cells) + "|")
+        if i == 0:
+            lines.append(border)
+    lines.append(border)
+    return "\n".join(lines) + "\n"
+
+
+def format_results(data, decimals):
+    """Render results as the engine's ASCII tables."""
+    out = []
+    labelled = not (len(data.load_case_names) == 1 and data.node_loads_case == 0)
+    ids = [str(i) for i in data.nodes["id"]]
+    member_ids = [str(i) for i in data.members["id"]]
+    constrained = np.flatnonzero(data.nodes["constraints"].any(axis=1))
+    for c, name in enumerate(data.load_case_names):
+        if labelled:
+            out.append(f"\nLOAD CASE {c + 1}: {name}\n")
+        disp = data.displacements[c]
+        rows = [["Node", "DX (in)", "DY (in)", "DZ (in)"]]
+        rows += [[ids[i]] + [_format_number(v, decimals) for v in disp[i]] for i in range(len(ids))]
+        out.append(_table("NODE DISPLACEMENTS", rows))
+        if len(constrained):
+            react = data.reactions[c]
+            rows = [["Node", "RX (kips)", "RY (kips)", "RZ (kips)"]]
+            rows += [[ids[i]] + [_format_number(v, decimals) for v in react[i]] for i in constrained]
+            out.append(_table("NODE REACTIONS", rows))
+        if len(member_ids):
+            res = data.member_results[c]
+            rows = [["Member", "Force (kips)", "Stress (ksi)", "Status", "Length (in)"]]
+            rows += [
+                [
+                    member_ids[m],
+                    _format_number(res["force"][m], decimals),
+                    _format_number(res["stress"][m], decimals),
+                    "Tension" if res["status"][m] else "Compression",
+                    _format_number(res["length"][m], decimals),
+                ]
+                for m in range(len(member_ids))
+            ]
+            out.append(_table("MEMBER FORCES AND STRESSES", rows))
+    return "".join(out)
@@ -0,0 +1,7880 @@
+#include "truss.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <float.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#define TOL 1e-12
+#define DENSE_SOLVER_MAX_DOFS 500  // larger reduced systems use sparse Cholesky
+#define ND_LEAF_SIZE 16            // nested dissection stops below this many nodes
+#define SOLVE_BLOCK_RHS 16         // right-hand sides per blocked triangular solve
+#define DENSE_TILE 64              // tile size of the blocked dense Cholesky
+#define INPUT_CHUNK_BYTES (4 << 20)  // input is parsed in chunks of about this size
+#define LOW_RANK_MAX_MEMBERS 16    // more changed members than this trigger a refactorization
+#define LOW_RANK_PIVOT_TOL 1e-8    // smaller relative pivots in a low-rank update refactor instead
+#define EQUILIBRIUM_TOL 1e-6       // larger relative imbalance of loads and reactions is reported as a warning
+#define ARENA_BLOCK_BYTES (64 << 10)  // smallest block an arena allocates
+#define ARENA_HEADER 64            // block header, padded so allocations stay aligned
+#define MEMBER_BATCH 1024          // members per SIMD kernel call in geometry and force recovery
+#define NEWTON_STALL_RATIO 0.5     // modified Newton refactors after an iteration reducing the residual less than this
+#define LINE_SEARCH_RATIO 0.5      // line search stops once the residual along a correction falls to this fraction
+#define LINE_SEARCH_TRIALS 5       // most extra residual evaluations of one line search
+#define LINE_SEARCH_MIN_STEP 0.1   // smallest fraction of a Newton correction a line search takes
+#define LIMIT_POINT_DEPTH 5        // bisections of a converged load step checked for negative stiffness
+#define LIMIT_POINT_TOL 1e-10      // relative drop of the members' resistance along a load step that marks a limit point
+#define MIXED_MAX_CONDITION 1e6    // stiffness with a larger condition estimate is factored in double even when mixed
+#define MIXED_MAX_REFINEMENTS 30   // refinement steps of a mixed precision solve before falling back to double
+#define MIXED_STALL_RATIO 0.5      // a refinement step must reduce the backward error at least this much
+#define LANCZOS_BLOCK 4            // vectors per block Lanczos step, the highest mode multiplicity found reliably
+#define LANCZOS_TOL 1e-8           // modes with a smaller relative Ritz residual have converged
+#define LANCZOS_MIN_BASIS 128      // Lanczos vectors a modal analysis may use before giving up...
+#define LANCZOS_BASIS_PER_MODE 6   // ...or this many per mode requested, if more
+#define LANCZOS_BREAKDOWN 1e-12    // a new Lanczos vector orthogonalized down by this factor is rejected
+#define JACOBI_MAX_SWEEPS 50       // sweeps of the Jacobi eigensolver for the Lanczos tridiagonal
+#define SUBSTRUCTURE_MATCH_TOL 1e-9  // instances whose member stiffness and direction agree this closely share a condensation
+#define SUBSTRUCTURE_POSITION_TOL 1e-6  // largest offset of a boundary node from its module position, relative to the module size
+#define CONDENSED_DOF -2           // dof_map entry of a substructure interior DOF, condensed out of the reduced system
+#define CHOLESKY_OUT_OF_MEMORY -2  // cholesky_factor and dense_cholesky result when an allocation fails
+#define CHOLESKY_SPILL_FAILED -3   // cholesky_factor result when its spill file cannot be written or read
+#define SPILL_SOLVE_RHS 64         // right-hand sides per pass over an out-of-core factor
+#define SPILL_IO_BYTES (1 << 30)   // largest single read or write of a spill file
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Inner dense kernels are compiled for AVX-512, AVX2/FMA and baseline
+// x86-64 and picked at load time where the toolchain supports it
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12 && defined(__x86_64__) && defined(__linux__)
+#define SIMD_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define SIMD_CLONES
+#endif
+
+typedef enum {
+    SOLVER_AUTO,    // dense up to DENSE_SOLVER_MAX_DOFS, sparse above
+    SOLVER_DENSE,
+    SOLVER_SPARSE,
+    SOLVER_PCG
+} SolverType;
+
+typedef enum {
+    PRECOND_BLOCK_JACOBI,   // inverse of each node's free-DOF diagonal block
+    PRECOND_JACOBI
+} PreconditionerType;
+
+typedef enum {
+    FORMAT_TABLE,
+    FORMAT_CSV,
+    FORMAT_TSV,
+    FORMAT_BINARY
+} OutputFormat;
+
+typedef TrussNode Node;
+typedef TrussMember Member;
+typedef TrussMemberResult MemberResult;
+
+// Structure-of-arrays copy of the model with the member geometry derived
+// from it, shared by assembly and recovery. Every quantity has its own
+// contiguous array so per-member loops run in SIMD batches rather than
+// gathering fields out of Node and Member records.
+typedef struct {
+    double *x, *y, *z;      // node coordinates
+    int *node1, *node2;     // member end nodes
+    double *ea;             // E * A
+    double *area;
+    double *length;
+    double *cos[3];         // direction cosines from node1 to node2
+    double *stiffness;      // E * A / L
+} MemberGeometry;
+
+typedef struct {
+    char name[64];
+} LoadCase;
+
+// Nodal load belonging to a load-case section of the input
+typedef struct {
+    int load_case;
+    int node;
+    double loads[3];
+} NodeLoad;
+
+// Bump allocator for memory that lives exactly as long as one stage of
+// an analysis: the assembled model, one solution, one factorization, or
+// scratch space within a step. Every allocation is 64-byte aligned and
+// all of them are dropped together by arena_reset, which keeps the
+// memory for the next run. An arena that outgrows its block chains a new
+// one; on reset a chain is replaced by a single block of the peak size,
+// so repeated analyses of similar models stop calling malloc.
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev;
+    size_t size;        // usable bytes after the header
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *block;  // newest block, NULL until the first allocation
+    size_t in_use;      // bytes handed out since the last reset
+    size_t peak;        // largest in_use so far
+    size_t allocated;   // bytes handed out over the arena's life, for profiling
+} Arena;
+
+// Position an arena can be rolled back to with arena_release
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+    size_t in_use;
+} ArenaMark;
+
+_Static_assert(sizeof(ArenaBlock) <= ARENA_HEADER, "ArenaBlock header");
+
+// Compressed sparse row (CSR) matrix, column indices sorted within each row
+typedef struct {
+    int n;
+    int nnz;
+    int *row_ptr;
+    int *col_idx;
+    double *values;
+} SparseMatrix;
+
+// Dense symmetric matrix in one contiguous, 64-byte aligned row-major
+// block. Rows are padded to a multiple of 8 doubles so every row starts on
+// a cache line; factorization works on the lower triangle only.
+typedef struct {
+    int n;
+    int ld;
+    double *a;
+} DenseMatrix;
+
+// Scratch file an out-of-core Cholesky factor writes its panels to, at
+// their offsets in the factor, with the I/O done through it. The file has
+// no name once created (deleted on close on Windows), so it never
+// outlives the process.
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    int fd;
+#endif
+    int open;
+    long long budget;           // bytes of panels the factor may hold in memory, 0 for no limit
+    const char *dir;            // directory of the file, empty for the system's temporary directory
+    long long bytes_written;
+    long long bytes_read;
+    double io_wait;             // seconds spent waiting for reads and writes
+    int error;                  // errno of a failed read or write, 0 if none
+    const char *failed;         // "create", "write" or "read"
+} SpillFile;
+
+// Supernodal Cholesky factor L of P A P^T. Supernode s owns the
+// consecutive columns super_start[s]..super_start[s+1]-1, which share one
+// row structure and are stored together as a dense column-major panel.
+// An out-of-core factor keeps only the panels from supernode
+// first_resident on in memory; the earlier ones are in its spill file.
+typedef struct {
+    int n;
+    int n_super;
+    int *perm;          // perm[k] = reduced DOF eliminated k-th
+    int *super_start;   // first column of each supernode (n_super + 1)
+    int *col_super;     // supernode owning each column
+    int *struct_ptr;    // offsets into struct_idx (n_super + 1)
+    int *struct_idx;    // ascending panel rows, diagonal block first
+    size_t *panel_ptr;  // offsets into panels (n_super + 1)
+    size_t max_panel;   // entries of the largest panel
+    double *panels;
+    float *panels_single;   // single precision factor: used instead of panels
+    int first_resident;     // first supernode whose panel is in memory
+    size_t resident_offset; // panel_ptr of that panel, where panels starts
+    SpillFile *spill;       // NULL when the whole factor is in memory
+    double min_pivot;       // smallest and largest pivots, the squared diagonal
+    double max_pivot;
+} CholeskyFactor;
+
+// Inverses of the diagonal blocks used as PCG preconditioner: one block
+// per node's free DOFs (block Jacobi), or one per DOF (Jacobi)
+typedef struct {
+    int n_blocks;
+    int *block_start;           // first reduced DOF of each block (n_blocks + 1)
+    double (*block_inv)[9];
+} PcgPreconditioner;
+
+// Factorization of the reduced stiffness kept between solves of one
+// model. Loads can change freely; members whose stiffness differs from
+// factored_stiffness enter the next solve as a low-rank correction.
+// Everything it points to lives in its arena.
+typedef struct {
+    Arena arena;
+    int valid;
+    SolverType solver;          // DENSE, SPARSE or PCG once factored
+    int n_free;
+    int *dof_map;               // full DOF to reduced DOF, -1 if fixed
+    int *fixed_dofs;            // full DOFs with dof_map -1, ascending
+    int condensed;              // substructure interiors condensed out, with dof_map CONDENSED_DOF
+    int n_fixed;
+    int *sparse_perm;           // nested dissection elimination order (sparse only)
+    ArenaMark numbered;         // arena position after the numbering, where a refactorization starts
+    ArenaMark reduced;          // position after K_free, where a mixed precision factor is redone in double
+    DenseMatrix dense;
+    CholeskyFactor sparse;
+    SpillFile spill;            // panels of an out-of-core sparse factor
+    SparseMatrix K_free;        // PCG, and mixed precision for the refinement residuals
+    double *pivot_diag;         // K_free's diagonal before the super-elements were added, NULL if not condensed
+    double stiffness_norm;      // largest absolute row sum of K_free, mixed precision only
+    double condition;           // 1-norm condition estimate of a mixed precision factorization, 0 if none
+    PcgPreconditioner pcg;
+    double *factored_stiffness; // E * A / L of each member when factored
+    TrussSolverStats stats;
+} SolverCache;
+
+// Repeated module of a substructured model. Its nodes are
+// module_nodes[first_node..], the n_boundary boundary nodes, where
+// instances meet the rest of the model, followed by the n_interior ones
+// touched only by the module's own members; its members are
+// module_members[first_member..] with those local node indices as ends.
+typedef struct {
+    char name[64];
+    int n_boundary;
+    int n_interior;
+    int n_members;
+    int first_node;
+    int first_member;
+} Module;
+
+// Copy of a module in the model. Its interior nodes and members were
+// appended to the model in module order at first_node and first_member,
+// and its boundary nodes are instance_boundary[first_boundary..].
+typedef struct {
+    int module;
+    int first_node;
+    int first_member;
+    int first_boundary;
+} Instance;
+
+// Static condensation of an instance onto its boundary. With the
+// instance's stiffness split into the free DOFs of its interior nodes (i)
+// and node_dofs DOFs per boundary node (b), K_ii is factored, X = K_ii^-1
+// K_ib couples the interior to the boundary, and the super-element adds
+// S = -K_bi X to the boundary stiffness the members put in K_global.
+// Instances whose members match the ones it was computed from share it.
+typedef struct {
+    int module;
+    int n_interior;             // free interior DOFs
+    int n_boundary;             // node_dofs per boundary node
+    int *interior_dofs;         // each free interior DOF as 3 * local interior node + direction
+    DenseMatrix factor;         // Cholesky factor of K_ii
+    double *coupling;           // X, n_interior x n_boundary column-major
+    double *schur;              // S, n_boundary x n_boundary
+    double *stiffness;          // E * A / L of the module's members when condensed
+    double *cosines;            // and their direction cosines, 3 per member
+} Condensation;
+
+// Condensed instances, kept between solves until an instance's members
+// change. Everything it points to lives in its arena.
+typedef struct {
+    Arena arena;
+    int valid;
+    int node_dofs;
+    Condensation *condensations;
+    int n_condensations;
+    int *instance_condensation;
+    int computed;               // condensations computed by the latest factorization, 0 if all were reused
+    int condensed_dofs;         // interior DOFs of every instance
+} SubstructureCache;
+
+// Deformed state of a nonlinear analysis: the members in their displaced
+// geometry, sharing the undeformed geometry's connectivity and
+// properties, with the axial force of each and the nodal forces they
+// exert
+typedef struct {
+    MemberGeometry *deformed;
+    double *axial;
+    double *internal;           // total_dofs
+} NonlinearState;
+
+typedef enum {
+    OVERRIDE_NODE,      // coordinates
+    OVERRIDE_MEMBER,    // E and A
+    OVERRIDE_LOAD       // node-table loads
+} OverrideKind;
+
+// One record of a variant, applied to the node or member with index
+// target of the base model
+typedef struct {
+    OverrideKind kind;
+    int target;
+    double values[3];
+} VariantOverride;
+
+// Variant of the loaded model: overrides first..first + n_overrides - 1
+typedef struct {
+    char name[64];
+    int first;
+    int n_overrides;
+    int moves_nodes;
+    int n_member_overrides;
+} Variant;
+
+// Variants head..tail-1 still queued for one batch worker. The owner
+// takes from the head; idle workers steal the back half.
+typedef struct {
+    int head;
+    int tail;
+#ifdef _OPENMP
+    omp_lock_t lock;
+#endif
+} VariantQueue;
+
+// Worker of a batch analysis with its own copy of the model, which keeps
+// its assembled stiffness and factorization from one variant to the next
+typedef struct {
+    TrussContext *ctx;
+    int applied;        // variant whose overrides ctx holds, -1 for none
+    int base_factored;  // ctx->solver holds the factorization of the base model
+    int base_unstable;  // the base model could not be factored
+} BatchWorker;
+
+// Line of the input that is not a record, reported once chunks are merged
+typedef struct {
+    int line;
+    int n_values;
+} SkippedLine;
+
+// Records parsed from one line-aligned slice of the input file. Load
+// records carry the number of LOADCASE headers seen so far in the chunk
+// and line numbers count from the chunk start; both are offset by the
+// preceding chunks when the results are merged in file order.
+typedef struct {
+    const char *begin;
+    const char *end;
+    int n_lines;
+    Node *nodes;
+    int n_nodes, node_capacity;
+    Member *members;
+    int n_members, member_capacity;
+    NodeLoad *loads;
+    int n_loads, load_capacity;
+    LoadCase *sections;
+    int n_sections, section_capacity;
+    SkippedLine *skipped;
+    int n_skipped, skipped_capacity;
+    int failed;         // ran out of memory
+} InputChunk;
+
+// Binary model and results file, all little-endian:
+//
+//   BinaryHeader                             64 bytes
+//   BinaryNode[n_nodes]                      64 bytes each
+//   BinaryMember[n_members]                  32 bytes each
+//   LoadCase[n_load_cases]                   64-byte names
+//   BinaryNodeLoad[n_case_loads]             32 bytes each
+// and, when flags has BINARY_HAS_RESULTS:
+//   double displacements[n_load_cases][n_nodes][3]
+//   double reactions[n_load_cases][n_nodes][3]
+//   BinaryMemberResult[n_load_cases][n_members]  32 bytes each
+//
+// Every array starts on an 8-byte boundary. Members and loads refer to
+// nodes by index into the node array. A results file is also a valid
+// model file; the engine ignores the results when reading it back.
+#define BINARY_MAGIC "TRUSSBIN"
+#define BINARY_VERSION 1
+#define BINARY_HAS_RESULTS 1u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t n_nodes;
+    uint32_t n_members;
+    uint32_t n_load_cases;
+    uint32_t n_case_loads;
+    int32_t node_loads_case;
+    uint32_t reserved[7];
+} BinaryHeader;
+
+typedef struct {
+    int32_t id;
+    int32_t constraints[3];
+    double xyz[3];
+    double loads[3];
+} BinaryNode;
+
+typedef struct {
+    int32_t id;
+    int32_t node1;
+    int32_t node2;
+    int32_t reserved;
+    double E;
+    double A;
+} BinaryMember;
+
+typedef struct {
+    int32_t load_case;
+    int32_t node;
+    double loads[3];
+} BinaryNodeLoad;
+
+typedef struct {
+    double force;
+    double stress;
+    double length;
+    int32_t status;     // 1 tension, 0 compression
+    int32_t reserved;
+} BinaryMemberResult;
+
+_Static_assert(sizeof(BinaryHeader) == 64, "BinaryHeader layout");
+_Static_assert(sizeof(BinaryNode) == 64, "BinaryNode layout");
+_Static_assert(sizeof(BinaryMember) == 32, "BinaryMember layout");
+_Static_assert(sizeof(LoadCase) == 64, "LoadCase layout");
+_Static_assert(sizeof(BinaryNodeLoad) == 32, "BinaryNodeLoad layout");
+_Static_assert(sizeof(BinaryMemberResult) == 32, "BinaryMemberResult layout");
+
+// Node with its coordinate along the current nested dissection axis
+typedef struct {
+    double key;
+    int node;
+} NodeKey;
+
+// Results are formatted straight into one large buffer that is written
+// out with a single fwrite whenever it fills up
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+typedef struct {
+    FILE *file;
+    char *data;
+    size_t length;
+    int failed;
+} OutputBuffer;
+
+// Running extremes of a numeric column. The printed width of a number is
+// nondecreasing in its magnitude (on each side of zero), so formatting
+// the largest and the most negative value gives the exact column width.
+typedef struct {
+    double max_positive;
+    double min_negative;
+    int width;
+} ColumnWidth;
+
+// Running totals a phase's profile is the difference of
+typedef struct {
+    double wall;
+    double cpu;
+    long long allocated;
+} ProfileClock;
+
+// Everything the engine knows about one model and its analysis
+struct TrussContext {
+    // Options
+    SolverType solver_type;
+    PreconditionerType preconditioner;
+    double pcg_tolerance;
+    int pcg_max_iterations;     // 0 selects 2 x free DOFs
+    int n_threads;              // 0 keeps the OpenMP default
+    int reorder;                // renumber nodes by reverse Cuthill-McKee before solving
+    int mixed_precision;        // sparse Cholesky in single precision with iterative refinement
+    int nonlinear;              // geometrically nonlinear analysis in load steps
+    int load_steps;
+    int modified_newton;        // factor the tangent once per load step instead of every iteration
+    int line_search;
+    double newton_tolerance;    // residual force relative to the applied loads that ends a load step
+    int newton_max_iterations;  // per load step
+    int modal;                  // natural modes instead of a static solution
+    int requested_modes;        // modes a modal analysis extracts, lowest first
+    int consistent_mass;        // consistent instead of lumped member mass
+    double density;             // members' mass per unit volume
+    int condense;               // solve substructure instances by static condensation
+    long long memory_budget;    // bytes of sparse factor held in memory before it goes out of core, 0 for no limit
+    char scratch_dir[256];      // where an out-of-core factor spills, empty for the temporary directory
+    int decimal_places;
+    FILE *log_stream;           // progress messages, NULL for none
+    FILE *diag_stream;          // warnings and timings, NULL for none
+    int profile;                // also check the residual of direct solves
+    char error[256];
+    TrussPhaseProfile phase_profile[TRUSS_PHASE_COUNT];
+    
+    // Model
+    int n_nodes;
+    int n_members;
+    int total_dofs;
+    Node *nodes;
+    Member *members;
+    
+    // Load cases: the node-table load columns form the first case unless
+    // there are other load cases and those columns are all zero
+    LoadCase *load_cases;
+    int n_load_cases;
+    int node_loads_case;        // case holding the node-table loads, -1 if none
+    NodeLoad *case_loads;
+    int n_case_loads;
+    
+    // Open-addressing hash table from node ID to index into nodes[], -1
+    // for empty slots; node_index_mask + 1 is its power-of-two size
+    int *node_index;
+    unsigned int node_index_mask;
+    
+    // Node adjacency (each node plus every node it shares a member with),
+    // sorted per node; defines the node_dofs x node_dofs block pattern of
+    // K_global. A planar model (every node in one XY plane with Z fixed)
+    // drops the Z rows from K_global and has node_dofs 2, otherwise 3;
+    // load vectors and results keep 3 DOFs per node either way.
+    int *node_adj_ptr;
+    int *node_adj;
+    int node_dofs;
+    
+    // Member geometry, NULL until the stiffness is assembled. Members
+    // grouped by color: members of one color share no node, so
+    // they can be scattered into K_global concurrently, and every entry
+    // receives its contributions in color order whatever the thread count
+    MemberGeometry *member_geometry;
+    int n_member_colors;
+    int *color_ptr;
+    int *color_members;
+    
+    // Member ID lookup, built on first use like node_index
+    int *member_index;
+    unsigned int member_index_mask;
+    
+    // Substructures from truss_load_substructures: modules and the
+    // instances of them expanded into the model, whose interior nodes and
+    // members come after all others
+    Module *modules;
+    int n_modules;
+    Node *module_nodes;
+    int n_module_nodes;
+    Member *module_members;
+    int n_module_members;
+    Instance *instances;
+    int n_instances;
+    int *instance_boundary;
+    SubstructureCache substructures;
+    
+    // Stiffness factorization reused by later solves of the same model
+    SolverCache solver;
+    
+    // Per-analysis memory: model_arena holds the node adjacency, K_global,
+    // member geometry and colors until the model changes; solve_arena the
+    // load vectors and results of one solve; scratch the temporaries of a
+    // single step, released before the step returns
+    Arena model_arena;
+    Arena solve_arena;
+    Arena scratch;
+    
+    // Variants for batch analysis and, once analyzed, one summary and
+    // error message (NULL if it succeeded) per variant
+    Variant *variants;
+    int n_variants;
+    VariantOverride *overrides;
+    int n_overrides;
+    TrussVariantSummary *variant_summaries;
+    char **variant_errors;
+    
+    // Load vectors and results hold one total_dofs (or n_members) slice
+    // per load case, case c starting at offset c * total_dofs
+    SparseMatrix K_global;
+    int stiffness_updated;      // K_global carries in-place member updates
+    double *F_global;
+    double *displacements;
+    double *reactions;
+    double *equilibrium;        // per load case, sums of reactions and loads in X, Y and Z
+    MemberResult *member_results;
+    TrussStepReport *step_reports;  // nonlinear analysis: every load step of every load case
+    int n_step_reports;
+    
+    // Modal analysis: the mass matrix in the pattern of K_global, and the
+    // modes found with their mass-normalized shapes, one total_dofs slice
+    // per mode
+    double *mass;
+    TrussMode *modes;
+    int n_modes;
+    double *mode_shapes;
+    int lanczos_vectors;        // size of the final Lanczos basis
+    int lanczos_steps;          // block steps, each a solve with LANCZOS_BLOCK right-hand sides
+};
+
+// Function prototypes
+int set_error(TrussContext *ctx, int code, const char *format, ...);
+void log_message(TrussContext *ctx, const char *format, ...);
+void log_warning(TrussContext *ctx, const char *format, ...);
+int read_input(TrussContext *ctx, const char *filename);
+int read_csv(TrussContext *ctx, const char *data, size_t size);
+int resolve_node_ids(TrussContext *ctx);
+void update_load_cases(TrussContext *ctx);
+int build_stiffness_pattern(TrussContext *ctx);
+void compute_member_geometry(TrussContext *ctx);
+void member_geometry_kernel(MemberGeometry *g, int begin, int end);
+void member_force_kernel(const MemberGeometry *g, const double *D, MemberResult *results, int begin, int end);
+const char *member_status_name(int status);
+int build_member_colors(TrussContext *ctx);
+int compare_ints(const void *a, const void *b);
+int assemble_loads(TrussContext *ctx);
+int assemble_global_stiffness(TrussContext *ctx);
+int update_member_geometry(TrussContext *ctx);
+void reassemble_stiffness(TrussContext *ctx);
+void scatter_all_members(TrussContext *ctx);
+void scatter_member_stiffness(TrussContext *ctx, int m, double k);
+void scatter_member_tangent(TrussContext *ctx, const MemberGeometry *g, int m, double k, double kg, double *values);
+void scatter_member_tangent2(TrussContext *ctx, const MemberGeometry *g, int m, double k, double kg, double *values);
+void scatter_member_tangent3(TrussContext *ctx, const MemberGeometry *g, int m, double k, double kg, double *values);
+int model_is_planar(const TrussContext *ctx);
+int full_dof(int dof, int node_dofs);
+int apply_boundary_conditions(TrussContext *ctx);
+int compute_reactions(TrussContext *ctx);
+int compute_member_forces(TrussContext *ctx);
+int nonlinear_state(TrussContext *ctx, NonlinearState *nl, Arena *arena);
+void deform_members(TrussContext *ctx, NonlinearState *nl, const double *D);
+void axial_force_kernel(const MemberGeometry *g, const MemberGeometry *d, const double *D, double *axial,
+                        int begin, int end);
+void internal_forces(TrussContext *ctx, NonlinearState *nl);
+void assemble_tangent(TrussContext *ctx, const NonlinearState *nl, double *values);
+double nonlinear_residual(TrussContext *ctx, NonlinearState *nl, const double *F, double load_factor,
+                          const double *D, double *r);
+double line_search(TrussContext *ctx, NonlinearState *nl, const double *F, double load_factor,
+                   double *D, const double *du, double *r, int *trials);
+double strain_energy(const TrussContext *ctx, const NonlinearState *nl);
+int passes_limit_point(TrussContext *ctx, NonlinearState *nl, const double *D0, const double *D1,
+                       const double *f0, double energy0, double *D, double *d);
+int limit_point_interval(TrussContext *ctx, NonlinearState *nl, const double *D0, const double *D1,
+                         const double *d, double *D, const double *t, const double *g, const double *energy,
+                         int depth, double tolerance);
+int solve_nonlinear(TrussContext *ctx);
+void deformed_force_kernel(const MemberGeometry *d, const double *axial, MemberResult *results, int begin, int end);
+int assemble_mass(TrussContext *ctx);
+void scatter_member_mass(TrussContext *ctx, int m, double mass, double *values);
+int solve_modal(TrussContext *ctx);
+void lanczos_random(double *x, int n, uint32_t *seed);
+double lanczos_orthogonalize(const SparseMatrix *M, const double *V, int n_basis, double *w, double *mw, double *coef);
+void lanczos_normalize(const SparseMatrix *M, double *V, int n_basis, int nw, double *MQ, double *R, double *coef,
+                       uint32_t *seed);
+void jacobi_eigen(double *a, int n, double *vectors);
+int write_results(TrussContext *ctx, const char *filename, OutputFormat format);
+int host_is_little_endian();
+int read_binary_model(TrussContext *ctx, const char *data, size_t size);
+int write_binary(TrussContext *ctx, const char *filename);
+void reset_solution(TrussContext *ctx);
+void reset_results(TrussContext *ctx);
+void reset_model(TrussContext *ctx);
+int is_load_case_header(const char *line, const char *end);
+int match_keyword(const char *line, const char *end, const char *keyword);
+int find_node_index(TrussContext *ctx, int node_id);
+int find_member_index(TrussContext *ctx, int member_id);
+void set_member_properties(TrussContext *ctx, int m, double E, double A);
+double parse_number(const char *s, const char **end);
+int parse_csv_record(const char *line, const char *end, double *values, int max_values);
+int map_input(TrussContext *ctx, const char *filename, const char **data, size_t *size);
+void unmap_input(const char *data, size_t size);
+void parse_chunk(InputChunk *chunk);
+double wall_time();
+double cpu_time();
+long long peak_rss();
+long long model_bytes(const TrussContext *ctx);
+ProfileClock profile_clock(const TrussContext *ctx);
+void profile_phase(TrussContext *ctx, int phase, ProfileClock start, ProfileClock end);
+void record_factor_stats(TrussContext *ctx, const SparseMatrix *K_free);
+void record_residual(TrussContext *ctx);
+int profile_threads(const TrussContext *ctx);
+TrussPhaseProfile profile_total(const TrussContext *ctx);
+TrussStepReport step_totals(const TrussContext *ctx);
+int write_profile_table(TrussContext *ctx, FILE *file);
+int write_profile_json(TrussContext *ctx, FILE *file);
+void json_number(FILE *file, const char *name, double value, const char *after);
+void json_phase(FILE *file, const char *name, const TrussPhaseProfile *profile, const char *after);
+int grow_array(void *array, int *capacity, int needed, size_t element_size);
+unsigned int hash_node_id(int node_id);
+int build_node_index(TrussContext *ctx);
+
+// Sparse matrix functions
+int find_adjacent_node(TrussContext *ctx, int i, int j);
+int sparse_extract_free(const SparseMatrix *K, int node_dofs, const int *dof_map, int n_free, SparseMatrix *out,
+                        Arena *arena);
+void sparse_diagonal(const SparseMatrix *A, double *diag);
+int sparse_permute(const SparseMatrix *A, const int *perm, SparseMatrix *C, Arena *arena);
+
+// Arena functions
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+ArenaMark arena_mark(const Arena *arena);
+void arena_release(Arena *arena, ArenaMark mark);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+// Solver functions
+int factor_stiffness(TrussContext *ctx);
+int refactor_stiffness(TrussContext *ctx, const SparseMatrix *K);
+int solve_factored(TrussContext *ctx, const double *F_reduced, double *D_reduced, int nrhs);
+int solve_low_rank(TrussContext *ctx, const int *changed, int n_changed,
+                   const double *F_reduced, double *D_reduced, int nrhs);
+void solver_cache_free(SolverCache *cache);
+int factor_dense(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, DenseMatrix *K_reduced);
+void *aligned_malloc(size_t size);
+void aligned_free(void *ptr);
+int dense_potrf_tile(DenseMatrix *A, int k0, int kb, const double *diag);
+void dense_trsm_tile(DenseMatrix *A, int i0, int ib, int k0, int kb);
+void dense_gemm_tile(double *C, const double *A, const double *B, int ld, int mi, int mj, int mk);
+int dense_cholesky(DenseMatrix *A, const double *pivot_diag, Arena *scratch);
+int dense_cholesky_solve(const DenseMatrix *L, double *B, int nrhs, Arena *scratch);
+void dense_solve_columns(const DenseMatrix *L, double *B, int nrhs, double *X);
+int factor_sparse(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, int single, CholeskyFactor *L);
+void log_spill(TrussContext *ctx, const CholeskyFactor *L);
+int factor_mixed(TrussContext *ctx);
+double condition_estimate(TrussContext *ctx);
+int solve_refined(TrussContext *ctx, const double *F_reduced, double *D_reduced, int nrhs);
+int sparse_order(TrussContext *ctx, const int *dof_map, int *perm);
+int pcg_setup(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, PcgPreconditioner *pre);
+int solve_pcg(TrussContext *ctx, const SparseMatrix *K_free, const PcgPreconditioner *pre,
+              const double *F_reduced, double *D_reduced, int nrhs);
+int report_unstable_dof(TrussContext *ctx, const int *dof_map, int reduced_dof);
+void sparse_multiply(const SparseMatrix *A, const double *x, double *y);
+int compare_node_keys(const void *a, const void *b);
+void dissect_nodes(TrussContext *ctx, int *subset, int count, int *part, int *stamp, NodeKey *keys,
+                   int *order, int *n_ordered);
+int nested_dissection_order(TrussContext *ctx, const int *dof_map, int *order);
+void reduced_envelope(const TrussContext *ctx, const int *dof_map, long long *bandwidth, long long *envelope);
+int free_degree(const TrussContext *ctx, const int *dof_map, int i);
+int node_bfs(const TrussContext *ctx, const int *dof_map, const int *degree, int root, int *mark, int stamp,
+             int *queue, int *count, int *last_level);
+int rcm_order(TrussContext *ctx, const int *dof_map, int *order);
+int cholesky_analyze(const SparseMatrix *C, CholeskyFactor *L, Arena *arena, Arena *scratch);
+int cholesky_factor(const SparseMatrix *A, const double *pivot_diag, const int *perm, int single, CholeskyFactor *L,
+                    SpillFile *spill, Arena *arena, Arena *scratch);
+int cholesky_numeric_double(const SparseMatrix *C, const double *pivot_diag, const int *perm, CholeskyFactor *L,
+                            size_t window, Arena *scratch);
+int cholesky_numeric_single(const SparseMatrix *C, const double *pivot_diag, const int *perm, CholeskyFactor *L,
+                            size_t window, Arena *scratch);
+void cholesky_forward_double(const CholeskyFactor *L, const double *panels, size_t offset, int s0, int s1,
+                             double *X, int nb);
+void cholesky_forward_single(const CholeskyFactor *L, const float *panels, size_t offset, int s0, int s1,
+                             double *X, int nb);
+void cholesky_back_double(const CholeskyFactor *L, const double *panels, size_t offset, int s0, int s1,
+                          double *X, int nb);
+void cholesky_back_single(const CholeskyFactor *L, const float *panels, size_t offset, int s0, int s1,
+                          double *X, int nb);
+void cholesky_substitute_range(const CholeskyFactor *L, const void *panels, size_t offset, int s0, int s1,
+                               double *X, int nb, int forward);
+void cholesky_substitute_spilled(const CholeskyFactor *L, double *X, int nb, void *buffers[2], size_t chunk);
+int spill_open(SpillFile *spill);
+void spill_close(SpillFile *spill);
+int spill_transfer(SpillFile *spill, void *data, size_t bytes, size_t offset, int writing);
+int spill_write(SpillFile *spill, const void *data, size_t bytes, size_t offset);
+int spill_read(SpillFile *spill, void *data, size_t bytes, size_t offset);
+void spill_prefetch(SpillFile *spill, size_t bytes, size_t offset);
+void spill_read_panels(const CholeskyFactor *L, void *buffer, int s0, int s1);
+int spill_status(TrussContext *ctx);
+int cholesky_solve(const CholeskyFactor *L, double *B, int nrhs, Arena *scratch);
+
+// Batch analysis functions
+int read_variants(TrussContext *ctx, const char *data, size_t size);
+void reset_variants(TrussContext *ctx);
+void reset_variant_results(TrussContext *ctx);
+int copy_model(TrussContext *dst, const TrussContext *src);
+int apply_overrides(TrussContext *ctx, const TrussContext *base, const Variant *variant, int restore);
+void analyze_variant(TrussContext *ctx, BatchWorker *worker, int v);
+void summarize_variant(const TrussContext *ctx, TrussVariantSummary *summary);
+int take_variant(VariantQueue *queues, int n_workers, int self);
+void queue_lock(VariantQueue *queue);
+void queue_unlock(VariantQueue *queue);
+int write_variant_summary(TrussContext *ctx, const char *filename, OutputFormat format);
+void write_variant_table(TrussContext *ctx, OutputBuffer *out);
+void write_variant_delimited(TrussContext *ctx, OutputBuffer *out, char separator);
+const char *variant_status_name(int status);
+
+// Substructure functions
+int read_substructures(TrussContext *ctx, const char *data, size_t size);
+void reset_substructures(TrussContext *ctx);
+void substructure_cache_free(SubstructureCache *cache);
+int substructures_condensed(const TrussContext *ctx);
+int condense_substructures(TrussContext *ctx);
+int condense_instance(TrussContext *ctx, int k, Condensation *cond);
+int instance_matches(const TrussContext *ctx, int k, const Condensation *cond);
+void add_super_elements(TrussContext *ctx, SparseMatrix *K_free);
+void condense_loads(TrussContext *ctx, double *F_reduced, int nrhs);
+int recover_interiors(TrussContext *ctx);
+int finish_module(TrussContext *ctx, Module *module, const int *boundary_ids, int n_boundary);
+int boundary_dof(const TrussContext *ctx, const Instance *instance, int p);
+
+// Output functions
+void output_open(OutputBuffer *out, FILE *file);
+void output_flush(OutputBuffer *out);
+int output_close(OutputBuffer *out);
+void output_text(OutputBuffer *out, const char *text, size_t length);
+void output_string(OutputBuffer *out, const char *text);
+void output_repeat(OutputBuffer *out, char c, int count);
+void output_cell(OutputBuffer *out, const char *text, int length, int width, int right_align);
+int format_number(TrussContext *ctx, char *buffer, double value);
+void column_init(ColumnWidth *column, const char *header);
+void column_add(TrussContext *ctx, ColumnWidth *column, double value);
+int column_width(TrussContext *ctx, const ColumnWidth *column);
+int int_width(int value);
+void output_border(OutputBuffer *out, const int *widths, int cols);
+void output_number_cell(TrussContext *ctx, OutputBuffer *out, double value, int width);
+void write_table_results(TrussContext *ctx, OutputBuffer *out, int c);
+void write_node_table(TrussContext *ctx, OutputBuffer *out, const char *title, const char *const headers[4],
+                      const double *values, int constrained_only);
+void write_modal_table(TrussContext *ctx, OutputBuffer *out);
+void write_delimited_results(TrussContext *ctx, OutputBuffer *out, char separator);
+void write_modal_delimited(TrussContext *ctx, OutputBuffer *out, char separator);
+void output_delimited_number(OutputBuffer *out, double value, char separator);
+void output_delimited_name(OutputBuffer *out, const char *name, char separator);
+
+void output_open(OutputBuffer *out, FILE *file) {
+    out->file = file;
+    out->data = malloc(OUTPUT_BUFFER_SIZE);
+    out->length = 0;
+    out->failed = out->data == NULL;
+}
+
+// Write errors are remembered and reported by output_close
+void output_flush(OutputBuffer *out) {
+    if (out->length > 0 && !out->failed && fwrite(out->data, 1, out->length, out->file) != out->length) {
+        out->failed = 1;
+    }
+    out->length = 0;
+}
+
+// Returns 0 if anything failed to be written
+int output_close(OutputBuffer *out) {
+    output_flush(out);
+    free(out->data);
+    out->data = NULL;
+    return !out->failed;
+}
+
+void output_text(OutputBuffer *out, const char *text, size_t length) {
+    if (out->failed) return;
+    if (out->length + length > OUTPUT_BUFFER_SIZE) {
+        output_flush(out);
+        if (length > OUTPUT_BUFFER_SIZE) {
+            if (fwrite(text, 1, length, out->file) != length) out->failed = 1;
+            return;
+        }
+    }
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+}
+
+void output_string(OutputBuffer *out, const char *text) {
+    output_text(out, text, strlen(text));
+}
+
+void output_repeat(OutputBuffer *out, char c, int count) {
+    if (out->failed) return;
+    while (count > 0) {
+        if (out->length == OUTPUT_BUFFER_SIZE) output_flush(out);
+        int n = OUTPUT_BUFFER_SIZE - out->length < (size_t)count ? (int)(OUTPUT_BUFFER_SIZE - out->length) : count;
+        memset(out->data + out->length, c, n);
+        out->length += n;
+        count -= n;
+    }
+}
+
+// " text |" padded to width: numbers right-aligned, text left-aligned
+void output_cell(OutputBuffer *out, const char *text, int length, int width, int right_align) {
+    output_string(out, " ");
+    if (right_align) output_repeat(out, ' ', width - length);
+    output_text(out, text, length);
+    if (!right_align) output_repeat(out, ' ', width - length);
+    output_string(out, " |");
+}
+
+// Format a result value with decimal_places into buffer (at least 400
+// bytes); values below 1e-10 in magnitude print as 0. Returns the length.
+// The output is exactly that of "%.*f": the binary value v = m 2^e is
+// scaled by 10^decimal_places in 128-bit integer arithmetic and rounded
+// half to even, which is what printf does; values too large for that
+// fall back to snprintf.
+int format_number(TrussContext *ctx, char *buffer, double value) {
+    if (fabs(value) < 1e-10) {
+        buffer[0] = '0';
+        buffer[1] = '\0';
+        return 1;
+    }
+#ifdef __SIZEOF_INT128__
+    static const uint64_t pow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+        100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull
+    };
+    int exponent;
+    double fraction = frexp(fabs(value), &exponent);
+    if (isfinite(value) && exponent <= 53 && ctx->decimal_places <= 12) {
+        // |value| = mantissa * 2^(exponent - 53) exactly
+        uint64_t mantissa = (uint64_t)ldexp(fraction, 53);
+        unsigned __int128 scaled = (unsigned __int128)mantissa * pow10[ctx->decimal_places];
+        int shift = 53 - exponent;
+        unsigned __int128 q;
+        if (shift >= 120) {
+            q = 0;
+        } else if (shift == 0) {
+            q = scaled;
+        } else {
+            q = scaled >> shift;
+            unsigned __int128 remainder = scaled - (q << shift);
+            unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+            if (remainder > half || (remainder == half && (q & 1))) q++;
+        }
+        if (q < ((unsigned __int128)1 << 63)) {
+            char digits[24];
+            int n = 0;
+            uint64_t v = (uint64_t)q;
+            do {
+                digits[n++] = (char)('0' + v % 10);
+                v /= 10;
+            } while (v > 0 || n <= ctx->decimal_places);
+            int length = 0;
+            if (value < 0) buffer[length++] = '-';
+            while (n > ctx->decimal_places) buffer[length++] = digits[--n];
+            buffer[length++] = '.';
+            while (n > 0) buffer[length++] = digits[--n];
+            buffer[length] = '\0';
+            return length;
+        }
+    }
+#endif
+    return snprintf(buffer, 400, "%.*f", ctx->decimal_places, value);
+}
+
+void column_init(ColumnWidth *column, const char *header) {
+    column->max_positive = 0.0;
+    column->min_negative = 0.0;
+    column->width = strlen(header) > 3 ? (int)strlen(header) : 3;
+}
+
+void column_add(TrussContext *ctx, ColumnWidth *column, double value) {
+    if (!isfinite(value)) {
+        char buffer[400];
+        int length = format_number(ctx, buffer, value);
+        if (length > column->width) column->width = length;
+    } else if (value > column->max_positive) {
+        column->max_positive = value;
+    } else if (value < column->min_negative) {
+        column->min_negative = value;
+    }
+}
+
+int column_width(TrussContext *ctx, const ColumnWidth *column) {
+    char buffer[400];
+    int width = column->width;
+    int length = format_number(ctx, buffer, column->max_positive);
+    if (length > width) width = length;
+    length = format_number(ctx, buffer, column->min_negative);
+    if (length > width) width = length;
+    return width;
+}
+
+int int_width(int value) {
+    char buffer[16];
+    return snprintf(buffer, sizeof(buffer), "%d", value);
+}
+
+void output_border(OutputBuffer *out, const int *widths, int cols) {
+    output_string(out, "+");
+    for (int j = 0; j < cols; j++) {
+        output_repeat(out, '-', widths[j] + 2);
+        output_string(out, "+");
+    }
+    output_string(out, "\n");
+}
+
+// Finite numbers are right-aligned; nan and inf print as text
+void output_number_cell(TrussContext *ctx, OutputBuffer *out, double value, int width) {
+    char buffer[400];
+    int length = format_number(ctx, buffer, value);
+    output_cell(out, buffer, length, width, isfinite(value));
+}
+
+int write_results(TrussContext *ctx, const char *filename, OutputFormat format) {
+    FILE *file = stdout;
+    if (filename) {
+        file = fopen(filename, "w");
+        if (!file) {
+            return set_error(ctx, TRUSS_ERROR_IO, "Cannot open output file %s: %s", filename, strerror(errno));
+        }
+    } else {
+        fflush(stdout);
+    }
+    OutputBuffer out;
+    output_open(&out, file);
+    
+    if (ctx->modes && (format == FORMAT_CSV || format == FORMAT_TSV)) {
+        write_modal_delimited(ctx, &out, format == FORMAT_CSV ? ',' : '\t');
+    } else if (ctx->modes) {
+        write_modal_table(ctx, &out);
+    } else if (format == FORMAT_CSV || format == FORMAT_TSV) {
+        write_delimited_results(ctx, &out, format == FORMAT_CSV ? ',' : '\t');
+    } else {
+        // Inputs without load-case sections print exactly one unlabelled case
+        int labelled = !(ctx->n_load_cases == 1 && ctx->node_loads_case == 0);
+        for (int c = 0; c < ctx->n_load_cases; c++) {
+            if (labelled) {
+                char header[128];
+                int length = snprintf(header, sizeof(header), "\nLOAD CASE %d: %s\n", c + 1, ctx->load_cases[c].name);
+                output_text(&out, header, length);
+            }
+            write_table_results(ctx, &out, c);
+        }
+    }
+    
+    int ok = output_close(&out);
+    if (filename) {
+        if (fclose(file) != 0) ok = 0;
+    } else {
+        fflush(stdout);
+    }
+    if (!ok) {
+        return set_error(ctx, TRUSS_ERROR_IO, "Could not write results to %s", filename ? filename : "standard output");
+    }
+    if (filename) log_message(ctx, "Results written to %s\n", filename);
+    return TRUSS_OK;
+}
+
+// ASCII tables of one load case. Column widths are worked out from the
+// column extremes first, so every row is formatted once, straight into
+// the output buffer.
+void write_table_results(TrussContext *ctx, OutputBuffer *out, int c) {
+    const double *disp = ctx->displacements + (size_t)c * ctx->total_dofs;
+    const double *react = ctx->reactions + (size_t)c * ctx->total_dofs;
+    const MemberResult *results = ctx->member_results + (size_t)c * ctx->n_members;
+    static const char *const disp_headers[4] = {"Node", "DX (in)", "DY (in)", "DZ (in)"};
+    static const char *const react_headers[4] = {"Node", "RX (kips)", "RY (kips)", "RZ (kips)"};
+    static const char *member_headers[5] = {"Member", "Force (kips)", "Stress (ksi)", "Status", "Length (in)"};
+    char buffer[400];
+    int widths[5];
+    ColumnWidth columns[3];
+    
+    write_node_table(ctx, out, "\nNODE DISPLACEMENTS:\n", disp_headers, disp, 0);
+    write_node_table(ctx, out, "\nNODE REACTIONS:\n", react_headers, react, 1);
+    
+    // Member Forces Table
+    if (ctx->n_members > 0) {
+        widths[0] = 6;
+        widths[3] = 6;
+        column_init(&columns[0], member_headers[1]);
+        column_init(&columns[1], member_headers[2]);
+        column_init(&columns[2], member_headers[4]);
+        for (int m = 0; m < ctx->n_members; m++) {
+            int w = int_width(ctx->members[m].id);
+            if (w > widths[0]) widths[0] = w;
+            w = strlen(member_status_name(results[m].status));
+            if (w > widths[3]) widths[3] = w;
+            column_add(ctx, &columns[0], results[m].force);
+            column_add(ctx, &columns[1], results[m].stress);
+            column_add(ctx, &columns[2], results[m].length);
+        }
+        widths[1] = column_width(ctx, &columns[0]);
+        widths[2] = column_width(ctx, &columns[1]);
+        widths[4] = column_width(ctx, &columns[2]);
+        
+        output_string(out, "\nMEMBER FORCES AND STRESSES:\n");
+        output_border(out, widths, 5);
+        output_string(out, "|");
+        for (int j = 0; j < 5; j++) output_cell(out, member_headers[j], strlen(member_headers[j]), widths[j], 0);
+        output_string(out, "\n");
+        output_border(out, widths, 5);
+        for (int m = 0; m < ctx->n_members; m++) {
+            output_string(out, "|");
+            output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", ctx->members[m].id), widths[0], 1);
+            output_number_cell(ctx, out, results[m].force, widths[1]);
+            output_number_cell(ctx, out, results[m].stress, widths[2]);
+            const char *status = member_status_name(results[m].status);
+            output_cell(out, status, strlen(status), widths[3], 0);
+            output_number_cell(ctx, out, results[m].length, widths[4]);
+            output_string(out, "\n");
+        }
+        output_border(out, widths, 5);
+    }
+}
+
+// Table of 3 values per node: of every node, or with constrained_only
+// of the nodes with a fixed DOF and nothing if there are none
+void write_node_table(TrussContext *ctx, OutputBuffer *out, const char *title, const char *const headers[4],
+                      const double *values, int constrained_only) {
+    char buffer[400];
+    int widths[4];
+    ColumnWidth columns[3];
+    int count = 0;
+    widths[0] = 4;
+    for (int d = 0; d < 3; d++) column_init(&columns[d], headers[d + 1]);
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        const int *fixed = ctx->nodes[i].constraints;
+        if (constrained_only && !(fixed[0] || fixed[1] || fixed[2])) continue;
+        count++;
+        int w = int_width(ctx->nodes[i].id);
+        if (w > widths[0]) widths[0] = w;
+        for (int d = 0; d < 3; d++) column_add(ctx, &columns[d], values[3*i+d]);
+    }
+    if (constrained_only && count == 0) return;
+    for (int d = 0; d < 3; d++) widths[d + 1] = column_width(ctx, &columns[d]);
+    
+    output_string(out, title);
+    output_border(out, widths, 4);
+    output_string(out, "|");
+    for (int j = 0; j < 4; j++) output_cell(out, headers[j], strlen(headers[j]), widths[j], 0);
+    output_string(out, "\n");
+    output_border(out, widths, 4);
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        const int *fixed = ctx->nodes[i].constraints;
+        if (constrained_only && !(fixed[0] || fixed[1] || fixed[2])) continue;
+        output_string(out, "|");
+        output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", ctx->nodes[i].id), widths[0], 1);
+        for (int d = 0; d < 3; d++) output_number_cell(ctx, out, values[3*i+d], widths[d + 1]);
+        output_string(out, "\n");
+    }
+    output_border(out, widths, 4);
+}
+
+// Frequencies, periods and effective modal masses, in percent of the
+// free mass and summed over the modes so far, then each mode shape in
+// the layout of the displacements
+void write_modal_table(TrussContext *ctx, OutputBuffer *out) {
+    static const char *const headers[9] = {"Mode", "Frequency (Hz)", "Period (s)", "Mass X (%)", "Mass Y (%)",
+                                           "Mass Z (%)", "Sum X (%)", "Sum Y (%)", "Sum Z (%)"};
+    static const char *const shape_headers[4] = {"Node", "X", "Y", "Z"};
+    char buffer[128];
+    int widths[9];
+    ColumnWidth columns[8];
+    double sums[3] = {0.0, 0.0, 0.0};
+    widths[0] = 4;
+    for (int j = 0; j < 8; j++) column_init(&columns[j], headers[j + 1]);
+    for (int q = 0; q < ctx->n_modes; q++) {
+        const TrussMode *mode = &ctx->modes[q];
+        int w = int_width(q + 1);
+        if (w > widths[0]) widths[0] = w;
+        column_add(ctx, &columns[0], mode->frequency);
+        column_add(ctx, &columns[1], mode->period);
+        for (int d = 0; d < 3; d++) {
+            sums[d] += 100.0 * mode->mass_ratio[d];
+            column_add(ctx, &columns[2 + d], 100.0 * mode->mass_ratio[d]);
+            column_add(ctx, &columns[5 + d], sums[d]);
+        }
+    }
+    for (int j = 0; j < 8; j++) widths[j + 1] = column_width(ctx, &columns[j]);
+    
+    int length = snprintf(buffer, sizeof(buffer), "\nNATURAL MODES (%s mass):\n", ctx->consistent_mass ? "consistent" : "lumped");
+    output_text(out, buffer, length);
+    output_border(out, widths, 9);
+    output_string(out, "|");
+    for (int j = 0; j < 9; j++) output_cell(out, headers[j], strlen(headers[j]), widths[j], 0);
+    output_string(out, "\n");
+    output_border(out, widths, 9);
+    sums[0] = sums[1] = sums[2] = 0.0;
+    for (int q = 0; q < ctx->n_modes; q++) {
+        const TrussMode *mode = &ctx->modes[q];
+        output_string(out, "|");
+        output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", q + 1), widths[0], 1);
+        output_number_cell(ctx, out, mode->frequency, widths[1]);
+        output_number_cell(ctx, out, mode->period, widths[2]);
+        for (int d = 0; d < 3; d++) output_number_cell(ctx, out, 100.0 * mode->mass_ratio[d], widths[3 + d]);
+        for (int d = 0; d < 3; d++) {
+            sums[d] += 100.0 * mode->mass_ratio[d];
+            output_number_cell(ctx, out, sums[d], widths[6 + d]);
+        }
+        output_string(out, "\n");
+    }
+    output_border(out, widths, 9);
+    
+    for (int q = 0; q < ctx->n_modes; q++) {
+        snprintf(buffer, sizeof(buffer), "\nMODE %d SHAPE:\n", q + 1);
+        write_node_table(ctx, out, buffer, shape_headers, ctx->mode_shapes + (size_t)q * ctx->total_dofs, 0);
+    }
+}
+
+// Full-precision value for CSV/TSV output
+void output_delimited_number(OutputBuffer *out, double value, char separator) {
+    char buffer[32];
+    buffer[0] = separator;
+    int length = snprintf(buffer + 1, sizeof(buffer) - 1, "%.17g", value);
+    output_text(out, buffer, length + 1);
+}
+
+// Load-case name as a CSV field (quoted when needed) or a TSV field
+// (tabs and line breaks replaced by spaces)
+void output_delimited_name(OutputBuffer *out, const char *name, char separator) {
+    if (separator == ',' && strpbrk(name, ",\"\r\n")) {
+        output_string(out, "\"");
+        for (const char *p = name; *p; p++) {
+            output_text(out, p, 1);
+            if (*p == '"') output_string(out, "\"");
+        }
+        output_string(out, "\"");
+    } else {
+        for (const char *p = name; *p; p++) {
+            output_text(out, (*p == '\t' || *p == '\r' || *p == '\n') ? " " : p, 1);
+        }
+    }
+}
+
+// Machine-readable results: one block per result kind covering every
+// load case, each a '#' title line, a header row and full-precision rows
+void write_delimited_results(TrussContext *ctx, OutputBuffer *out, char separator) {
+    char buffer[64];
+    int length;
+    const char *sep = separator == ',' ? "," : "\t";
+    
+    output_string(out, "# LOAD CASES\n");
+    length = snprintf(buffer, sizeof(buffer), "load_case%sname\n", sep);
+    output_text(out, buffer, length);
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        length = snprintf(buffer, sizeof(buffer), "%d%s", c + 1, sep);
+        output_text(out, buffer, length);
+        output_delimited_name(out, ctx->load_cases[c].name, separator);
+        output_string(out, "\n");
+    }
+    
+    output_string(out, "\n# NODE DISPLACEMENTS\n");
+    length = snprintf(buffer, sizeof(buffer), "load_case%snode%sdx%sdy%sdz\n", sep, sep, sep, sep);
+    output_text(out, buffer, length);
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const double *disp = ctx->displacements + (size_t)c * ctx->total_dofs;
+        for (int i = 0; i < ctx->n_nodes; i++) {
+            length = snprintf(buffer, sizeof(buffer), "%d%s%d", c + 1, sep, ctx->nodes[i].id);
+            output_text(out, buffer, length);
+            for (int d = 0; d < 3; d++) output_delimited_number(out, disp[3*i+d], separator);
+            output_string(out, "\n");
+        }
+    }
+    
+    output_string(out, "\n# NODE REACTIONS\n");
+    length = snprintf(buffer, sizeof(buffer), "load_case%snode%srx%sry%srz\n", sep, sep, sep, sep);
+    output_text(out, buffer, length);
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const double *react = ctx->reactions + (size_t)c * ctx->total_dofs;
+        for (int i = 0; i < ctx->n_nodes; i++) {
+            if (!(ctx->nodes[i].constraints[0] || ctx->nodes[i].constraints[1] || ctx->nodes[i].constraints[2])) continue;
+            length = snprintf(buffer, sizeof(buffer), "%d%s%d", c + 1, sep, ctx->nodes[i].id);
+            output_text(out, buffer, length);
+            for (int d = 0; d < 3; d++) output_delimited_number(out, react[3*i+d], separator);
+            output_string(out, "\n");
+        }
+    }
+    
+    output_string(out, "\n# MEMBER FORCES AND STRESSES\n");
+    length = snprintf(buffer, sizeof(buffer), "load_case%smember%sforce%sstress%sstatus%slength\n",
+                      sep, sep, sep, sep, sep);
+    output_text(out, buffer, length);
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const MemberResult *results = ctx->member_results + (size_t)c * ctx->n_members;
+        for (int m = 0; m < ctx->n_members; m++) {
+            length = snprintf(buffer, sizeof(buffer), "%d%s%d", c + 1, sep, ctx->members[m].id);
+            output_text(out, buffer, length);
+            output_delimited_number(out, results[m].force, separator);
+            output_delimited_number(out, results[m].stress, separator);
+            length = snprintf(buffer, sizeof(buffer), "%s%s", sep, member_status_name(results[m].status));
+            output_text(out, buffer, length);
+            output_delimited_number(out, results[m].length, separator);
+            output_string(out, "\n");
+        }
+    }
+}
+
+// Machine-readable modes: one row per mode, then the mode shapes with
+// one row per mode and node
+void write_modal_delimited(TrussContext *ctx, OutputBuffer *out, char separator) {
+    static const char *const names[] = {
+        "frequency", "period", "circular_frequency", "participation_x", "participation_y", "participation_z",
+        "mass_ratio_x", "mass_ratio_y", "mass_ratio_z", "residual"
+    };
+    char buffer[64];
+    int length;
+    const char *sep = separator == ',' ? "," : "\t";
+    
+    output_string(out, "# MODES\nmode");
+    for (size_t j = 0; j < sizeof(names) / sizeof(names[0]); j++) {
+        output_string(out, sep);
+        output_string(out, names[j]);
+    }
+    output_string(out, "\n");
+    for (int q = 0; q < ctx->n_modes; q++) {
+        const TrussMode *mode = &ctx->modes[q];
+        length = snprintf(buffer, sizeof(buffer), "%d", q + 1);
+        output_text(out, buffer, length);
+        output_delimited_number(out, mode->frequency, separator);
+        output_delimited_number(out, mode->period, separator);
+        output_delimited_number(out, mode->circular_frequency, separator);
+        for (int d = 0; d < 3; d++) output_delimited_number(out, mode->participation[d], separator);
+        for (int d = 0; d < 3; d++) output_delimited_number(out, mode->mass_ratio[d], separator);
+        output_delimited_number(out, mode->residual, separator);
+        output_string(out, "\n");
+    }
+    
+    output_string(out, "\n# MODE SHAPES\n");
+    length = snprintf(buffer, sizeof(buffer), "mode%snode%sx%sy%sz\n", sep, sep, sep, sep);
+    output_text(out, buffer, length);
+    for (int q = 0; q < ctx->n_modes; q++) {
+        const double *shape = ctx->mode_shapes + (size_t)q * ctx->total_dofs;
+        for (int i = 0; i < ctx->n_nodes; i++) {
+            length = snprintf(buffer, sizeof(buffer), "%d%s%d", q + 1, sep, ctx->nodes[i].id);
+            output_text(out, buffer, length);
+            for (int d = 0; d < 3; d++) output_delimited_number(out, shape[3*i+d], separator);
+            output_string(out, "\n");
+        }
+    }
+}
+
+// Threads an analysis of this context runs on
+int profile_threads(const TrussContext *ctx) {
+#ifdef _OPENMP
+    return ctx->n_threads > 0 ? ctx->n_threads : omp_get_max_threads();
+#else
+    (void)ctx;
+    return 1;
+#endif
+}
+
+TrussPhaseProfile profile_total(const TrussContext *ctx) {
+    TrussPhaseProfile total = {0};
+    for (int p = 0; p < TRUSS_PHASE_COUNT; p++) {
+        total.wall_time += ctx->phase_profile[p].wall_time;
+        total.cpu_time += ctx->phase_profile[p].cpu_time;
+        total.allocated += ctx->phase_profile[p].allocated;
+        if (ctx->phase_profile[p].peak_rss > total.peak_rss) total.peak_rss = ctx->phase_profile[p].peak_rss;
+    }
+    return total;
+}
+
+// Totals over the load steps of a nonlinear analysis
+TrussStepReport step_totals(const TrussContext *ctx) {
+    TrussStepReport total = {0};
+    for (int i = 0; i < ctx->n_step_reports; i++) {
+        total.iterations += ctx->step_reports[i].iterations;
+        total.factorizations += ctx->step_reports[i].factorizations;
+        total.line_search_trials += ctx->step_reports[i].line_search_trials;
+        total.wall_time += ctx->step_reports[i].wall_time;
+    }
+    return total;
+}
+
+int write_profile_table(TrussContext *ctx, FILE *file) {
+    const TrussSolverStats *stats = &ctx->solver.stats;
+    fprintf(file, "Profile (%d nodes, %d members, %d load case%s, %d thread%s)\n", ctx->n_nodes, ctx->n_members,
+            ctx->n_load_cases, ctx->n_load_cases == 1 ? "" : "s", profile_threads(ctx), profile_threads(ctx) == 1 ? "" : "s");
+    fprintf(file, "  %-14s %10s %10s %15s %14s\n", "Phase", "Wall (s)", "CPU (s)", "Allocated (MB)", "Peak RSS (MB)");
+    TrussPhaseProfile total = profile_total(ctx);
+    for (int p = 0; p <= TRUSS_PHASE_COUNT; p++) {
+        const TrussPhaseProfile *profile = p < TRUSS_PHASE_COUNT ? &ctx->phase_profile[p] : &total;
+        fprintf(file, "  %-14s %10.4f %10.4f %15.2f %14.1f\n", p < TRUSS_PHASE_COUNT ? truss_phase_name(p) : "total",
+                profile->wall_time, profile->cpu_time, profile->allocated / 1e6, profile->peak_rss / 1e6);
+    }
+    if (stats->solver[0] == '\0') return TRUSS_OK;
+    fprintf(file, "  Solver %s: %d equations, %lld matrix nonzeros", stats->solver, stats->n_free, stats->matrix_nnz);
+    if (stats->factor_nnz > 0) {
+        fprintf(file, ", %lld factor nonzeros (fill-in %lld", stats->factor_nnz, stats->fill_in);
+        if (stats->supernodes > 0) fprintf(file, ", %d supernodes", stats->supernodes);
+        fprintf(file, ")");
+    }
+    fprintf(file, ", %.2f MB%s\n", stats->factor_bytes / 1e6, stats->reused ? ", reused" : "");
+    fprintf(file, "  Bandwidth %lld, profile %lld\n", stats->bandwidth, stats->envelope);
+    if (stats->factor_nnz > 0) {
+        fprintf(file, "  Pivots %.3e to %.3e", stats->min_pivot, stats->max_pivot);
+    } else {
+        fprintf(file, "  %d PCG iterations", stats->iterations);
+    }
+    if (stats->residual >= 0.0) fprintf(file, ", relative residual %.3e", stats->residual);
+    if (ctx->equilibrium) fprintf(file, ", equilibrium %.3e", stats->imbalance);
+    fprintf(file, "\n");
+    if (stats->single_precision) {
+        fprintf(file, "  Single precision factor: condition estimate %.2e, %d refinement step%s",
+                stats->condition, stats->refinements, stats->refinements == 1 ? "" : "s");
+        if (stats->backward_error >= 0.0) fprintf(file, ", backward error %.3e", stats->backward_error);
+        fprintf(file, "\n");
+    }
+    if (stats->spilled_bytes > 0) {
+        fprintf(file, "  Out of core: %.2f MB spilled, %.2f MB read back, I/O wait %.4f s\n",
+                stats->spilled_bytes / 1e6, stats->spill_read_bytes / 1e6, stats->io_wait);
+    }
+    if (ctx->solver.condensed) {
+        const SubstructureCache *sub = &ctx->substructures;
+        fprintf(file, "  Substructures: %d instance%s of %d module%s, %d interior DOFs condensed by %d super-element%s (%s)\n",
+                ctx->n_instances, ctx->n_instances == 1 ? "" : "s", ctx->n_modules, ctx->n_modules == 1 ? "" : "s", sub->condensed_dofs,
+                sub->n_condensations, sub->n_condensations == 1 ? "" : "s", sub->computed ? "computed" : "reused");
+    }
+    if (ctx->n_step_reports > 0) {
+        TrussStepReport steps = step_totals(ctx);
+        fprintf(file, "  Nonlinear: %d load step%s, %d Newton iterations, %d factorization%s, %d line search trials\n",
+                ctx->n_step_reports, ctx->n_step_reports == 1 ? "" : "s", steps.iterations, steps.factorizations,
+                steps.factorizations == 1 ? "" : "s", steps.line_search_trials);
+    }
+    if (ctx->modes) {
+        fprintf(file, "  Modal: %d mode%s (%s mass), %d Lanczos vectors in %d block steps\n", ctx->n_modes,
+                ctx->n_modes == 1 ? "" : "s", ctx->consistent_mass ? "consistent" : "lumped",
+                ctx->lanczos_vectors, ctx->lanczos_steps);
+    }
+    return TRUSS_OK;
+}
+
+void json_number(FILE *file, const char *name, double value, const char *after) {
+    if (isfinite(value)) {
+        fprintf(file, "\"%s\": %.9g%s", name, value, after);
+    } else {
+        fprintf(file, "\"%s\": null%s", name, after);
+    }
+}
+
+void json_phase(FILE *file, const char *name, const TrussPhaseProfile *profile, const char *after) {
+    fprintf(file, "    \"%s\": {", name);
+    json_number(file, "wall_s", profile->wall_time, ", ");
+    json_number(file, "cpu_s", profile->cpu_time, ", ");
+    fprintf(file, "\"allocated_bytes\": %lld, \"peak_rss_bytes\": %lld}%s\n",
+            profile->allocated, profile->peak_rss, after);
+}
+
+// Fixed schema: every key is always present, null where it does not apply
+int write_profile_json(TrussContext *ctx, FILE *file) {
+    const TrussSolverStats *stats = &ctx->solver.stats;
+    int factored = stats->factor_nnz > 0;
+    fprintf(file, "{\n  \"schema\": \"truss-profile-1\",\n");
+    fprintf(file, "  \"model\": {\"nodes\": %d, \"members\": %d, \"load_cases\": %d, \"dofs\": %d},\n",
+            ctx->n_nodes, ctx->n_members, ctx->n_load_cases, ctx->total_dofs);
+    fprintf(file, "  \"threads\": %d,\n  \"phases\": {\n", profile_threads(ctx));
+    for (int p = 0; p < TRUSS_PHASE_COUNT; p++) {
+        json_phase(file, truss_phase_name(p), &ctx->phase_profile[p], p + 1 < TRUSS_PHASE_COUNT ? "," : "");
+    }
+    TrussPhaseProfile total = profile_total(ctx);
+    fprintf(file, "  },\n  \"total\": {\n");
+    json_phase(file, "all", &total, "");
+    fprintf(file, "  },\n  \"solver\": {\n");
+    if (stats->solver[0] != '\0') {
+        fprintf(file, "    \"type\": \"%s\",\n", stats->solver);
+    } else {
+        fprintf(file, "    \"type\": null,\n");
+    }
+    fprintf(file, "    \"equations\": %d,\n    \"matrix_nnz\": %lld,\n", stats->n_free, stats->matrix_nnz);
+    fprintf(file, "    \"factor_nnz\": %lld,\n    \"fill_in\": %lld,\n", stats->factor_nnz, stats->fill_in);
+    fprintf(file, "    \"supernodes\": %d,\n    \"iterations\": %d,\n", stats->supernodes, stats->iterations);
+    fprintf(file, "    \"reused\": %s,\n    \"factor_bytes\": %lld,\n", stats->reused ? "true" : "false",
+            stats->factor_bytes);
+    fprintf(file, "    \"spilled_bytes\": %lld,\n    \"spill_read_bytes\": %lld,\n    ", stats->spilled_bytes,
+            stats->spill_read_bytes);
+    json_number(file, "io_wait_s", stats->io_wait, ",\n");
+    fprintf(file, "    \"bandwidth\": %lld,\n    \"envelope\": %lld,\n    ", stats->bandwidth, stats->envelope);
+    json_number(file, "min_pivot", factored ? stats->min_pivot : NAN, ",\n    ");
+    json_number(file, "max_pivot", factored ? stats->max_pivot : NAN, ",\n    ");
+    json_number(file, "relative_residual", stats->residual >= 0.0 ? stats->residual : NAN, ",\n    ");
+    json_number(file, "relative_imbalance", ctx->equilibrium ? stats->imbalance : NAN, ",\n    ");
+    fprintf(file, "\"single_precision\": %s,\n    \"refinements\": %d,\n    ",
+            stats->single_precision ? "true" : "false", stats->refinements);
+    json_number(file, "condition_estimate", stats->condition > 0.0 ? stats->condition : NAN, ",\n    ");
+    json_number(file, "backward_error", stats->backward_error >= 0.0 ? stats->backward_error : NAN, "\n  },\n");
+    if (!ctx->solver.condensed) {
+        fprintf(file, "  \"substructures\": null,\n");
+    } else {
+        const SubstructureCache *sub = &ctx->substructures;
+        fprintf(file, "  \"substructures\": {\"instances\": %d, \"modules\": %d, \"super_elements\": %d, "
+                "\"computed\": %d, \"condensed_dofs\": %d},\n", ctx->n_instances, ctx->n_modules,
+                sub->n_condensations, sub->computed, sub->condensed_dofs);
+    }
+    if (ctx->n_step_reports == 0) {
+        fprintf(file, "  \"nonlinear\": null,\n");
+    } else {
+        TrussStepReport steps = step_totals(ctx);
+        fprintf(file, "  \"nonlinear\": {\n    \"load_steps\": %d,\n    \"iterations\": %d,\n",
+                ctx->n_step_reports, steps.iterations);
+        fprintf(file, "    \"factorizations\": %d,\n    \"line_search_trials\": %d,\n    \"steps\": [\n",
+                steps.factorizations, steps.line_search_trials);
+        for (int i = 0; i < ctx->n_step_reports; i++) {
+            const TrussStepReport *step = &ctx->step_reports[i];
+            fprintf(file, "      {\"load_case\": %d, \"step\": %d, ", step->load_case, step->step);
+            json_number(file, "load_factor", step->load_factor, ", ");
+            fprintf(file, "\"iterations\": %d, \"factorizations\": %d, \"line_search_trials\": %d, ",
+                    step->iterations, step->factorizations, step->line_search_trials);
+            json_number(file, "relative_residual", step->residual, ", ");
+            json_number(file, "wall_s", step->wall_time, i + 1 < ctx->n_step_reports ? "},\n" : "}\n");
+        }
+        fprintf(file, "    ]\n  },\n");
+    }
+    if (!ctx->modes) {
+        fprintf(file, "  \"modal\": null\n}\n");
+        return TRUSS_OK;
+    }
+    fprintf(file, "  \"modal\": {\n    \"mass\": \"%s\",\n    \"lanczos_vectors\": %d,\n    \"block_steps\": %d,\n",
+            ctx->consistent_mass ? "consistent" : "lumped", ctx->lanczos_vectors, ctx->lanczos_steps);
+    fprintf(file, "    \"modes\": [\n");
+    for (int q = 0; q < ctx->n_modes; q++) {
+        const TrussMode *mode = &ctx->modes[q];
+        fprintf(file, "      {");
+        json_number(file, "frequency_hz", mode->frequency, ", ");
+        json_number(file, "period_s", mode->period, ", ");
+        fprintf(file, "\"mass_ratio\": [%.9g, %.9g, %.9g], ", mode->mass_ratio[0], mode->mass_ratio[1],
+                mode->mass_ratio[2]);
+        json_number(file, "residual", mode->residual, q + 1 < ctx->n_modes ? "},\n" : "}\n");
+    }
+    fprintf(file, "    ]\n  }\n}\n");
+    return TRUSS_OK;
+}
+
+int host_is_little_endian() {
+    uint16_t probe = 1;
+    return *(unsigned char *)&probe == 1;
+}
+
+// Load the model part of a binary file mapped at data
+int read_binary_model(TrussContext *ctx, const char *data, size_t size) {
+    BinaryHeader header;
+    if (size < sizeof(header)) {
+        return set_error(ctx, TRUSS_ERROR_FORMAT, "Binary file is truncated");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (!host_is_little_endian()) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Binary files are only supported on little-endian hosts");
+    }
+    if (header.version != BINARY_VERSION) {
+        return set_error(ctx, TRUSS_ERROR_FORMAT, "Unsupported binary file version %u (expected %d)", header.version, BINARY_VERSION);
+    }
+    if (header.n_load_cases < 1 || header.node_loads_case < -1 || header.node_loads_case > 0 ||
+        header.n_nodes > INT32_MAX / 3 || header.n_members > INT32_MAX ||
+        header.n_load_cases > INT32_MAX || header.n_case_loads > INT32_MAX) {
+        return set_error(ctx, TRUSS_ERROR_FORMAT, "Invalid binary file header");
+    }
+    size_t model_size = sizeof(BinaryHeader)
+                      + (size_t)header.n_nodes * sizeof(BinaryNode)
+                      + (size_t)header.n_members * sizeof(BinaryMember)
+                      + (size_t)header.n_load_cases * sizeof(LoadCase)
+                      + (size_t)header.n_case_loads * sizeof(BinaryNodeLoad);
+    if (size < model_size) {
+        return set_error(ctx, TRUSS_ERROR_FORMAT, "Binary file is truncated");
+    }
+    
+    ctx->n_nodes = (int)header.n_nodes;
+    ctx->n_members = (int)header.n_members;
+    ctx->n_load_cases = (int)header.n_load_cases;
+    ctx->n_case_loads = (int)header.n_case_loads;
+    ctx->node_loads_case = header.node_loads_case;
+    ctx->total_dofs = 3 * ctx->n_nodes;
+    ctx->nodes = malloc((ctx->n_nodes > 0 ? ctx->n_nodes : 1) * sizeof(Node));
+    ctx->members = malloc((ctx->n_members > 0 ? ctx->n_members : 1) * sizeof(Member));
+    ctx->load_cases = malloc((ctx->n_load_cases + 1) * sizeof(LoadCase));
+    ctx->case_loads = malloc((ctx->n_case_loads > 0 ? ctx->n_case_loads : 1) * sizeof(NodeLoad));
+    if (!ctx->nodes || !ctx->members || !ctx->load_cases || !ctx->case_loads) {
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading binary model");
+    }
+    
+    const BinaryNode *bin_nodes = (const BinaryNode *)(data + sizeof(BinaryHeader));
+    const BinaryMember *bin_members = (const BinaryMember *)(bin_nodes + ctx->n_nodes);
+    const LoadCase *bin_cases = (const LoadCase *)(bin_members + ctx->n_members);
+    const BinaryNodeLoad *bin_loads = (const BinaryNodeLoad *)(bin_cases + ctx->n_load_cases);
+    int bad_index = 0;
+    
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        Node *n = &ctx->nodes[i];
+        n->id = bin_nodes[i].id;
+        n->x = bin_nodes[i].xyz[0];
+        n->y = bin_nodes[i].xyz[1];
+        n->z = bin_nodes[i].xyz[2];
+        for (int d = 0; d < 3; d++) {
+            n->constraints[d] = bin_nodes[i].constraints[d];
+            n->loads[d] = bin_nodes[i].loads[d];
+        }
+    }
+    
+    #pragma omp parallel for schedule(static) reduction(|:bad_index)
+    for (int i = 0; i < ctx->n_members; i++) {
+        Member *m = &ctx->members[i];
+        m->id = bin_members[i].id;
+        m->node1 = bin_members[i].node1;
+        m->node2 = bin_members[i].node2;
+        m->E = bin_members[i].E;
+        m->A = bin_members[i].A;
+        if (m->node1 < 0 || m->node1 >= ctx->n_nodes || m->node2 < 0 || m->node2 >= ctx->n_nodes) bad_index = 1;
+    }
+    
+    memcpy(ctx->load_cases, bin_cases, ctx->n_load_cases * sizeof(LoadCase));
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        ctx->load_cases[c].name[sizeof(ctx->load_cases[c].name) - 1] = '\0';
+    }
+    
+    for (int l = 0; l < ctx->n_case_loads; l++) {
+        NodeLoad *nl = &ctx->case_loads[l];
+        nl->load_case = bin_loads[l].load_case;
+        nl->node = bin_loads[l].node;
+        for (int d = 0; d < 3; d++) nl->loads[d] = bin_loads[l].loads[d];
+        if (nl->node < 0 || nl->node >= ctx->n_nodes || nl->load_case < 0 || nl->load_case >= ctx->n_load_cases) bad_index = 1;
+    }
+    if (bad_index) {
+        return set_error(ctx, TRUSS_ERROR_FORMAT, "Binary file refers to a node or load case that does not exist");
+    }
+    
+    int duplicate = build_node_index(ctx);
+    if (duplicate == -2) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory indexing nodes");
+    if (duplicate >= 0) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Duplicate node ID %d", ctx->nodes[duplicate].id);
+    }
+    return TRUSS_OK;
+}
+
+// Write the model and all load-case results in the binary format
+int write_binary(TrussContext *ctx, const char *filename) {
+    if (!host_is_little_endian()) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Binary files are only supported on little-endian hosts");
+    }
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return set_error(ctx, TRUSS_ERROR_IO, "Cannot open output file %s: %s", filename, strerror(errno));
+    }
+    
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.flags = BINARY_HAS_RESULTS;
+    header.n_nodes = ctx->n_nodes;
+    header.n_members = ctx->n_members;
+    header.n_load_cases = ctx->n_load_cases;
+    header.n_case_loads = ctx->n_case_loads;
+    header.node_loads_case = ctx->node_loads_case;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    
+    BinaryNode *bin_nodes = calloc(ctx->n_nodes > 0 ? ctx->n_nodes : 1, sizeof(BinaryNode));
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        bin_nodes[i].id = ctx->nodes[i].id;
+        bin_nodes[i].xyz[0] = ctx->nodes[i].x;
+        bin_nodes[i].xyz[1] = ctx->nodes[i].y;
+        bin_nodes[i].xyz[2] = ctx->nodes[i].z;
+        for (int d = 0; d < 3; d++) {
+            bin_nodes[i].constraints[d] = ctx->nodes[i].constraints[d];
+            bin_nodes[i].loads[d] = ctx->nodes[i].loads[d];
+        }
+    }
+    ok = ok && fwrite(bin_nodes, sizeof(BinaryNode), ctx->n_nodes, file) == (size_t)ctx->n_nodes;
+    free(bin_nodes);
+    
+    BinaryMember *bin_members = calloc(ctx->n_members > 0 ? ctx->n_members : 1, sizeof(BinaryMember));
+    for (int i = 0; i < ctx->n_members; i++) {
+        bin_members[i].id = ctx->members[i].id;
+        bin_members[i].node1 = ctx->members[i].node1;
+        bin_members[i].node2 = ctx->members[i].node2;
+        bin_members[i].E = ctx->members[i].E;
+        bin_members[i].A = ctx->members[i].A;
+    }
+    ok = ok && fwrite(bin_members, sizeof(BinaryMember), ctx->n_members, file) == (size_t)ctx->n_members;
+    free(bin_members);
+    
+    LoadCase *names = calloc(ctx->n_load_cases, sizeof(LoadCase));
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        strncpy(names[c].name, ctx->load_cases[c].name, sizeof(names[c].name) - 1);
+    }
+    ok = ok && fwrite(names, sizeof(LoadCase), ctx->n_load_cases, file) == (size_t)ctx->n_load_cases;
+    free(names);
+    
+    BinaryNodeLoad *bin_loads = calloc(ctx->n_case_loads > 0 ? ctx->n_case_loads : 1, sizeof(BinaryNodeLoad));
+    for (int l = 0; l < ctx->n_case_loads; l++) {
+        bin_loads[l].load_case = ctx->case_loads[l].load_case;
+        bin_loads[l].node = ctx->case_loads[l].node;
+        for (int d = 0; d < 3; d++) bin_loads[l].loads[d] = ctx->case_loads[l].loads[d];
+    }
+    ok = ok && fwrite(bin_loads, sizeof(BinaryNodeLoad), ctx->n_case_loads, file) == (size_t)ctx->n_case_loads;
+    free(bin_loads);
+    
+    size_t n_values = (size_t)ctx->n_load_cases * ctx->total_dofs;
+    ok = ok && fwrite(ctx->displacements, sizeof(double), n_values, file) == n_values;
+    ok = ok && fwrite(ctx->reactions, sizeof(double), n_values, file) == n_values;
+    
+    size_t n_results = (size_t)ctx->n_load_cases * ctx->n_members;
+    BinaryMemberResult *bin_results = calloc(n_results > 0 ? n_results : 1, sizeof(BinaryMemberResult));
+    for (size_t r = 0; r < n_results; r++) {
+        bin_results[r].force = ctx->member_results[r].force;
+        bin_results[r].stress = ctx->member_results[r].stress;
+        bin_results[r].length = ctx->member_results[r].length;
+        bin_results[r].status = ctx->member_results[r].status;
+    }
+    ok = ok && fwrite(bin_results, sizeof(BinaryMemberResult), n_results, file) == n_results;
+    free(bin_results);
+    
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) {
+        return set_error(ctx, TRUSS_ERROR_IO, "Could not write output file %s", filename);
+    }
+    log_message(ctx, "Results written to %s\n", filename);
+    return TRUSS_OK;
+}
+
+// Parse a number at s the way atof does, stopping at the first character
+// that cannot continue it. Decimals with at most 19 significant digits
+// whose value is an exact double times an exact power of ten are
+// converted directly, which rounds correctly; anything else (long
+// mantissas, large exponents, hex, inf, nan) goes through strtod.
+double parse_number(const char *s, const char **end) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *p = s;
+    while (isspace((unsigned char)*p)) p++;
+    int negative = 0;
+    if (*p == '+' || *p == '-') negative = *p++ == '-';
+    
+    uint64_t mantissa = 0;
+    int n_digits = 0;      // significant digits in mantissa
+    int exponent = 0;
+    int any_digit = 0;
+    int exact = 1;
+    for (; isdigit((unsigned char)*p); p++) {
+        any_digit = 1;
+        if (mantissa == 0 && *p == '0') continue;
+        if (n_digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            n_digits++;
+        } else {
+            exact = 0;
+        }
+    }
+    if (*p == '.') {
+        p++;
+        for (; isdigit((unsigned char)*p); p++) {
+            any_digit = 1;
+            if (mantissa == 0 && *p == '0') {
+                exponent--;
+                continue;
+            }
+            if (n_digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                n_digits++;
+                exponent--;
+            } else {
+                exact = 0;
+            }
+        }
+    }
+    if (any_digit && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int exp_negative = 0;
+        if (*q == '+' || *q == '-') exp_negative = *q++ == '-';
+        if (isdigit((unsigned char)*q)) {
+            int e = 0;
+            for (; isdigit((unsigned char)*q); q++) {
+                if (e < 10000) e = e * 10 + (*q - '0');
+            }
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+    
+    if (!any_digit || !exact || isalpha((unsigned char)*p) ||
+        mantissa > ((uint64_t)1 << 53) || exponent < -22 || exponent > 22) {
+        char *strtod_end;
+        double value = strtod(s, &strtod_end);
+        if (end) *end = strtod_end;
+        return value;
+    }
+    
+    double value = (double)mantissa;
+    value = exponent < 0 ? value / pow10[-exponent] : value * pow10[exponent];
+    if (end) *end = p;
+    return negative ? -value : value;
+}
+
+// Split the comma-separated record line..end into numbers, skipping empty
+// fields. The first max_values are stored; the return value counts every
+// non-empty field so over-long records are not mistaken for shorter ones.
+// The character at end must not continue a number (newline, or the
+// terminator of a copied last line).
+int parse_csv_record(const char *line, const char *end, double *values, int max_values) {
+    int count = 0;
+    const char *field = line;
+    while (1) {
+        const char *field_end = memchr(field, ',', end - field);
+        const char *next = field_end ? field_end + 1 : NULL;
+        if (!field_end) field_end = end;
+        while (field < field_end && isspace((unsigned char)*field)) field++;
+        if (field < field_end) {
+            if (count < max_values) values[count] = parse_number(field, NULL);
+            count++;
+        }
+        if (!next) break;
+        field = next;
+    }
+    return count;
+}
+
+// Make room for at least needed elements in the array that array points
+// to, doubling the capacity. Returns 0, leaving the array as it was, if
+// memory runs out.
+int grow_array(void *array, int *capacity, int needed, size_t element_size) {
+    if (needed <= *capacity) return 1;
+    int new_capacity = *capacity > 0 ? *capacity : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+    void *grown = realloc(*(void **)array, (size_t)new_capacity * element_size);
+    if (!grown) return 0;
+    *(void **)array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Load-case section header: LOADCASE[, name]
+int is_load_case_header(const char *line, const char *end) {
+    return match_keyword(line, end, "LOADCASE");
+}
+
+// Whether line..end starts with keyword (in any case) as a field of its own
+int match_keyword(const char *line, const char *end, const char *keyword) {
+    int length = (int)strlen(keyword);
+    if (end - line < length) return 0;
+    for (int k = 0; k < length; k++) {
+        if (toupper((unsigned char)line[k]) != keyword[k]) return 0;
+    }
+    return end - line == length || line[length] == ',' || isspace((unsigned char)line[length]);
+}
+
+double wall_time() {
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Processor time of all threads of the process, user and system
+double cpu_time() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Peak resident set size of the process in bytes
+long long peak_rss() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (long long)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (long long)usage.ru_maxrss;
+#else
+    return (long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Bytes of the model arrays, which live outside the arenas
+long long model_bytes(const TrussContext *ctx) {
+    long long bytes = (long long)ctx->n_nodes * sizeof(Node) + (long long)ctx->n_members * sizeof(Member) +
+                      (long long)ctx->n_load_cases * sizeof(LoadCase) + (long long)ctx->n_case_loads * sizeof(NodeLoad);
+    if (ctx->node_index) bytes += ((long long)ctx->node_index_mask + 1) * sizeof(int);
+    return bytes;
+}
+
+ProfileClock profile_clock(const TrussContext *ctx) {
+    ProfileClock clock = {wall_time(), cpu_time(),
+                          (long long)(ctx->model_arena.allocated + ctx->solve_arena.allocated +
+                                      ctx->scratch.allocated + ctx->solver.arena.allocated)};
+    return clock;
+}
+
+// Add what was used between start and end to a phase's profile
+void profile_phase(TrussContext *ctx, int phase, ProfileClock start, ProfileClock end) {
+    TrussPhaseProfile *profile = &ctx->phase_profile[phase];
+    profile->wall_time += end.wall - start.wall;
+    profile->cpu_time += end.cpu - start.cpu;
+    profile->allocated += end.allocated - start.allocated;
+    profile->peak_rss = peak_rss();
+}
+
+// Map the whole input file read-only into *data (NULL for an empty file)
+int map_input(TrussContext *ctx, const char *filename, const char **data, size_t *size) {
+    *data = NULL;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        return set_error(ctx, TRUSS_ERROR_IO, "Cannot open file %s", filename);
+    }
+    *size = (size_t)file_size.QuadPart;
+    if (*size > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        if (!*data) {
+            CloseHandle(file);
+            return set_error(ctx, TRUSS_ERROR_IO, "Cannot map input file %s", filename);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        int err = errno;
+        if (fd >= 0) close(fd);
+        return set_error(ctx, TRUSS_ERROR_IO, "Cannot open file %s: %s", filename, strerror(err));
+    }
+    *size = (size_t)st.st_size;
+    if (*size > 0) {
+        void *map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            return set_error(ctx, TRUSS_ERROR_IO, "Cannot map input file %s: %s", filename, strerror(err));
+        }
+        madvise(map, *size, MADV_WILLNEED);
+        *data = map;
+    }
+    close(fd);
+#endif
+    return TRUSS_OK;
+}
+
+void unmap_input(const char *data, size_t size) {
+    if (!data) return;
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void *)data, size);
+#endif
+}
+
+// Parse every line of chunk->begin..chunk->end into the chunk's own arrays
+void parse_chunk(InputChunk *chunk) {
+    double values[10];
+    char *last_line = NULL;
+    const char *p = chunk->begin;
+    
+    while (p < chunk->end) {
+        const char *line = p;
+        const char *eol = memchr(p, '\n', chunk->end - p);
+        if (eol) {
+            p = eol + 1;
+        } else {
+            // Unterminated last line of the file: copy it so that number
+            // parsing stops at a terminator inside our own memory
+            size_t length = chunk->end - line;
+            last_line = malloc(length + 1);
+            if (!last_line) {
+                chunk->failed = 1;
+                break;
+            }
+            memcpy(last_line, line, length);
+            last_line[length] = '\0';
+            line = last_line;
+            eol = last_line + length;
+            p = chunk->end;
+        }
+        chunk->n_lines++;
+        
+        while (line < eol && isspace((unsigned char)*line)) line++;
+        const char *end = eol;
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        if (line == end || line[0] == '#') continue;
+        
+        if (is_load_case_header(line, end)) {
+            if (!grow_array(&chunk->sections, &chunk->section_capacity, chunk->n_sections + 1, sizeof(LoadCase))) {
+                chunk->failed = 1;
+                break;
+            }
+            LoadCase *lc = &chunk->sections[chunk->n_sections++];
+            const char *name = memchr(line, ',', end - line);
+            lc->name[0] = '\0';
+            if (name) {
+                name++;
+                while (name < end && isspace((unsigned char)*name)) name++;
+                snprintf(lc->name, sizeof(lc->name), "%.*s", (int)(end - name), name);
+            }
+            continue;
+        }
+        
+        int num_values = parse_csv_record(line, end, values, 10);
+        
+        if (num_values == 10) {
+            if (!grow_array(&chunk->nodes, &chunk->node_capacity, chunk->n_nodes + 1, sizeof(Node))) {
+                chunk->failed = 1;
+                break;
+            }
+            Node *n = &chunk->nodes[chunk->n_nodes++];
+            n->id = (int)values[0];
+            n->x = values[1];
+            n->y = values[2];
+            n->z = values[3];
+            n->constraints[0] = (int)values[4];
+            n->constraints[1] = (int)values[5];
+            n->constraints[2] = (int)values[6];
+            n->loads[0] = values[7];
+            n->loads[1] = values[8];
+            n->loads[2] = values[9];
+            continue;
+        }
+        if (num_values == 5) {
+            // node1/node2 hold node IDs until they are resolved
+            if (!grow_array(&chunk->members, &chunk->member_capacity, chunk->n_members + 1, sizeof(Member))) {
+                chunk->failed = 1;
+                break;
+            }
+            Member *m = &chunk->members[chunk->n_members++];
+            m->id = (int)values[0];
+            m->node1 = (int)values[1];
+            m->node2 = (int)values[2];
+            m->E = values[3];
+            m->A = values[4];
+            continue;
+        }
+        if (num_values == 4) {
+            // Before the chunk's first header it is only a load record if
+            // an earlier chunk opened a section; it is also noted as
+            // skipped and the merge decides which
+            if (!grow_array(&chunk->loads, &chunk->load_capacity, chunk->n_loads + 1, sizeof(NodeLoad))) {
+                chunk->failed = 1;
+                break;
+            }
+            NodeLoad *l = &chunk->loads[chunk->n_loads++];
+            l->load_case = chunk->n_sections;
+            l->node = (int)values[0];
+            l->loads[0] = values[1];
+            l->loads[1] = values[2];
+            l->loads[2] = values[3];
+            if (chunk->n_sections > 0) continue;
+        }
+        if (!grow_array(&chunk->skipped, &chunk->skipped_capacity, chunk->n_skipped + 1, sizeof(SkippedLine))) {
+            chunk->failed = 1;
+            break;
+        }
+        chunk->skipped[chunk->n_skipped].line = chunk->n_lines;
+        chunk->skipped[chunk->n_skipped].n_values = num_values;
+        chunk->n_skipped++;
+    }
+    free(last_line);
+}
+
+unsigned int hash_node_id(int node_id) {
+    return (unsigned int)node_id * 2654435761u;
+}
+
+// Build the open-addressing table from node IDs to indices. Returns -1,
+// the index of the first node whose ID is already taken, or -2 if out of
+// memory.
+int build_node_index(TrussContext *ctx) {
+    int size = 16;
+    while (size < 2 * ctx->n_nodes) size *= 2;
+    free(ctx->node_index);
+    ctx->node_index = malloc(size * sizeof(int));
+    if (!ctx->node_index) return -2;
+    ctx->node_index_mask = size - 1;
+    for (int s = 0; s < size; s++) ctx->node_index[s] = -1;
+    
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        unsigned int s = hash_node_id(ctx->nodes[i].id) & ctx->node_index_mask;
+        while (ctx->node_index[s] >= 0) {
+            if (ctx->nodes[ctx->node_index[s]].id == ctx->nodes[i].id) return i;
+            s = (s + 1) & ctx->node_index_mask;
+        }
+        ctx->node_index[s] = i;
+    }
+    return -1;
+}
+
+// Index of the first member with the given id, or -1. The table is
+// built on first use and dropped whenever the members are replaced.
+int find_member_index(TrussContext *ctx, int member_id) {
+    if (!ctx->member_index) {
+        int size = 16;
+        while (size < 2 * ctx->n_members) size *= 2;
+        ctx->member_index = malloc(size * sizeof(int));
+        if (!ctx->member_index) return -1;
+        ctx->member_index_mask = size - 1;
+        for (int s = 0; s < size; s++) ctx->member_index[s] = -1;
+        for (int m = 0; m < ctx->n_members; m++) {
+            unsigned int s = hash_node_id(ctx->members[m].id) & ctx->member_index_mask;
+            while (ctx->member_index[s] >= 0 && ctx->members[ctx->member_index[s]].id != ctx->members[m].id) {
+                s = (s + 1) & ctx->member_index_mask;
+            }
+            if (ctx->member_index[s] < 0) ctx->member_index[s] = m;
+        }
+    }
+    unsigned int s = hash_node_id(member_id) & ctx->member_index_mask;
+    while (ctx->member_index[s] >= 0) {
+        if (ctx->members[ctx->member_index[s]].id == member_id) return ctx->member_index[s];
+        s = (s + 1) & ctx->member_index_mask;
+    }
+    return -1;
+}
+
+// Index of the node with the given id, or -1
+int find_node_index(TrussContext *ctx, int node_id) {
+    unsigned int s = hash_node_id(node_id) & ctx->node_index_mask;
+    while (ctx->node_index[s] >= 0) {
+        if (ctx->nodes[ctx->node_index[s]].id == node_id) return ctx->node_index[s];
+        s = (s + 1) & ctx->node_index_mask;
+    }
+    return -1;
+}
+
+// Read a CSV or binary model file. The file is mapped into memory and
+// parsed straight from the mapped pages.
+int read_input(TrussContext *ctx, const char *filename) {
+    double start_time = wall_time();
+    const char *data;
+    size_t size;
+    int status = map_input(ctx, filename, &data, &size);
+    if (status != TRUSS_OK) return status;
+    
+    if (size >= 8 && memcmp(data, BINARY_MAGIC, 8) == 0) {
+        status = read_binary_model(ctx, data, size);
+        unmap_input(data, size);
+        if (status != TRUSS_OK) return status;
+        double elapsed = wall_time() - start_time;
+        log_warning(ctx, "Loaded %.1f MB binary model in %.3f s\n", size / 1e6, elapsed);
+        log_message(ctx, "Found %d nodes and %d members\n", ctx->n_nodes, ctx->n_members);
+        log_message(ctx, "Successfully read %d nodes and %d members\n", ctx->n_nodes, ctx->n_members);
+        if (!(ctx->n_load_cases == 1 && ctx->node_loads_case == 0)) {
+            log_message(ctx, "Found %d load cases\n", ctx->n_load_cases);
+        }
+        return TRUSS_OK;
+    }
+    
+    status = read_csv(ctx, data, size);
+    unmap_input(data, size);
+    return status;
+}
+
+// Parse CSV text. The text is split at line boundaries into chunks that
+// are parsed concurrently; the chunk results are then concatenated in
+// file order, so records, sections and warnings come out exactly as a
+// sequential read would produce them. Member and load node IDs are
+// resolved through the node index once all nodes are known, so records
+// may appear in any order.
+int read_csv(TrussContext *ctx, const char *data, size_t size) {
+    double start_time = wall_time();
+    int n_chunks = (int)(size / INPUT_CHUNK_BYTES) + 1;
+    InputChunk *chunks = calloc(n_chunks, sizeof(InputChunk));
+    if (!chunks) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading input");
+    const char *p = data;
+    for (int c = 0; c < n_chunks; c++) {
+        chunks[c].begin = p;
+        const char *end = c == n_chunks - 1 ? data + size : data + (size_t)(c + 1) * INPUT_CHUNK_BYTES;
+        if (end < p) end = p;
+        if (end < data + size) {
+            const char *eol = memchr(end, '\n', data + size - end);
+            end = eol ? eol + 1 : data + size;
+        }
+        chunks[c].end = end;
+        p = end;
+    }
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n_chunks; c++) {
+        parse_chunk(&chunks[c]);
+    }
+    
+    // Merge in file order
+    int failed = 0;
+    int n_sections = 0;
+    for (int c = 0; c < n_chunks; c++) {
+        failed |= chunks[c].failed;
+        ctx->n_nodes += chunks[c].n_nodes;
+        ctx->n_members += chunks[c].n_members;
+        n_sections += chunks[c].n_sections;
+        ctx->n_case_loads += chunks[c].n_loads;
+    }
+    if (!failed) {
+        ctx->nodes = malloc((ctx->n_nodes > 0 ? ctx->n_nodes : 1) * sizeof(Node));
+        ctx->members = malloc((ctx->n_members > 0 ? ctx->n_members : 1) * sizeof(Member));
+        ctx->case_loads = malloc((ctx->n_case_loads > 0 ? ctx->n_case_loads : 1) * sizeof(NodeLoad));
+        ctx->load_cases = malloc((n_sections + 1) * sizeof(LoadCase));
+        failed = !ctx->nodes || !ctx->members || !ctx->case_loads || !ctx->load_cases;
+    }
+    if (failed) {
+        for (int c = 0; c < n_chunks; c++) {
+            free(chunks[c].nodes);
+            free(chunks[c].members);
+            free(chunks[c].loads);
+            free(chunks[c].sections);
+            free(chunks[c].skipped);
+        }
+        free(chunks);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading input");
+    }
+    
+    // Node-table loads form case 0; sections follow as cases 1..n_sections
+    strcpy(ctx->load_cases[0].name, "Node loads");
+    
+    int node_count = 0;
+    int member_count = 0;
+    int load_count = 0;
+    int section = 0;
+    int line_offset = 0;
+    for (int c = 0; c < n_chunks; c++) {
+        InputChunk *chunk = &chunks[c];
+        for (int k = 0; k < chunk->n_skipped; k++) {
+            if (chunk->skipped[k].n_values == 4 && section > 0) continue;
+            log_warning(ctx, "Warning: Skipping line %d with %d values\n",
+                        line_offset + chunk->skipped[k].line, chunk->skipped[k].n_values);
+        }
+        for (int k = 0; k < chunk->n_sections; k++) {
+            LoadCase *lc = &ctx->load_cases[section + k + 1];
+            if (chunk->sections[k].name[0]) {
+                *lc = chunk->sections[k];
+            } else {
+                snprintf(lc->name, sizeof(lc->name), "Case %d", section + k + 1);
+            }
+        }
+        for (int k = 0; k < chunk->n_loads; k++) {
+            NodeLoad l = chunk->loads[k];
+            l.load_case += section;
+            if (l.load_case > 0) ctx->case_loads[load_count++] = l;
+        }
+        if (chunk->n_nodes > 0) memcpy(ctx->nodes + node_count, chunk->nodes, chunk->n_nodes * sizeof(Node));
+        if (chunk->n_members > 0) memcpy(ctx->members + member_count, chunk->members, chunk->n_members * sizeof(Member));
+        node_count += chunk->n_nodes;
+        member_count += chunk->n_members;
+        section += chunk->n_sections;
+        line_offset += chunk->n_lines;
+        
+        free(chunk->nodes);
+        free(chunk->members);
+        free(chunk->loads);
+        free(chunk->sections);
+        free(chunk->skipped);
+    }
+    ctx->n_case_loads = load_count;
+    ctx->n_load_cases = n_sections + 1;
+    ctx->node_loads_case = 0;
+    free(chunks);
+    
+    double elapsed = wall_time() - start_time;
+    double megabytes = size / 1e6;
+    log_warning(ctx, "Parsed %.1f MB in %.3f s (%.1f MB/s, %d chunks)\n",
+                megabytes, elapsed, elapsed > 0.0 ? megabytes / elapsed : 0.0, n_chunks);
+    
+    ctx->total_dofs = 3 * ctx->n_nodes;
+    log_message(ctx, "Found %d nodes and %d members\n", ctx->n_nodes, ctx->n_members);
+    
+    int status = resolve_node_ids(ctx);
+    if (status != TRUSS_OK) return status;
+    update_load_cases(ctx);
+    
+    log_message(ctx, "Successfully read %d nodes and %d members\n", ctx->n_nodes, ctx->n_members);
+    if (n_sections > 0) {
+        log_message(ctx, "Found %d load cases\n", ctx->n_load_cases);
+    }
+    return TRUSS_OK;
+}
+
+// Index the nodes, then turn the node IDs held by members and load-case
+// loads into node indices
+int resolve_node_ids(TrussContext *ctx) {
+    int duplicate = build_node_index(ctx);
+    if (duplicate == -2) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory indexing nodes");
+    if (duplicate >= 0) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Duplicate node ID %d", ctx->nodes[duplicate].id);
+    }
+    for (int i = 0; i < ctx->n_members; i++) {
+        Member *m = &ctx->members[i];
+        int node1_id = m->node1;
+        int node2_id = m->node2;
+        m->node1 = find_node_index(ctx, node1_id);
+        m->node2 = find_node_index(ctx, node2_id);
+        if (m->node1 == -1 || m->node2 == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID in member %d (nodes: %d->%d)",
+                             m->id, node1_id, node2_id);
+        }
+    }
+    for (int l = 0; l < ctx->n_case_loads; l++) {
+        int node_id = ctx->case_loads[l].node;
+        ctx->case_loads[l].node = find_node_index(ctx, node_id);
+        if (ctx->case_loads[l].node == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID %d in load case \"%s\"",
+                             node_id, ctx->load_cases[ctx->case_loads[l].load_case].name);
+        }
+    }
+    return TRUSS_OK;
+}
+
+// The node-table loads form a load case of their own, case 0, unless
+// other load cases exist and those loads are all zero. Brings the case
+// list in line with that rule after nodes or load cases change.
+void update_load_cases(TrussContext *ctx) {
+    int has_node_loads = 0;
+    for (int i = 0; i < ctx->n_nodes && !has_node_loads; i++) {
+        if (ctx->nodes[i].loads[0] != 0.0 || ctx->nodes[i].loads[1] != 0.0 || ctx->nodes[i].loads[2] != 0.0) {
+            has_node_loads = 1;
+        }
+    }
+    if (ctx->node_loads_case == 0 && ctx->n_load_cases > 1 && !has_node_loads) {
+        memmove(ctx->load_cases, ctx->load_cases + 1, (ctx->n_load_cases - 1) * sizeof(LoadCase));
+        for (int l = 0; l < ctx->n_case_loads; l++) ctx->case_loads[l].load_case--;
+        ctx->n_load_cases--;
+        ctx->node_loads_case = -1;
+    } else if (ctx->node_loads_case == -1 && (has_node_loads || ctx->n_load_cases == 0)) {
+        // load_cases always has room for one more case
+        memmove(ctx->load_cases + 1, ctx->load_cases, ctx->n_load_cases * sizeof(LoadCase));
+        strcpy(ctx->load_cases[0].name, "Node loads");
+        for (int l = 0; l < ctx->n_case_loads; l++) ctx->case_loads[l].load_case++;
+        ctx->n_load_cases++;
+        ctx->node_loads_case = 0;
+    }
+}
+
+// Free the load vectors and results, keeping the assembled stiffness
+// and its factorization for the next solve
+void reset_solution(TrussContext *ctx) {
+    arena_reset(&ctx->solve_arena);
+    ctx->F_global = NULL;
+    ctx->displacements = NULL;
+    ctx->reactions = NULL;
+    ctx->equilibrium = NULL;
+    ctx->member_results = NULL;
+    ctx->step_reports = NULL;
+    ctx->n_step_reports = 0;
+    ctx->mass = NULL;
+    ctx->modes = NULL;
+    ctx->n_modes = 0;
+    ctx->mode_shapes = NULL;
+    ctx->lanczos_vectors = 0;
+    ctx->lanczos_steps = 0;
+}
+
+// Free the analysis of the current model
+void reset_results(TrussContext *ctx) {
+    reset_solution(ctx);
+    solver_cache_free(&ctx->solver);
+    arena_reset(&ctx->model_arena);
+    memset(&ctx->K_global, 0, sizeof(SparseMatrix));
+    ctx->node_adj_ptr = NULL;
+    ctx->node_adj = NULL;
+    ctx->node_dofs = 0;
+    ctx->member_geometry = NULL;
+    ctx->n_member_colors = 0;
+    ctx->color_ptr = NULL;
+    ctx->color_members = NULL;
+}
+
+// Free the model and its analysis, leaving an empty model
+void reset_model(TrussContext *ctx) {
+    reset_results(ctx);
+    reset_variants(ctx);
+    reset_substructures(ctx);
+    free(ctx->nodes);
+    free(ctx->members);
+    free(ctx->load_cases);
+    free(ctx->case_loads);
+    free(ctx->node_index);
+    free(ctx->member_index);
+    ctx->n_nodes = 0;
+    ctx->n_members = 0;
+    ctx->total_dofs = 0;
+    ctx->nodes = NULL;
+    ctx->members = NULL;
+    ctx->load_cases = NULL;
+    ctx->n_load_cases = 0;
+    ctx->node_loads_case = -1;
+    ctx->case_loads = NULL;
+    ctx->n_case_loads = 0;
+    ctx->node_index = NULL;
+    ctx->node_index_mask = 0;
+    ctx->member_index = NULL;
+    ctx->member_index_mask = 0;
+}
+
+
+int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Build the CSR pattern of K_global from member connectivity. With d =
+// node_dofs, row d*i+a holds one d-column block per node adjacent to node
+// i, so storage grows with the number of members rather than with
+// n_nodes^2.
+int build_stiffness_pattern(TrussContext *ctx) {
+    // Node adjacency lists: every node couples to itself and to both ends
+    // of each member it belongs to, and with condensed substructures to
+    // the other boundary nodes of each instance it bounds
+    Arena *arena = &ctx->model_arena;
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int cliques = ctx->condense ? ctx->n_instances : 0;
+    ctx->node_adj_ptr = arena_calloc(arena, ctx->n_nodes + 1, sizeof(int));
+    if (!ctx->node_adj_ptr) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    for (int i = 0; i < ctx->n_nodes; i++) ctx->node_adj_ptr[i + 1] = 1;
+    for (int m = 0; m < ctx->n_members; m++) {
+        ctx->node_adj_ptr[ctx->members[m].node1 + 1]++;
+        ctx->node_adj_ptr[ctx->members[m].node2 + 1]++;
+    }
+    for (int k = 0; k < cliques; k++) {
+        const Instance *instance = &ctx->instances[k];
+        int nb = ctx->modules[instance->module].n_boundary;
+        for (int b = 0; b < nb; b++) ctx->node_adj_ptr[ctx->instance_boundary[instance->first_boundary + b] + 1] += nb;
+    }
+    for (int i = 0; i < ctx->n_nodes; i++) ctx->node_adj_ptr[i + 1] += ctx->node_adj_ptr[i];
+    
+    ctx->node_adj = arena_alloc(arena, ctx->node_adj_ptr[ctx->n_nodes] * sizeof(int));
+    int *fill = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    if (!ctx->node_adj || !fill) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    }
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        ctx->node_adj[ctx->node_adj_ptr[i]] = i;
+        fill[i] = ctx->node_adj_ptr[i] + 1;
+    }
+    for (int m = 0; m < ctx->n_members; m++) {
+        int i = ctx->members[m].node1;
+        int j = ctx->members[m].node2;
+        ctx->node_adj[fill[i]++] = j;
+        ctx->node_adj[fill[j]++] = i;
+    }
+    for (int k = 0; k < cliques; k++) {
+        const int *boundary = ctx->instance_boundary + ctx->instances[k].first_boundary;
+        int nb = ctx->modules[ctx->instances[k].module].n_boundary;
+        for (int b = 0; b < nb; b++) {
+            for (int c = 0; c < nb; c++) ctx->node_adj[fill[boundary[b]]++] = boundary[c];
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    
+    // Sort and remove duplicates (parallel members, self references),
+    // compacting the lists in place
+    int write = 0;
+    int start = 0;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        int end = ctx->node_adj_ptr[i + 1];
+        qsort(ctx->node_adj + start, end - start, sizeof(int), compare_ints);
+        ctx->node_adj_ptr[i] = write;
+        for (int p = start; p < end; p++) {
+            if (write == ctx->node_adj_ptr[i] || ctx->node_adj[write - 1] != ctx->node_adj[p]) {
+                ctx->node_adj[write++] = ctx->node_adj[p];
+            }
+        }
+        start = end;
+    }
+    ctx->node_adj_ptr[ctx->n_nodes] = write;
+    
+    // Expand node blocks to DOF rows
+    int d = ctx->node_dofs = model_is_planar(ctx) ? 2 : 3;
+    int n = ctx->K_global.n = d * ctx->n_nodes;
+    ctx->K_global.row_ptr = arena_alloc(arena, (n + 1) * sizeof(int));
+    if (!ctx->K_global.row_ptr) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    ctx->K_global.row_ptr[0] = 0;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        int row_len = d * (ctx->node_adj_ptr[i + 1] - ctx->node_adj_ptr[i]);
+        for (int a = 0; a < d; a++) {
+            ctx->K_global.row_ptr[d*i + a + 1] = ctx->K_global.row_ptr[d*i + a] + row_len;
+        }
+    }
+    ctx->K_global.nnz = ctx->K_global.row_ptr[n];
+    ctx->K_global.col_idx = arena_alloc(arena, ctx->K_global.nnz * sizeof(int));
+    ctx->K_global.values = arena_calloc(arena, ctx->K_global.nnz, sizeof(double));
+    if (!ctx->K_global.col_idx || !ctx->K_global.values) {
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    }
+    
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        for (int a = 0; a < d; a++) {
+            int *cols = &ctx->K_global.col_idx[ctx->K_global.row_ptr[d*i + a]];
+            for (int p = ctx->node_adj_ptr[i]; p < ctx->node_adj_ptr[i + 1]; p++) {
+                for (int b = 0; b < d; b++) *cols++ = d*ctx->node_adj[p] + b;
+            }
+        }
+    }
+    return TRUSS_OK;
+}
+
+// A model is planar when every node has Z fixed and the same Z
+// coordinate: members then have no Z component, the Z rows of the
+// stiffness are empty and the Z reactions just carry the Z loads
+int model_is_planar(const TrussContext *ctx) {
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        if (!ctx->nodes[i].constraints[2] || ctx->nodes[i].z != ctx->nodes[0].z) return 0;
+    }
+    return ctx->n_nodes > 0;
+}
+
+// Row or column of K_global as a DOF of the load and result vectors,
+// which hold 3 DOFs per node
+int full_dof(int dof, int node_dofs) {
+    return node_dofs == 3 ? dof : 3 * (dof / node_dofs) + dof % node_dofs;
+}
+
+// Position of node j within the adjacency list of node i
+int find_adjacent_node(TrussContext *ctx, int i, int j) {
+    int lo = ctx->node_adj_ptr[i];
+    int hi = ctx->node_adj_ptr[i + 1] - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (ctx->node_adj[mid] < j) lo = mid + 1;
+        else if (ctx->node_adj[mid] > j) hi = mid - 1;
+        else return mid - ctx->node_adj_ptr[i];
+    }
+    return -1;
+}
+
+// Build one load vector per load case
+int assemble_loads(TrussContext *ctx) {
+    ctx->F_global = arena_calloc(&ctx->solve_arena, (size_t)ctx->total_dofs * ctx->n_load_cases, sizeof(double));
+    if (!ctx->F_global) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the loads");
+    if (ctx->node_loads_case >= 0) {
+        double *F = ctx->F_global + (size_t)ctx->node_loads_case * ctx->total_dofs;
+        for (int i = 0; i < ctx->n_nodes; i++) {
+            F[3*i]   = ctx->nodes[i].loads[0];
+            F[3*i+1] = ctx->nodes[i].loads[1];
+            F[3*i+2] = ctx->nodes[i].loads[2];
+        }
+    }
+    for (int l = 0; l < ctx->n_case_loads; l++) {
+        double *F = ctx->F_global + (size_t)ctx->case_loads[l].load_case * ctx->total_dofs;
+        for (int a = 0; a < 3; a++) {
+            F[3*ctx->case_loads[l].node + a] += ctx->case_loads[l].loads[a];
+        }
+    }
+    return TRUSS_OK;
+}
+
+// Build the pattern of K_global, the member geometry and colors, and
+// scatter every member. On failure the partial analysis is freed.
+int assemble_global_stiffness(TrussContext *ctx) {
+    int status = build_stiffness_pattern(ctx);
+    if (status != TRUSS_OK) {
+        reset_results(ctx);
+        return status;
+    }
+    if (ctx->node_dofs == 2) log_warning(ctx, "Planar model: stiffness assembled with 2 DOFs per node\n");
+    Arena *arena = &ctx->model_arena;
+    MemberGeometry *g = arena_alloc(arena, sizeof(MemberGeometry));
+    if (!g) {
+        reset_results(ctx);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    }
+    g->x = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    g->y = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    g->z = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    g->node1 = arena_alloc(arena, ctx->n_members * sizeof(int));
+    g->node2 = arena_alloc(arena, ctx->n_members * sizeof(int));
+    g->ea = arena_alloc(arena, ctx->n_members * sizeof(double));
+    g->area = arena_alloc(arena, ctx->n_members * sizeof(double));
+    g->length = arena_alloc(arena, ctx->n_members * sizeof(double));
+    for (int a = 0; a < 3; a++) g->cos[a] = arena_alloc(arena, ctx->n_members * sizeof(double));
+    g->stiffness = arena_alloc(arena, ctx->n_members * sizeof(double));
+    if (!g->x || !g->y || !g->z || !g->node1 || !g->node2 || !g->ea || !g->area || !g->length ||
+        !g->cos[0] || !g->cos[1] || !g->cos[2] || !g->stiffness) {
+        reset_results(ctx);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the stiffness");
+    }
+    ctx->member_geometry = g;
+    compute_member_geometry(ctx);
+    status = build_member_colors(ctx);
+    if (status != TRUSS_OK) {
+        reset_results(ctx);
+        return status;
+    }
+    scatter_all_members(ctx);
+    ctx->stiffness_updated = 0;
+    return TRUSS_OK;
+}
+
+// Recompute member geometry and the values of K_global after nodes have
+// moved. Connectivity is unchanged, so the pattern and colors are kept
+// and everything is updated in place; the factorization is dropped. A
+// node moved out of (or back into) the plane of a planar model changes
+// the pattern, which is then built afresh.
+int update_member_geometry(TrussContext *ctx) {
+    if (ctx->node_dofs != (model_is_planar(ctx) ? 2 : 3)) {
+        reset_results(ctx);
+        return assemble_global_stiffness(ctx);
+    }
+    solver_cache_free(&ctx->solver);
+    compute_member_geometry(ctx);
+    reassemble_stiffness(ctx);
+    return TRUSS_OK;
+}
+
+// Assemble the values of K_global afresh from the member geometry
+void reassemble_stiffness(TrussContext *ctx) {
+    memset(ctx->K_global.values, 0, ctx->K_global.nnz * sizeof(double));
+    scatter_all_members(ctx);
+    ctx->stiffness_updated = 0;
+}
+
+// Assemble the stiffness matrix color by color
+void scatter_all_members(TrussContext *ctx) {
+    for (int c = 0; c < ctx->n_member_colors; c++) {
+        #pragma omp parallel for schedule(static)
+        for (int idx = ctx->color_ptr[c]; idx < ctx->color_ptr[c + 1]; idx++) {
+            int m = ctx->color_members[idx];
+            scatter_member_stiffness(ctx, m, ctx->member_geometry->stiffness[m]);
+        }
+    }
+}
+
+// Add member m's element stiffness, scaled to axial stiffness k, into
+// K_global
+void scatter_member_stiffness(TrussContext *ctx, int m, double k) {
+    scatter_member_tangent(ctx, ctx->member_geometry, m, k, 0.0, ctx->K_global.values);
+}
+
+// Add member m's tangent stiffness with direction cosines from g into
+// values, which has the pattern of K_global: k along the member and the
+// geometric stiffness kg, its axial force over its length, across it.
+// With kg = 0 this is the linear element stiffness.
+void scatter_member_tangent(TrussContext *ctx, const MemberGeometry *g, int m, double k, double kg, double *values) {
+    if (ctx->node_dofs == 2) {
+        scatter_member_tangent2(ctx, g, m, k, kg, values);
+    } else {
+        scatter_member_tangent3(ctx, g, m, k, kg, values);
+    }
+}
+
+// scatter_member_tangent for D DOFs per node. Expanded once for planar
+// and once for space models, so the 2D x 2D element matrix and its loops
+// have constant sizes.
+#define DEFINE_SCATTER_MEMBER_TANGENT(D) \
+void scatter_member_tangent##D(TrussContext *ctx, const MemberGeometry *g, int m, double k, double kg, \
+                               double *values) { \
+    int elem_nodes[2] = {ctx->members[m].node1, ctx->members[m].node2}; \
+    double c[D]; \
+    for (int a = 0; a < D; a++) c[a] = g->cos[a][m]; \
+    \
+    /* Element stiffness matrix in global coordinates: the DxD block */ \
+    /* k c c^T + kg (I - c c^T), positive on the diagonal blocks */ \
+    double ke[2*D][2*D]; \
+    for (int a = 0; a < D; a++) { \
+        for (int b = 0; b < D; b++) { \
+            double kab = (k - kg) * c[a] * c[b] + (a == b ? kg : 0.0); \
+            ke[a][b] = kab; \
+            ke[a][b + D] = -kab; \
+            ke[a + D][b] = -kab; \
+            ke[a + D][b + D] = kab; \
+        } \
+    } \
+    \
+    /* Column offset of each node pair's block within the rows of the */ \
+    /* first node */ \
+    int block_col[2][2]; \
+    for (int a = 0; a < 2; a++) { \
+        for (int b = 0; b < 2; b++) { \
+            block_col[a][b] = D * find_adjacent_node(ctx, elem_nodes[a], elem_nodes[b]); \
+        } \
+    } \
+    \
+    for (int p = 0; p < 2*D; p++) { \
+        double *row_values = &values[ctx->K_global.row_ptr[D*elem_nodes[p / D] + p % D]]; \
+        for (int q = 0; q < 2*D; q++) { \
+            row_values[block_col[p / D][q / D] + q % D] += ke[p][q]; \
+        } \
+    } \
+}
+
+DEFINE_SCATTER_MEMBER_TANGENT(2)
+DEFINE_SCATTER_MEMBER_TANGENT(3)
+
+// Copy the nodes and members into ctx->member_geometry, then compute the
+// length, direction cosines and axial stiffness of every member
+void compute_member_geometry(TrussContext *ctx) {
+    MemberGeometry *g = ctx->member_geometry;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        g->x[i] = ctx->nodes[i].x;
+        g->y[i] = ctx->nodes[i].y;
+        g->z[i] = ctx->nodes[i].z;
+    }
+    for (int m = 0; m < ctx->n_members; m++) {
+        g->node1[m] = ctx->members[m].node1;
+        g->node2[m] = ctx->members[m].node2;
+        g->ea[m] = ctx->members[m].E * ctx->members[m].A;
+        g->area[m] = ctx->members[m].A;
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < ctx->n_members; b += MEMBER_BATCH) {
+        member_geometry_kernel(g, b, b + MEMBER_BATCH < ctx->n_members ? b + MEMBER_BATCH : ctx->n_members);
+    }
+}
+
+// Geometry of members begin..end-1
+SIMD_CLONES
+void member_geometry_kernel(MemberGeometry *g, int begin, int end) {
+    #pragma omp simd
+    for (int m = begin; m < end; m++) {
+        int i = g->node1[m];
+        int j = g->node2[m];
+        double dx = g->x[j] - g->x[i];
+        double dy = g->y[j] - g->y[i];
+        double dz = g->z[j] - g->z[i];
+        double L = sqrt(dx*dx + dy*dy + dz*dz);
+        g->length[m] = L;
+        g->cos[0][m] = dx/L;
+        g->cos[1][m] = dy/L;
+        g->cos[2][m] = dz/L;
+        g->stiffness[m] = g->ea[m] / L;
+    }
+}
+
+// Greedy member coloring: each member takes the lowest color not already
+// used by a member at either of its nodes. Runs serially in member order,
+// so the coloring does not depend on the thread count.
+int build_member_colors(TrussContext *ctx) {
+    // Node-to-member incidence lists
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *inc_ptr = arena_calloc(&ctx->scratch, ctx->n_nodes + 1, sizeof(int));
+    if (!inc_ptr) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory coloring the members");
+    for (int m = 0; m < ctx->n_members; m++) {
+        inc_ptr[ctx->members[m].node1 + 1]++;
+        inc_ptr[ctx->members[m].node2 + 1]++;
+    }
+    for (int i = 0; i < ctx->n_nodes; i++) inc_ptr[i + 1] += inc_ptr[i];
+    int *inc = arena_alloc(&ctx->scratch, inc_ptr[ctx->n_nodes] * sizeof(int));
+    int *fill = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    if (!inc || !fill) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory coloring the members");
+    }
+    memcpy(fill, inc_ptr, ctx->n_nodes * sizeof(int));
+    for (int m = 0; m < ctx->n_members; m++) {
+        inc[fill[ctx->members[m].node1]++] = m;
+        inc[fill[ctx->members[m].node2]++] = m;
+    }
+    
+    // Colors never exceed twice the largest node degree
+    int max_degree = 0;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        if (inc_ptr[i + 1] - inc_ptr[i] > max_degree) max_degree = inc_ptr[i + 1] - inc_ptr[i];
+    }
+    int *color = arena_alloc(&ctx->scratch, ctx->n_members * sizeof(int));
+    int *used = arena_alloc(&ctx->scratch, (2 * max_degree + 1) * sizeof(int));
+    if (!color || !used) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory coloring the members");
+    }
+    for (int c = 0; c < 2 * max_degree + 1; c++) used[c] = -1;
+    
+    ctx->n_member_colors = 0;
+    for (int m = 0; m < ctx->n_members; m++) {
+        int ends[2] = {ctx->members[m].node1, ctx->members[m].node2};
+        for (int e = 0; e < 2; e++) {
+            for (int p = inc_ptr[ends[e]]; p < inc_ptr[ends[e] + 1]; p++) {
+                if (inc[p] < m) used[color[inc[p]]] = m;
+            }
+        }
+        int c = 0;
+        while (used[c] == m) c++;
+        color[m] = c;
+        if (c + 1 > ctx->n_member_colors) ctx->n_member_colors = c + 1;
+    }
+    
+    // Bucket members by color, keeping member order within each color
+    ctx->color_ptr = arena_calloc(&ctx->model_arena, ctx->n_member_colors + 1, sizeof(int));
+    ctx->color_members = arena_alloc(&ctx->model_arena, ctx->n_members * sizeof(int));
+    fill = arena_alloc(&ctx->scratch, ctx->n_member_colors * sizeof(int));
+    if (!ctx->color_ptr || !ctx->color_members || !fill) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory coloring the members");
+    }
+    for (int m = 0; m < ctx->n_members; m++) ctx->color_ptr[color[m] + 1]++;
+    for (int c = 0; c < ctx->n_member_colors; c++) ctx->color_ptr[c + 1] += ctx->color_ptr[c];
+    memcpy(fill, ctx->color_ptr, ctx->n_member_colors * sizeof(int));
+    for (int m = 0; m < ctx->n_members; m++) ctx->color_members[fill[color[m]]++] = m;
+    
+    arena_release(&ctx->scratch, mark);
+    return TRUSS_OK;
+}
+
+// Extract the rows and columns of the free DOFs into a new CSR matrix
+// allocated from arena. K has node_dofs rows per node and dof_map 3 DOFs
+// per node. Nodes may be renumbered, so each row is placed by its reduced
+// DOF and its columns sorted again; every node's DOFs stay consecutive,
+// so a row is a few runs of ascending columns. Returns 0, or -1 when
+// out of memory.
+int sparse_extract_free(const SparseMatrix *K, int node_dofs, const int *dof_map, int n_free, SparseMatrix *out,
+                        Arena *arena) {
+    out->n = n_free;
+    out->nnz = 0;
+    out->col_idx = NULL;
+    out->values = NULL;
+    out->row_ptr = arena_calloc(arena, n_free + 1, sizeof(int));
+    if (!out->row_ptr) return -1;
+    
+    for (int i = 0; i < K->n; i++) {
+        int row = dof_map[full_dof(i, node_dofs)];
+        if (row < 0) continue;
+        int count = 0;
+        for (int p = K->row_ptr[i]; p < K->row_ptr[i + 1]; p++) {
+            if (dof_map[full_dof(K->col_idx[p], node_dofs)] >= 0) count++;
+        }
+        out->row_ptr[row + 1] = count;
+    }
+    for (int r = 0; r < n_free; r++) out->row_ptr[r + 1] += out->row_ptr[r];
+    int nnz = out->row_ptr[n_free];
+    out->nnz = nnz;
+    out->col_idx = arena_alloc(arena, nnz * sizeof(int));
+    out->values = arena_alloc(arena, nnz * sizeof(double));
+    if (!out->col_idx || !out->values) return -1;
+    
+    for (int i = 0; i < K->n; i++) {
+        int row = dof_map[full_dof(i, node_dofs)];
+        if (row < 0) continue;
+        int start = out->row_ptr[row];
+        int pos = start;
+        for (int p = K->row_ptr[i]; p < K->row_ptr[i + 1]; p++) {
+            int j_red = dof_map[full_dof(K->col_idx[p], node_dofs)];
+            if (j_red < 0) continue;
+            double value = K->values[p];
+            int q = pos++;
+            while (q > start && out->col_idx[q - 1] > j_red) {
+                out->col_idx[q] = out->col_idx[q - 1];
+                out->values[q] = out->values[q - 1];
+                q--;
+            }
+            out->col_idx[q] = j_red;
+            out->values[q] = value;
+        }
+    }
+    return 0;
+}
+
+// Diagonal of the square CSR matrix A into diag
+void sparse_diagonal(const SparseMatrix *A, double *diag) {
+    for (int i = 0; i < A->n; i++) {
+        diag[i] = 0.0;
+        for (int p = A->row_ptr[i]; p < A->row_ptr[i + 1]; p++) {
+            if (A->col_idx[p] == i) diag[i] = A->values[p];
+        }
+    }
+}
+
+int compare_node_keys(const void *a, const void *b) {
+    const NodeKey *x = a;
+    const NodeKey *y = b;
+    if (x->key < y->key) return -1;
+    if (x->key > y->key) return 1;
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+// Recursive step of nested dissection on the node subset[0..count).
+// The subset is split at the coordinate median along its longest extent;
+// the nodes on one side of the cut that touch the other side form the
+// separator, which is numbered after both halves so that eliminating
+// either half never fills into the other.
+void dissect_nodes(TrussContext *ctx, int *subset, int count, int *part, int *stamp, NodeKey *keys,
+                   int *order, int *n_ordered) {
+    if (count <= ND_LEAF_SIZE) {
+        for (int p = 0; p < count; p++) order[(*n_ordered)++] = subset[p];
+        return;
+    }
+    
+    // Longest coordinate extent of the subset
+    double lo[3] = {INFINITY, INFINITY, INFINITY};
+    double hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (int p = 0; p < count; p++) {
+        const Node *nd = &ctx->nodes[subset[p]];
+        double c[3] = {nd->x, nd->y, nd->z};
+        for (int a = 0; a < 3; a++) {
+            if (c[a] < lo[a]) lo[a] = c[a];
+            if (c[a] > hi[a]) hi[a] = c[a];
+        }
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+    }
+    
+    for (int p = 0; p < count; p++) {
+        const Node *nd = &ctx->nodes[subset[p]];
+        keys[p].key = axis == 0 ? nd->x : (axis == 1 ? nd->y : nd->z);
+        keys[p].node = subset[p];
+    }
+    qsort(keys, count, sizeof(NodeKey), compare_node_keys);
+    
+    int half = count / 2;
+    int side_a = 3 * (*stamp);
+    int side_b = side_a + 1;
+    int separator = side_a + 2;
+    (*stamp)++;
+    for (int p = 0; p < count; p++) {
+        part[keys[p].node] = p < half ? side_a : side_b;
+    }
+    
+    // Boundary size on each side of the cut; the smaller one separates
+    int boundary[2] = {0, 0};
+    for (int p = 0; p < count; p++) {
+        int i = keys[p].node;
+        int other = part[i] == side_a ? side_b : side_a;
+        for (int q = ctx->node_adj_ptr[i]; q < ctx->node_adj_ptr[i + 1]; q++) {
+            if (part[ctx->node_adj[q]] == other) {
+                boundary[part[i] - side_a]++;
+                break;
+            }
+        }
+    }
+    int sep_side = boundary[0] <= boundary[1] ? side_a : side_b;
+    int other_side = sep_side == side_a ? side_b : side_a;
+    for (int p = 0; p < count; p++) {
+        int i = keys[p].node;
+        if (part[i] != sep_side) continue;
+        for (int q = ctx->node_adj_ptr[i]; q < ctx->node_adj_ptr[i + 1]; q++) {
+            if (part[ctx->node_adj[q]] == other_side) {
+                part[i] = separator;
+                break;
+            }
+        }
+    }
+    
+    // Regroup subset as [side a | side b | separator] in key order
+    int n_a = 0, n_b = 0, n_sep = 0;
+    for (int p = 0; p < count; p++) {
+        int label = part[keys[p].node];
+        if (label == side_a) n_a++;
+        else if (label == side_b) n_b++;
+        else n_sep++;
+    }
+    int pos_a = 0, pos_b = n_a, pos_sep = n_a + n_b;
+    for (int p = 0; p < count; p++) {
+        int i = keys[p].node;
+        if (part[i] == side_a) subset[pos_a++] = i;
+        else if (part[i] == side_b) subset[pos_b++] = i;
+        else subset[pos_sep++] = i;
+    }
+    
+    dissect_nodes(ctx, subset, n_a, part, stamp, keys, order, n_ordered);
+    dissect_nodes(ctx, subset + n_a, n_b, part, stamp, keys, order, n_ordered);
+    for (int p = n_a + n_b; p < count; p++) order[(*n_ordered)++] = subset[p];
+}
+
+// Half-bandwidth and envelope (profile) size of the reduced stiffness
+// under a DOF numbering. Every row's envelope runs from the lowest DOF it
+// couples to up to the diagonal, and all DOFs of a node couple to the
+// same nodes.
+void reduced_envelope(const TrussContext *ctx, const int *dof_map, long long *bandwidth, long long *envelope) {
+    *bandwidth = 0;
+    *envelope = 0;
+    if (!ctx->node_adj) return;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        int first = ctx->total_dofs;
+        for (int p = ctx->node_adj_ptr[i]; p < ctx->node_adj_ptr[i + 1]; p++) {
+            int j = ctx->node_adj[p];
+            for (int a = 0; a < 3; a++) {
+                if (dof_map[3*j + a] >= 0 && dof_map[3*j + a] < first) first = dof_map[3*j + a];
+            }
+        }
+        for (int a = 0; a < 3; a++) {
+            int row = dof_map[3*i + a];
+            if (row < 0) continue;
+            if (row - first > *bandwidth) *bandwidth = row - first;
+            *envelope += row - first;
+        }
+    }
+}
+
+// Free neighbours of node i, excluding itself
+int free_degree(const TrussContext *ctx, const int *dof_map, int i) {
+    int degree = 0;
+    for (int p = ctx->node_adj_ptr[i]; p < ctx->node_adj_ptr[i + 1]; p++) {
+        int j = ctx->node_adj[p];
+        if (j != i && (dof_map[3*j] >= 0 || dof_map[3*j + 1] >= 0 || dof_map[3*j + 2] >= 0)) degree++;
+    }
+    return degree;
+}
+
+// Breadth-first search over the nodes with free DOFs from root, marking
+// them with stamp and appending them to queue in visiting order. With
+// degree given, each node's unvisited neighbours are queued by increasing
+// degree, then index (the Cuthill-McKee order). Returns the number of
+// levels; *last_level is the queue position where the deepest one starts.
+int node_bfs(const TrussContext *ctx, const int *dof_map, const int *degree, int root, int *mark, int stamp,
+             int *queue, int *count, int *last_level) {
+    int head = *count;
+    queue[(*count)++] = root;
+    mark[root] = stamp;
+    int levels = 0;
+    while (head < *count) {
+        int level_end = *count;
+        *last_level = head;
+        levels++;
+        for (; head < level_end; head++) {
+            int i = queue[head];
+            int added = *count;
+            for (int p = ctx->node_adj_ptr[i]; p < ctx->node_adj_ptr[i + 1]; p++) {
+                int j = ctx->node_adj[p];
+                if (mark[j] == stamp || !(dof_map[3*j] >= 0 || dof_map[3*j + 1] >= 0 || dof_map[3*j + 2] >= 0)) continue;
+                mark[j] = stamp;
+                queue[(*count)++] = j;
+            }
+            if (!degree) continue;
+            for (int a = added + 1; a < *count; a++) {
+                int j = queue[a];
+                int b = a;
+                while (b > added && (degree[queue[b - 1]] > degree[j] ||
+                                     (degree[queue[b - 1]] == degree[j] && queue[b - 1] > j))) {
+                    queue[b] = queue[b - 1];
+                    b--;
+                }
+                queue[b] = j;
+            }
+        }
+    }
+    return levels;
+}
+
+// Reverse Cuthill-McKee order of the nodes with free DOFs. Each
+// connected part starts from a pseudo-peripheral node, the end of a
+// longest breadth-first search found by the George-Liu iteration, and
+// the order is the same for any thread count. Returns the number of
+// nodes written to order, or -1 when out of memory.
+int rcm_order(TrussContext *ctx, const int *dof_map, int *order) {
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *degree = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    int *stamps = arena_calloc(&ctx->scratch, ctx->n_nodes, sizeof(int));
+    int *queue = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    if (!degree || !stamps || !queue) {
+        arena_release(&ctx->scratch, mark);
+        return -1;
+    }
+    for (int i = 0; i < ctx->n_nodes; i++) degree[i] = free_degree(ctx, dof_map, i);
+    
+    int n_ordered = 0;
+    int stamp = 1;      // stamp 1 marks ordered nodes, later ones trial searches
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        if (stamps[i] == 1 || !(dof_map[3*i] >= 0 || dof_map[3*i + 1] >= 0 || dof_map[3*i + 2] >= 0)) continue;
+        
+        // Pseudo-peripheral root: move to the lowest-degree node of the
+        // deepest level while that makes the search deeper
+        int root = i;
+        int count = 0, last_level;
+        int levels = node_bfs(ctx, dof_map, NULL, root, stamps, ++stamp, queue, &count, &last_level);
+        for (int iteration = 0; iteration < 8; iteration++) {
+            int candidate = queue[last_level];
+            for (int q = last_level + 1; q < count; q++) {
+                if (degree[queue[q]] < degree[candidate]) candidate = queue[q];
+            }
+            int trial_count = 0, trial_last;
+            int trial_levels = node_bfs(ctx, dof_map, NULL, candidate, stamps, ++stamp, queue, &trial_count, &trial_last);
+            if (trial_levels <= levels) break;
+            root = candidate;
+            levels = trial_levels;
+            count = trial_count;
+            last_level = trial_last;
+        }
+        node_bfs(ctx, dof_map, degree, root, stamps, 1, order, &n_ordered, &last_level);
+    }
+    
+    for (int a = 0, b = n_ordered - 1; a < b; a++, b--) {
+        int tmp = order[a];
+        order[a] = order[b];
+        order[b] = tmp;
+    }
+    arena_release(&ctx->scratch, mark);
+    return n_ordered;
+}
+
+// Fill-reducing elimination order of the nodes that carry at least one
+// free DOF. Returns the number of nodes written to order, or -1 when
+// out of memory.
+int nested_dissection_order(TrussContext *ctx, const int *dof_map, int *order) {
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *subset = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    int *part = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    NodeKey *keys = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(NodeKey));
+    if (!subset || !part || !keys) {
+        arena_release(&ctx->scratch, mark);
+        return -1;
+    }
+    
+    // Fully restrained nodes drop out of the reduced system; labelling
+    // them -1 keeps them out of every cut
+    int count = 0;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        part[i] = -1;
+        if (dof_map[3*i] >= 0 || dof_map[3*i + 1] >= 0 || dof_map[3*i + 2] >= 0) {
+            subset[count++] = i;
+        }
+    }
+    
+    int stamp = 0;
+    int n_ordered = 0;
+    dissect_nodes(ctx, subset, count, part, &stamp, keys, order, &n_ordered);
+    
+    arena_release(&ctx->scratch, mark);
+    return n_ordered;
+}
+
+// C = P A P^T for the symmetric permutation perm (perm[k] = old index of
+// new row k), with column indices sorted within each row. C and a work
+// array come from arena. Returns 0, or -1 when out of memory.
+int sparse_permute(const SparseMatrix *A, const int *perm, SparseMatrix *C, Arena *arena) {
+    int n = A->n;
+    C->n = n;
+    C->nnz = A->nnz;
+    C->row_ptr = arena_alloc(arena, (n + 1) * sizeof(int));
+    C->col_idx = arena_alloc(arena, A->nnz * sizeof(int));
+    C->values = arena_alloc(arena, A->nnz * sizeof(double));
+    int *iperm = arena_alloc(arena, n * sizeof(int));
+    if (!C->row_ptr || !C->col_idx || !C->values || !iperm) return -1;
+    for (int k = 0; k < n; k++) iperm[perm[k]] = k;
+    C->row_ptr[0] = 0;
+    
+    for (int k = 0; k < n; k++) {
+        int row = perm[k];
+        int start = C->row_ptr[k];
+        int len = A->row_ptr[row + 1] - A->row_ptr[row];
+        for (int p = 0; p < len; p++) {
+            // Insertion sort; rows hold a few dozen entries
+            int col = iperm[A->col_idx[A->row_ptr[row] + p]];
+            double val = A->values[A->row_ptr[row] + p];
+            int q = start + p;
+            while (q > start && C->col_idx[q - 1] > col) {
+                C->col_idx[q] = C->col_idx[q - 1];
+                C->values[q] = C->values[q - 1];
+                q--;
+            }
+            C->col_idx[q] = col;
+            C->values[q] = val;
+        }
+        C->row_ptr[k + 1] = start + len;
+    }
+    return 0;
+}
+
+// Symbolic analysis: elimination tree, column counts, fundamental
+// supernodes and the row structure of each supernode panel. The
+// structure of L comes from arena, work arrays from scratch. Returns 0,
+// or -1 when out of memory.
+int cholesky_analyze(const SparseMatrix *C, CholeskyFactor *L, Arena *arena, Arena *scratch) {
+    int n = C->n;
+    ArenaMark scratch_mark = arena_mark(scratch);
+    int *parent = arena_alloc(scratch, n * sizeof(int));
+    int *ancestor = arena_alloc(scratch, n * sizeof(int));
+    int *colcount = arena_calloc(scratch, n, sizeof(int));
+    int *n_children = arena_calloc(scratch, n, sizeof(int));
+    int *mark = arena_alloc(scratch, n * sizeof(int));
+    L->n = n;
+    L->col_super = arena_alloc(arena, n * sizeof(int));
+    L->super_start = arena_alloc(arena, (n + 1) * sizeof(int));
+    if (!parent || !ancestor || !colcount || !n_children || !mark || !L->col_super || !L->super_start) {
+        arena_release(scratch, scratch_mark);
+        return -1;
+    }
+    
+    // Elimination tree (Liu's algorithm with path compression)
+    for (int k = 0; k < n; k++) {
+        parent[k] = -1;
+        ancestor[k] = -1;
+        for (int p = C->row_ptr[k]; p < C->row_ptr[k + 1] && C->col_idx[p] < k; p++) {
+            int i = C->col_idx[p];
+            while (i != -1 && i < k) {
+                int next = ancestor[i];
+                ancestor[i] = k;
+                if (next == -1) parent[i] = k;
+                i = next;
+            }
+        }
+    }
+    
+    // Column counts: row k of L is the union of the etree paths from each
+    // off-diagonal entry of row k of A up to k
+    for (int k = 0; k < n; k++) {
+        mark[k] = k;
+        colcount[k]++;
+        for (int p = C->row_ptr[k]; p < C->row_ptr[k + 1] && C->col_idx[p] < k; p++) {
+            for (int i = C->col_idx[p]; mark[i] != k; i = parent[i]) {
+                colcount[i]++;
+                mark[i] = k;
+            }
+        }
+        if (parent[k] != -1) n_children[parent[k]]++;
+    }
+    
+    // Fundamental supernodes: column j extends the supernode of j-1 when
+    // it is j-1's only child's parent and the structures nest exactly
+    int ns = 0;
+    for (int j = 0; j < n; j++) {
+        if (j == 0 || parent[j - 1] != j || colcount[j - 1] != colcount[j] + 1 || n_children[j] != 1) {
+            L->super_start[ns++] = j;
+        }
+        L->col_super[j] = ns - 1;
+    }
+    L->super_start[ns] = n;
+    L->n_super = ns;
+    
+    // Row structures, merging each supernode's own entries with those of
+    // its children in the supernodal elimination tree
+    int *child_head = arena_alloc(scratch, ns * sizeof(int));
+    int *child_next = arena_alloc(scratch, ns * sizeof(int));
+    L->struct_ptr = arena_alloc(arena, (ns + 1) * sizeof(int));
+    L->panel_ptr = arena_alloc(arena, (ns + 1) * sizeof(size_t));
+    if (!child_head || !child_next || !L->struct_ptr || !L->panel_ptr) {
+        arena_release(scratch, scratch_mark);
+        return -1;
+    }
+    for (int s = 0; s < ns; s++) child_head[s] = -1;
+    for (int s = ns - 1; s >= 0; s--) {
+        int last = L->super_start[s + 1] - 1;
+        if (parent[last] != -1) {
+            int ps = L->col_super[parent[last]];
+            child_next[s] = child_head[ps];
+            child_head[ps] = s;
+        }
+    }
+    
+    L->struct_ptr[0] = 0;
+    L->panel_ptr[0] = 0;
+    for (int s = 0; s < ns; s++) {
+        int ncols = L->super_start[s + 1] - L->super_start[s];
+        int nrows = colcount[L->super_start[s]];
+        L->struct_ptr[s + 1] = L->struct_ptr[s] + nrows;
+        L->panel_ptr[s + 1] = L->panel_ptr[s] + (size_t)nrows * ncols;
+    }
+    L->struct_idx = arena_alloc(arena, L->struct_ptr[ns] * sizeof(int));
+    if (!L->struct_idx) {
+        arena_release(scratch, scratch_mark);
+        return -1;
+    }
+    
+    for (int i = 0; i < n; i++) mark[i] = -1;
+    for (int s = 0; s < ns; s++) {
+        int f = L->super_start[s];
+        int l = L->super_start[s + 1] - 1;
+        int *rows = &L->struct_idx[L->struct_ptr[s]];
+        int len = 0;
+        for (int c = f; c <= l; c++) {
+            rows[len++] = c;
+            mark[c] = s;
+        }
+        for (int c = f; c <= l; c++) {
+            for (int p = C->row_ptr[c]; p < C->row_ptr[c + 1]; p++) {
+                int i = C->col_idx[p];
+                if (i > l && mark[i] != s) {
+                    mark[i] = s;
+                    rows[len++] = i;
+                }
+            }
+        }
+        for (int t = child_head[s]; t != -1; t = child_next[t]) {
+            for (int p = L->struct_ptr[t]; p < L->struct_ptr[t + 1]; p++) {
+                int i = L->struct_idx[p];
+                if (i > l && mark[i] != s) {
+                    mark[i] = s;
+                    rows[len++] = i;
+                }
+            }
+        }
+        qsort(rows + (l - f + 1), len - (l - f + 1), sizeof(int), compare_ints);
+    }
+    
+    arena_release(scratch, scratch_mark);
+    return 0;
+}
+
+// Left-looking supernodal Cholesky factorization of A in the order perm,
+// with the panels in double precision, or in single precision when
+// single is set. Each supernode is a dense column-major panel;
+// descendants that touch it are queued on a linked list keyed by their
+// next row and applied as one dense block update before the panel itself
+// is factored.
+// When the panels would take more than spill's budget (spill may be NULL
+// for no limit) the factor goes out of core: half the budget holds the
+// latest panels and the older ones are written to the spill file, which
+// leaves the other half for the buffers that stream them back in solves.
+// L is allocated from arena and the permuted matrix and work arrays from
+// scratch. Pivots are tested against pivot_diag, in A's order, or A's
+// own diagonal when it is NULL. Returns -1 on success, the reduced DOF at
+// which A is found not to be positive definite, CHOLESKY_SPILL_FAILED or
+// CHOLESKY_OUT_OF_MEMORY.
+int cholesky_factor(const SparseMatrix *A, const double *pivot_diag, const int *perm, int single, CholeskyFactor *L,
+                    SpillFile *spill, Arena *arena, Arena *scratch) {
+    int n = A->n;
+    L->perm = arena_alloc(arena, n * sizeof(int));
+    if (!L->perm) return CHOLESKY_OUT_OF_MEMORY;
+    memcpy(L->perm, perm, n * sizeof(int));
+    
+    ArenaMark mark = arena_mark(scratch);
+    SparseMatrix C;
+    if (sparse_permute(A, perm, &C, scratch) != 0 || cholesky_analyze(&C, L, arena, scratch) != 0) {
+        arena_release(scratch, mark);
+        return CHOLESKY_OUT_OF_MEMORY;
+    }
+    
+    size_t element = single ? sizeof(float) : sizeof(double);
+    size_t window = L->panel_ptr[L->n_super];
+    L->max_panel = 1;
+    for (int s = 0; s < L->n_super; s++) {
+        size_t size = L->panel_ptr[s + 1] - L->panel_ptr[s];
+        if (size > L->max_panel) L->max_panel = size;
+    }
+    L->first_resident = 0;
+    L->resident_offset = 0;
+    L->spill = NULL;
+    L->min_pivot = INFINITY;
+    L->max_pivot = 0.0;
+    if (spill && spill->budget > 0 && window * element > (size_t)spill->budget) {
+        window = (size_t)spill->budget / 2 / element;
+        if (window < L->max_panel) window = L->max_panel;
+        if (spill_open(spill) != 0) {
+            arena_release(scratch, mark);
+            return CHOLESKY_SPILL_FAILED;
+        }
+        L->spill = spill;
+    } else if (spill) {
+        spill_close(spill);
+    }
+    
+    int failed;
+    L->panels = NULL;
+    L->panels_single = NULL;
+    if (single) {
+        L->panels_single = arena_alloc(arena, window * sizeof(float));
+        failed = L->panels_single ? cholesky_numeric_single(&C, pivot_diag, perm, L, window, scratch)
+                                  : CHOLESKY_OUT_OF_MEMORY;
+    } else {
+        L->panels = arena_alloc(arena, window * sizeof(double));
+        failed = L->panels ? cholesky_numeric_double(&C, pivot_diag, perm, L, window, scratch)
+                           : CHOLESKY_OUT_OF_MEMORY;
+    }
+    arena_release(scratch, mark);
+    return failed;
+}
+
+// Numeric factorization of the permuted matrix C into the panels of L
+// (PANELS, of element type T), and the forward and back substitutions
+// with them on X, n x nb row-major in elimination order. Expanded once
+// per precision; the substitutions accumulate in double either way.
+// An out-of-core factorization holds window entries of the latest panels
+// in PANELS and writes the oldest out, half the window at a time, when
+// the next panel does not fit; a descendant that has been written out is
+// read back to update a panel, prefetching the next one meanwhile. The
+// substitutions apply supernodes s0..s1-1, whose panels are in panels
+// from entry offset of the factor on.
+#define DEFINE_CHOLESKY_KERNELS(T, SUFFIX, PANELS) \
+int cholesky_numeric_##SUFFIX(const SparseMatrix *C, const double *pivot_diag, const int *perm, CholeskyFactor *L, \
+                              size_t window, Arena *scratch) { \
+    int ns = L->n_super; \
+    T *work = arena_alloc(scratch, L->max_panel * sizeof(T)); \
+    T *spilled = L->spill ? arena_alloc(scratch, L->max_panel * sizeof(T)) : NULL; \
+    int *relmap = arena_alloc(scratch, C->n * sizeof(int)); \
+    int *head = arena_alloc(scratch, ns * sizeof(int)); \
+    int *link = arena_alloc(scratch, ns * sizeof(int)); \
+    int *next_row = arena_alloc(scratch, ns * sizeof(int)); \
+    if (!work || (L->spill && !spilled) || !relmap || !head || !link || !next_row) return CHOLESKY_OUT_OF_MEMORY; \
+    for (int s = 0; s < ns; s++) head[s] = -1; \
+\
+    int failed = -1; \
+    for (int s = 0; s < ns && failed == -1; s++) { \
+        int f = L->super_start[s]; \
+        int ncols = L->super_start[s + 1] - f; \
+        int nrows = L->struct_ptr[s + 1] - L->struct_ptr[s]; \
+        const int *rows = &L->struct_idx[L->struct_ptr[s]]; \
+        if (L->panel_ptr[s + 1] - L->resident_offset > window) { \
+            int keep = L->first_resident; \
+            while (keep < s && L->panel_ptr[s + 1] - L->panel_ptr[keep] > window / 2) keep++; \
+            size_t written = L->panel_ptr[keep] - L->resident_offset; \
+            if (spill_write(L->spill, L->PANELS, written * sizeof(T), L->resident_offset * sizeof(T)) != 0) { \
+                failed = CHOLESKY_SPILL_FAILED; \
+                break; \
+            } \
+            memmove(L->PANELS, L->PANELS + written, (L->panel_ptr[s] - L->panel_ptr[keep]) * sizeof(T)); \
+            L->first_resident = keep; \
+            L->resident_offset = L->panel_ptr[keep]; \
+        } \
+        T *P = &L->PANELS[L->panel_ptr[s] - L->resident_offset]; \
+\
+        for (int r = 0; r < nrows; r++) relmap[rows[r]] = r; \
+        memset(P, 0, (size_t)nrows * ncols * sizeof(T)); \
+\
+        /* Scatter the lower triangle of A's columns f..l */ \
+        for (int c = 0; c < ncols; c++) { \
+            for (int p = C->row_ptr[f + c]; p < C->row_ptr[f + c + 1]; p++) { \
+                if (C->col_idx[p] >= f + c) { \
+                    P[relmap[C->col_idx[p]] + (size_t)c * nrows] = C->values[p]; \
+                } \
+            } \
+        } \
+\
+        /* Updates from descendant supernodes */ \
+        int d = head[s]; \
+        head[s] = -1; \
+        while (d != -1) { \
+            int d_next = link[d]; \
+            int d_ncols = L->super_start[d + 1] - L->super_start[d]; \
+            int d_nrows = L->struct_ptr[d + 1] - L->struct_ptr[d]; \
+            const int *d_rows = &L->struct_idx[L->struct_ptr[d]]; \
+            const T *D = &L->PANELS[L->panel_ptr[d] - L->resident_offset]; \
+            if (d < L->first_resident) { \
+                if (d_next != -1 && d_next < L->first_resident) { \
+                    spill_prefetch(L->spill, (L->panel_ptr[d_next + 1] - L->panel_ptr[d_next]) * sizeof(T), \
+                                   L->panel_ptr[d_next] * sizeof(T)); \
+                } \
+                double start = wall_time(); \
+                int status = spill_read(L->spill, spilled, (L->panel_ptr[d + 1] - L->panel_ptr[d]) * sizeof(T), \
+                                        L->panel_ptr[d] * sizeof(T)); \
+                L->spill->io_wait += wall_time() - start; \
+                if (status != 0) { \
+                    failed = CHOLESKY_SPILL_FAILED; \
+                    break; \
+                } \
+                D = spilled; \
+            } \
+\
+            int p1 = next_row[d]; \
+            int p2 = p1; \
+            while (p2 < d_nrows && d_rows[p2] < f + ncols) p2++; \
+            int m = d_nrows - p1; \
+            int k = p2 - p1; \
+\
+            /* work (m x k) = D[p1:, :] * D[p1:p2, :]^T, lower part only */ \
+            memset(work, 0, (size_t)m * k * sizeof(T)); \
+            for (int t = 0; t < d_ncols; t++) { \
+                const T *Dt = D + (size_t)t * d_nrows + p1; \
+                for (int jj = 0; jj < k; jj++) { \
+                    T b = Dt[jj]; \
+                    if (b == 0.0) continue; \
+                    T *w = work + (size_t)jj * m; \
+                    for (int ii = jj; ii < m; ii++) { \
+                        w[ii] += Dt[ii] * b; \
+                    } \
+                } \
+            } \
+            for (int jj = 0; jj < k; jj++) { \
+                T *Pc = P + (size_t)(d_rows[p1 + jj] - f) * nrows; \
+                const T *w = work + (size_t)jj * m; \
+                for (int ii = jj; ii < m; ii++) { \
+                    Pc[relmap[d_rows[p1 + ii]]] -= w[ii]; \
+                } \
+            } \
+\
+            if (p2 < d_nrows) { \
+                int t = L->col_super[d_rows[p2]]; \
+                next_row[d] = p2; \
+                link[d] = head[t]; \
+                head[t] = d; \
+            } \
+            d = d_next; \
+        } \
+        if (failed != -1) break; \
+\
+        /* Dense factorization of the panel */ \
+        for (int j = 0; j < ncols; j++) { \
+            T *Pj = P + (size_t)j * nrows; \
+            double a_jj = 0.0; \
+            if (pivot_diag) { \
+                a_jj = pivot_diag[perm[f + j]]; \
+            } else { \
+                for (int p = C->row_ptr[f + j]; p < C->row_ptr[f + j + 1]; p++) { \
+                    if (C->col_idx[p] == f + j) a_jj = C->values[p]; \
+                } \
+            } \
+            if (!(Pj[j] > TOL * fabs(a_jj))) { \
+                failed = perm[f + j]; \
+                break; \
+            } \
+            T djj = (T)sqrt(Pj[j]); \
+            Pj[j] = djj; \
+            L->min_pivot = fmin(L->min_pivot, (double)djj * djj); \
+            L->max_pivot = fmax(L->max_pivot, (double)djj * djj); \
+            for (int i = j + 1; i < nrows; i++) Pj[i] /= djj; \
+            for (int t = j + 1; t < ncols; t++) { \
+                T b = Pj[t]; \
+                if (b == 0.0) continue; \
+                T *Pt = P + (size_t)t * nrows; \
+                for (int i = t; i < nrows; i++) { \
+                    Pt[i] -= Pj[i] * b; \
+                } \
+            } \
+        } \
+\
+        if (nrows > ncols) { \
+            int t = L->col_super[rows[ncols]]; \
+            next_row[s] = ncols; \
+            link[s] = head[t]; \
+            head[t] = s; \
+        } \
+    } \
+\
+    return failed; \
+} \
+\
+void cholesky_forward_##SUFFIX(const CholeskyFactor *L, const T *panels, size_t offset, int s0, int s1, \
+                               double *X, int nb) { \
+    for (int s = s0; s < s1; s++) { \
+        int f = L->super_start[s]; \
+        int ncols = L->super_start[s + 1] - f; \
+        int nrows = L->struct_ptr[s + 1] - L->struct_ptr[s]; \
+        const int *rows = &L->struct_idx[L->struct_ptr[s]]; \
+        const T *P = &panels[L->panel_ptr[s] - offset]; \
+        for (int j = 0; j < ncols; j++) { \
+            const T *Pj = P + (size_t)j * nrows; \
+            double *xj = X + (size_t)(f + j) * nb; \
+            double inv = 1.0 / Pj[j]; \
+            for (int r = 0; r < nb; r++) xj[r] *= inv; \
+            for (int i = j + 1; i < nrows; i++) { \
+                double lij = Pj[i]; \
+                double *xi = X + (size_t)rows[i] * nb; \
+                for (int r = 0; r < nb; r++) xi[r] -= lij * xj[r]; \
+            } \
+        } \
+    } \
+} \
+\
+void cholesky_back_##SUFFIX(const CholeskyFactor *L, const T *panels, size_t offset, int s0, int s1, \
+                            double *X, int nb) { \
+    for (int s = s1 - 1; s >= s0; s--) { \
+        int f = L->super_start[s]; \
+        int ncols = L->super_start[s + 1] - f; \
+        int nrows = L->struct_ptr[s + 1] - L->struct_ptr[s]; \
+        const int *rows = &L->struct_idx[L->struct_ptr[s]]; \
+        const T *P = &panels[L->panel_ptr[s] - offset]; \
+        for (int j = ncols - 1; j >= 0; j--) { \
+            const T *Pj = P + (size_t)j * nrows; \
+            double *xj = X + (size_t)(f + j) * nb; \
+            for (int i = j + 1; i < nrows; i++) { \
+                double lij = Pj[i]; \
+                const double *xi = X + (size_t)rows[i] * nb; \
+                for (int r = 0; r < nb; r++) xj[r] -= lij * xi[r]; \
+            } \
+            double inv = 1.0 / Pj[j]; \
+            for (int r = 0; r < nb; r++) xj[r] *= inv; \
+        } \
+    } \
+}
+
+DEFINE_CHOLESKY_KERNELS(double, double, panels)
+DEFINE_CHOLESKY_KERNELS(float, single, panels_single)
+
+// Forward (or back, when forward is 0) substitution over supernodes
+// s0..s1-1 in the precision of L, with their panels in panels from entry
+// offset of the factor on
+void cholesky_substitute_range(const CholeskyFactor *L, const void *panels, size_t offset, int s0, int s1,
+                               double *X, int nb, int forward) {
+    if (L->panels_single) {
+        if (forward) cholesky_forward_single(L, panels, offset, s0, s1, X, nb);
+        else cholesky_back_single(L, panels, offset, s0, s1, X, nb);
+    } else {
+        if (forward) cholesky_forward_double(L, panels, offset, s0, s1, X, nb);
+        else cholesky_back_double(L, panels, offset, s0, s1, X, nb);
+    }
+}
+
+// Read the spilled panels of supernodes s0..s1-1 into buffer
+void spill_read_panels(const CholeskyFactor *L, void *buffer, int s0, int s1) {
+    size_t element = L->panels_single ? sizeof(float) : sizeof(double);
+    size_t bytes = (L->panel_ptr[s1] - L->panel_ptr[s0]) * element;
+    if (spill_read(L->spill, buffer, bytes, L->panel_ptr[s0] * element) != 0) memset(buffer, 0, bytes);
+}
+
+// Substitutions with an out-of-core factor. The spilled panels stream
+// through the two buffers of chunk entries in runs of whole supernodes:
+// a second thread reads the next run while the current one is applied,
+// and only the time spent waiting for it counts as I/O wait. The forward
+// pass ends, and the back pass starts, on the panels in memory, which
+// gives the back pass's first read something to overlap with.
+void cholesky_substitute_spilled(const CholeskyFactor *L, double *X, int nb, void *buffers[2], size_t chunk) {
+    SpillFile *spill = L->spill;
+    const void *resident = L->panels_single ? (const void *)L->panels_single : (const void *)L->panels;
+    int n_spilled = L->first_resident;
+    double wait = 0.0;
+    #pragma omp parallel num_threads(2)
+    #pragma omp single
+    {
+        // Runs [s0, s1) forward from supernode 0
+        int s0 = 0, s1 = 1, current = 0;
+        while (s1 < n_spilled && L->panel_ptr[s1 + 1] - L->panel_ptr[s0] <= chunk) s1++;
+        double start = wall_time();
+        spill_read_panels(L, buffers[0], s0, s1);
+        wait += wall_time() - start;
+        while (s0 < n_spilled) {
+            int t0 = s1, t1 = s1 + 1;
+            while (t1 < n_spilled && L->panel_ptr[t1 + 1] - L->panel_ptr[t0] <= chunk) t1++;
+            if (t0 < n_spilled) {
+                void *next = buffers[1 - current];
+                #pragma omp task firstprivate(next, t0, t1)
+                spill_read_panels(L, next, t0, t1);
+            }
+            cholesky_substitute_range(L, buffers[current], L->panel_ptr[s0], s0, s1, X, nb, 1);
+            start = wall_time();
+            #pragma omp taskwait
+            wait += wall_time() - start;
+            s0 = t0;
+            s1 = t1;
+            current = 1 - current;
+        }
+        cholesky_substitute_range(L, resident, L->resident_offset, n_spilled, L->n_super, X, nb, 1);
+        
+        // Runs [s0, s1) backward from the last spilled supernode
+        s1 = n_spilled;
+        s0 = s1 - 1;
+        while (s0 > 0 && L->panel_ptr[s1] - L->panel_ptr[s0 - 1] <= chunk) s0--;
+        {
+            void *first = buffers[current];
+            int t0 = s0, t1 = s1;
+            #pragma omp task firstprivate(first, t0, t1)
+            spill_read_panels(L, first, t0, t1);
+        }
+        cholesky_substitute_range(L, resident, L->resident_offset, n_spilled, L->n_super, X, nb, 0);
+        start = wall_time();
+        #pragma omp taskwait
+        wait += wall_time() - start;
+        while (s1 > 0) {
+            int t1 = s0, t0 = s0 - 1;
+            while (t0 > 0 && L->panel_ptr[t1] - L->panel_ptr[t0 - 1] <= chunk) t0--;
+            if (t1 > 0) {
+                void *next = buffers[1 - current];
+                #pragma omp task firstprivate(next, t0, t1)
+                spill_read_panels(L, next, t0, t1);
+            }
+            cholesky_substitute_range(L, buffers[current], L->panel_ptr[s0], s0, s1, X, nb, 0);
+            start = wall_time();
+            #pragma omp taskwait
+            wait += wall_time() - start;
+            s0 = t0;
+            s1 = t1;
+            current = 1 - current;
+        }
+    }
+    spill->io_wait += wait;
+}
+
+// Solve L L^T X = B in place for nrhs columns of B (column-major, in the
+// unpermuted order). Right-hand sides are processed SOLVE_BLOCK_RHS at a
+// time in a row-major block so every panel entry updates all of them in
+// one contiguous inner loop; an out-of-core factor takes SPILL_SOLVE_RHS
+// at a time, as each block reads its spilled panels again, through
+// buffers of a quarter of the memory budget each. Returns 0, or -1 when
+// out of memory.
+int cholesky_solve(const CholeskyFactor *L, double *B, int nrhs, Arena *scratch) {
+    int n = L->n;
+    ArenaMark mark = arena_mark(scratch);
+    int spilled = L->first_resident > 0;
+    int block = spilled ? SPILL_SOLVE_RHS : SOLVE_BLOCK_RHS;
+    double *X = arena_alloc(scratch, (size_t)n * block * sizeof(double));
+    void *buffers[2] = {NULL, NULL};
+    size_t chunk = 0;
+    if (spilled) {
+        size_t element = L->panels_single ? sizeof(float) : sizeof(double);
+        chunk = (size_t)L->spill->budget / 4 / element;
+        if (chunk < L->max_panel) chunk = L->max_panel;
+        buffers[0] = arena_alloc(scratch, chunk * element);
+        buffers[1] = arena_alloc(scratch, chunk * element);
+    }
+    if (!X || (spilled && (!buffers[0] || !buffers[1]))) {
+        arena_release(scratch, mark);
+        return -1;
+    }
+    
+    for (int c0 = 0; c0 < nrhs; c0 += block) {
+        int nb = nrhs - c0 < block ? nrhs - c0 : block;
+        for (int k = 0; k < n; k++) {
+            for (int r = 0; r < nb; r++) {
+                X[(size_t)k * nb + r] = B[(size_t)(c0 + r) * n + L->perm[k]];
+            }
+        }
+        
+        if (spilled) {
+            cholesky_substitute_spilled(L, X, nb, buffers, chunk);
+        } else if (L->panels_single) {
+            cholesky_forward_single(L, L->panels_single, 0, 0, L->n_super, X, nb);
+            cholesky_back_single(L, L->panels_single, 0, 0, L->n_super, X, nb);
+        } else {
+            cholesky_forward_double(L, L->panels, 0, 0, L->n_super, X, nb);
+            cholesky_back_double(L, L->panels, 0, 0, L->n_super, X, nb);
+        }
+        
+        for (int k = 0; k < n; k++) {
+            for (int r = 0; r < nb; r++) {
+                B[(size_t)(c0 + r) * n + L->perm[k]] = X[(size_t)k * nb + r];
+            }
+        }
+    }
+    arena_release(scratch, mark);
+    return 0;
+}
+
+// Create the spill file in spill->dir, or in the temporary directory
+// when that is empty, in place of any file spill had open. Returns 0, or
+// -1 with spill->error set.
+int spill_open(SpillFile *spill) {
+    spill_close(spill);
+#ifdef _WIN32
+    char dir[MAX_PATH], path[MAX_PATH];
+    if (spill->dir && spill->dir[0]) {
+        snprintf(dir, sizeof(dir), "%s", spill->dir);
+    } else if (!GetTempPathA(sizeof(dir), dir)) {
+        dir[0] = '\0';
+    }
+    spill->handle = INVALID_HANDLE_VALUE;
+    if (dir[0] && GetTempFileNameA(dir, "trs", 0, path)) {
+        spill->handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+        if (spill->handle == INVALID_HANDLE_VALUE) DeleteFileA(path);
+    }
+    if (spill->handle == INVALID_HANDLE_VALUE) {
+        spill->error = EIO;
+        spill->failed = "create";
+        return -1;
+    }
+#else
+    const char *dir = spill->dir && spill->dir[0] ? spill->dir : getenv("TMPDIR");
+    if (!dir || !dir[0]) dir = "/tmp";
+    char path[512];
+    snprintf(path, sizeof(path), "%s/truss-spill-XXXXXX", dir);
+    spill->fd = mkstemp(path);
+    if (spill->fd < 0) {
+        spill->error = errno;
+        spill->failed = "create";
+        return -1;
+    }
+    unlink(path);
+#endif
+    spill->open = 1;
+    return 0;
+}
+
+void spill_close(SpillFile *spill) {
+    if (!spill->open) return;
+#ifdef _WIN32
+    CloseHandle(spill->handle);
+#else
+    close(spill->fd);
+#endif
+    spill->open = 0;
+}
+
+// Write or read bytes at offset of the spill file, in pieces of at most
+// SPILL_IO_BYTES. Returns 0, or -1 with spill->error set.
+int spill_transfer(SpillFile *spill, void *data, size_t bytes, size_t offset, int writing) {
+    char *p = data;
+    while (bytes > 0) {
+        size_t count = bytes < SPILL_IO_BYTES ? bytes : SPILL_IO_BYTES;
+#ifdef _WIN32
+        OVERLAPPED at = {0};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+        DWORD done = 0;
+        BOOL ok = writing ? WriteFile(spill->handle, p, (DWORD)count, &done, &at)
+                        : ReadFile(spill->handle, p, (DWORD)count, &done, &at);
+        long long moved = ok ? (long long)done : -1;
+        int err = EIO;
+#else
+        ssize_t moved = writing ? pwrite(spill->fd, p, count, (off_t)offset) : pread(spill->fd, p, count, (off_t)offset);
+        int err = moved < 0 ? errno : EIO;
+        if (moved < 0 && err == EINTR) continue;
+#endif
+        if (moved <= 0) {
+            spill->error = err;
+            spill->failed = writing ? "write" : "read";
+            return -1;
+        }
+        if (writing) spill->bytes_written += moved;
+        else spill->bytes_read += moved;
+        p += moved;
+        offset += moved;
+        bytes -= moved;
+    }
+    return 0;
+}
+
+// Writes block, so their time counts as I/O wait
+int spill_write(SpillFile *spill, const void *data, size_t bytes, size_t offset) {
+    double start = wall_time();
+    int status = spill_transfer(spill, (void *)data, bytes, offset, 1);
+    spill->io_wait += wall_time() - start;
+    return status;
+}
+
+// Reads are timed by the caller, which may overlap them with work
+int spill_read(SpillFile *spill, void *data, size_t bytes, size_t offset) {
+    return spill_transfer(spill, data, bytes, offset, 0);
+}
+
+// Ask the system to start reading a range of the spill file ahead of use
+void spill_prefetch(SpillFile *spill, size_t bytes, size_t offset) {
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+    posix_fadvise(spill->fd, (off_t)offset, (off_t)bytes, POSIX_FADV_WILLNEED);
+#else
+    (void)spill;
+    (void)bytes;
+    (void)offset;
+#endif
+}
+
+// Copy the spill file's I/O into the solver statistics; a read or write
+// of it that failed fails the analysis
+int spill_status(TrussContext *ctx) {
+    SolverCache *cache = &ctx->solver;
+    SpillFile *spill = &cache->spill;
+    cache->stats.spilled_bytes = spill->bytes_written;
+    cache->stats.spill_read_bytes = spill->bytes_read;
+    cache->stats.io_wait = spill->io_wait;
+    if (spill->error) {
+        return set_error(ctx, TRUSS_ERROR_IO, "Cannot %s the scratch file of the out-of-core factor in %s: %s",
+                         spill->failed, spill->dir && spill->dir[0] ? spill->dir : "the temporary directory",
+                         strerror(spill->error));
+    }
+    return TRUSS_OK;
+}
+
+// Solve K D = F for every load case. The reduced stiffness is factored
+// once and kept in ctx->solver, so later solves of the same model only
+// repeat the substitutions; members whose stiffness has changed since are
+// folded in as a low-rank correction until there are too many of them.
+int apply_boundary_conditions(TrussContext *ctx) {
+    SolverCache *cache = &ctx->solver;
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *changed = NULL;
+    int n_changed = 0;
+    if (cache->valid && cache->condensed != substructures_condensed(ctx)) solver_cache_free(cache);
+    if (cache->valid) {
+        changed = arena_alloc(&ctx->scratch, ctx->n_members * sizeof(int));
+        if (!changed) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory updating the stiffness");
+        
+        // Members of condensed instances are inside their super-elements,
+        // so changing one means condensing again
+        int recondense = 0;
+        for (int m = 0; m < ctx->n_members; m++) {
+            if (ctx->member_geometry->stiffness[m] != cache->factored_stiffness[m]) {
+                changed[n_changed++] = m;
+                if (cache->condensed && m >= ctx->instances[0].first_member) recondense = 1;
+            }
+        }
+        if (n_changed > LOW_RANK_MAX_MEMBERS || (n_changed > 0 && cache->solver == SOLVER_PCG) || recondense) {
+            solver_cache_free(cache);
+        } else {
+            log_message(ctx, "Reusing stiffness factorization (%d member update%s)\n",
+                        n_changed, n_changed == 1 ? "" : "s");
+            cache->stats.reused = 1;
+            ctx->substructures.computed = 0;
+        }
+    }
+    if (!cache->valid) {
+        n_changed = 0;
+        int status = factor_stiffness(ctx);
+        if (status != TRUSS_OK) {
+            arena_release(&ctx->scratch, mark);
+            return status;
+        }
+    }
+    int n_free = cache->n_free;
+    const int *dof_map = cache->dof_map;
+    cache->stats.iterations = 0;
+    cache->stats.refinements = 0;
+    cache->stats.residual = -1.0;
+    cache->stats.backward_error = -1.0;
+    
+    // One column of F_reduced per load case
+    int nrhs = ctx->n_load_cases;
+    double *F_reduced = arena_calloc(&ctx->scratch, (size_t)n_free * nrhs, sizeof(double));
+    double *D_reduced = arena_calloc(&ctx->scratch, (size_t)n_free * nrhs, sizeof(double));
+    ctx->displacements = arena_calloc(&ctx->solve_arena, (size_t)ctx->total_dofs * nrhs, sizeof(double));
+    if (!F_reduced || !D_reduced || !ctx->displacements) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+    }
+    for (int c = 0; c < nrhs; c++) {
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0) {
+                F_reduced[(size_t)c * n_free + dof_map[i]] = ctx->F_global[(size_t)c * ctx->total_dofs + i];
+            }
+        }
+    }
+    if (cache->condensed) condense_loads(ctx, F_reduced, nrhs);
+    
+    int status;
+    if (n_changed > 0) {
+        status = solve_low_rank(ctx, changed, n_changed, F_reduced, D_reduced, nrhs);
+        if (status > 0) {
+            // Too close to singular for the update: factor afresh, which
+            // also reports a structure that has become unstable
+            solver_cache_free(cache);
+            status = factor_stiffness(ctx);
+            if (status == TRUSS_OK) status = solve_factored(ctx, F_reduced, D_reduced, nrhs);
+        }
+    } else {
+        status = solve_factored(ctx, F_reduced, D_reduced, nrhs);
+    }
+    
+    // Expand to full displacement vectors
+    for (int c = 0; c < nrhs && status == TRUSS_OK; c++) {
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0) {
+                ctx->displacements[(size_t)c * ctx->total_dofs + i] = D_reduced[(size_t)c * n_free + dof_map[i]];
+            }
+        }
+    }
+    if (status == TRUSS_OK && cache->condensed) status = recover_interiors(ctx);
+    
+    arena_release(&ctx->scratch, mark);
+    return status;
+}
+
+// Factor the reduced stiffness into ctx->solver: small models by dense
+// Cholesky, everything else by sparse Cholesky on a nested dissection
+// ordering unless an engine was selected explicitly. For PCG the reduced
+// matrix and its preconditioner are kept instead. Member updates made
+// in place since the last assembly are reassembled from scratch first.
+int factor_stiffness(TrussContext *ctx) {
+    ProfileClock start = profile_clock(ctx);
+    SolverCache *cache = &ctx->solver;
+    if (ctx->stiffness_updated) reassemble_stiffness(ctx);
+    cache->dof_map = arena_alloc(&cache->arena, ctx->total_dofs * sizeof(int));
+    cache->fixed_dofs = arena_alloc(&cache->arena, ctx->total_dofs * sizeof(int));
+    cache->factored_stiffness = arena_alloc(&cache->arena, ctx->n_members * sizeof(double));
+    if (!cache->dof_map || !cache->fixed_dofs || !cache->factored_stiffness) {
+        solver_cache_free(cache);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+    }
+    
+    // Mapping from full DOF to reduced DOF. The free DOFs of substructure
+    // interiors are condensed out, leaving the instances' boundaries.
+    int n_free = 0;
+    int n_fixed = 0;
+    cache->condensed = substructures_condensed(ctx);
+    int first_interior = cache->condensed ? ctx->instances[0].first_node : ctx->n_nodes;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        for (int j = 0; j < 3; j++) {
+            if (ctx->nodes[i].constraints[j]) {
+                cache->dof_map[3*i + j] = -1;
+                cache->fixed_dofs[n_fixed++] = 3*i + j;
+            } else if (i >= first_interior) {
+                cache->dof_map[3*i + j] = CONDENSED_DOF;
+            } else {
+                cache->dof_map[3*i + j] = n_free++;
+            }
+        }
+    }
+    cache->n_free = n_free;
+    cache->n_fixed = n_fixed;
+    if (cache->condensed) {
+        int status = condense_substructures(ctx);
+        if (status != TRUSS_OK) {
+            solver_cache_free(cache);
+            return status;
+        }
+        const SubstructureCache *sub = &ctx->substructures;
+        log_warning(ctx, "Substructures: %d instance%s condensed by %d super-element%s (%d interior DOFs), %s\n",
+                    ctx->n_instances, ctx->n_instances == 1 ? "" : "s", sub->n_condensations,
+                    sub->n_condensations == 1 ? "" : "s",
+                    sub->condensed_dofs, sub->computed ? "computed" : "reused");
+    }
+    for (int m = 0; m < ctx->n_members; m++) {
+        cache->factored_stiffness[m] = ctx->member_geometry->stiffness[m];
+    }
+    
+    // Renumber the free DOFs node by node in reverse Cuthill-McKee order,
+    // which bands the reduced stiffness whatever the input's node order.
+    // An input numbering that is already tighter than RCM's is kept.
+    long long bandwidth, envelope;
+    reduced_envelope(ctx, cache->dof_map, &bandwidth, &envelope);
+    if (ctx->reorder && n_free > 0) {
+        long long file_bandwidth = bandwidth, file_envelope = envelope;
+        ArenaMark order_mark = arena_mark(&ctx->scratch);
+        int *order = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+        int *file_map = arena_alloc(&ctx->scratch, ctx->total_dofs * sizeof(int));
+        if (!order || !file_map) {
+            arena_release(&ctx->scratch, order_mark);
+            solver_cache_free(cache);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+        }
+        memcpy(file_map, cache->dof_map, ctx->total_dofs * sizeof(int));
+        int n_ordered = rcm_order(ctx, cache->dof_map, order);
+        if (n_ordered < 0) {
+            arena_release(&ctx->scratch, order_mark);
+            solver_cache_free(cache);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+        }
+        int next = 0;
+        for (int p = 0; p < n_ordered; p++) {
+            for (int a = 0; a < 3; a++) {
+                if (cache->dof_map[3*order[p] + a] >= 0) cache->dof_map[3*order[p] + a] = next++;
+            }
+        }
+        long long rcm_bandwidth, rcm_envelope;
+        reduced_envelope(ctx, cache->dof_map, &rcm_bandwidth, &rcm_envelope);
+        if (rcm_envelope < file_envelope) {
+            bandwidth = rcm_bandwidth;
+            envelope = rcm_envelope;
+            log_warning(ctx, "Renumbered nodes (reverse Cuthill-McKee): bandwidth %lld -> %lld, profile %lld -> %lld\n",
+                        file_bandwidth, bandwidth, file_envelope, envelope);
+        } else {
+            memcpy(cache->dof_map, file_map, ctx->total_dofs * sizeof(int));
+            log_warning(ctx, "Kept input node order, reverse Cuthill-McKee does not shrink it: bandwidth %lld -> %lld, "
+                        "profile %lld -> %lld\n", file_bandwidth, rcm_bandwidth, file_envelope, rcm_envelope);
+        }
+        arena_release(&ctx->scratch, order_mark);
+    }
+    
+    cache->stats.bandwidth = bandwidth;
+    cache->stats.envelope = envelope;
+    
+    SolverType solver = ctx->solver_type;
+    if (solver == SOLVER_AUTO) {
+        solver = n_free <= DENSE_SOLVER_MAX_DOFS ? SOLVER_DENSE : SOLVER_SPARSE;
+    }
+    cache->solver = solver;
+    if (solver == SOLVER_SPARSE) {
+        cache->sparse_perm = arena_alloc(&cache->arena, (n_free > 0 ? n_free : 1) * sizeof(int));
+        if (!cache->sparse_perm || sparse_order(ctx, cache->dof_map, cache->sparse_perm) != 0) {
+            solver_cache_free(cache);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+        }
+    }
+    profile_phase(ctx, TRUSS_PHASE_REDUCE, start, profile_clock(ctx));
+    
+    cache->numbered = arena_mark(&cache->arena);
+    return refactor_stiffness(ctx, &ctx->K_global);
+}
+
+// Factor K, the global stiffness or a tangent stiffness with its
+// pattern, with the DOF numbering and ordering already in ctx->solver.
+// A factorization made earlier from the same numbering is dropped.
+int refactor_stiffness(TrussContext *ctx, const SparseMatrix *K) {
+    ProfileClock start = profile_clock(ctx);
+    SolverCache *cache = &ctx->solver;
+    arena_release(&cache->arena, cache->numbered);
+    cache->valid = 0;
+    
+    // Reduced stiffness straight from the sparse global matrix; PCG and
+    // mixed precision keep it, the direct solvers only need it while
+    // factoring
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int keep = cache->solver == SOLVER_PCG || (cache->solver == SOLVER_SPARSE && ctx->mixed_precision);
+    if (sparse_extract_free(K, ctx->node_dofs, cache->dof_map, cache->n_free, &cache->K_free,
+                            keep ? &cache->arena : &ctx->scratch) != 0) {
+        memset(&cache->K_free, 0, sizeof(SparseMatrix));
+        arena_release(&ctx->scratch, mark);
+        solver_cache_free(cache);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+    }
+    
+    // The super-elements cancel the boundary diagonal of a mechanism down
+    // to round-off, so pivots are tested against the diagonal from before
+    cache->pivot_diag = NULL;
+    if (cache->condensed) {
+        cache->pivot_diag = arena_alloc(&cache->arena, (cache->n_free > 0 ? cache->n_free : 1) * sizeof(double));
+        if (!cache->pivot_diag) {
+            arena_release(&ctx->scratch, mark);
+            solver_cache_free(cache);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+        }
+        sparse_diagonal(&cache->K_free, cache->pivot_diag);
+        add_super_elements(ctx, &cache->K_free);
+    }
+    cache->condition = 0.0;
+    SpillFile *spill = &cache->spill;
+    spill->budget = ctx->memory_budget;
+    spill->dir = ctx->scratch_dir;
+    spill->bytes_written = spill->bytes_read = 0;
+    spill->io_wait = 0.0;
+    spill->error = 0;
+    int status;
+    if (cache->solver == SOLVER_DENSE) {
+        status = factor_dense(ctx, &cache->K_free, cache->dof_map, &cache->dense);
+    } else if (cache->solver == SOLVER_SPARSE) {
+        status = ctx->mixed_precision ? factor_mixed(ctx)
+                                      : factor_sparse(ctx, &cache->K_free, cache->dof_map, 0, &cache->sparse);
+    } else {
+        status = pcg_setup(ctx, &cache->K_free, cache->dof_map, &cache->pcg);
+    }
+    if (status == TRUSS_OK) record_factor_stats(ctx, &cache->K_free);
+    if (!keep) memset(&cache->K_free, 0, sizeof(SparseMatrix));
+    arena_release(&ctx->scratch, mark);
+    profile_phase(ctx, TRUSS_PHASE_REDUCE, start, profile_clock(ctx));
+    if (status != TRUSS_OK) {
+        solver_cache_free(cache);
+        return status;
+    }
+    cache->valid = 1;
+    return TRUSS_OK;
+}
+
+// Describe a new factorization of K_free in the solver statistics,
+// keeping the bandwidth and envelope of the DOF numbering
+void record_factor_stats(TrussContext *ctx, const SparseMatrix *K_free) {
+    SolverCache *cache = &ctx->solver;
+    TrussSolverStats *stats = &cache->stats;
+    static const char *names[] = {"auto", "dense", "sparse", "pcg"};
+    long long bandwidth = stats->bandwidth, envelope = stats->envelope;
+    memset(stats, 0, sizeof(TrussSolverStats));
+    stats->bandwidth = bandwidth;
+    stats->envelope = envelope;
+    snprintf(stats->solver, sizeof(stats->solver), "%s", names[cache->solver]);
+    stats->n_free = cache->n_free;
+    stats->matrix_nnz = K_free->nnz;
+    stats->factor_bytes = (long long)cache->arena.in_use;
+    stats->residual = -1.0;
+    stats->backward_error = -1.0;
+    stats->condition = cache->condition;
+    
+    // Pivots are the squared diagonal of the factor
+    long long n = cache->n_free;
+    double min_pivot = INFINITY, max_pivot = 0.0;
+    if (cache->solver == SOLVER_DENSE) {
+        stats->factor_nnz = n * (n + 1) / 2;
+        for (int i = 0; i < n; i++) {
+            double d = cache->dense.a[(size_t)i * cache->dense.ld + i];
+            min_pivot = fmin(min_pivot, d * d);
+            max_pivot = fmax(max_pivot, d * d);
+        }
+    } else if (cache->solver == SOLVER_SPARSE) {
+        const CholeskyFactor *L = &cache->sparse;
+        stats->supernodes = L->n_super;
+        stats->single_precision = L->panels_single != NULL;
+        for (int s = 0; s < L->n_super; s++) {
+            long long ncols = L->super_start[s + 1] - L->super_start[s];
+            long long nrows = L->struct_ptr[s + 1] - L->struct_ptr[s];
+            stats->factor_nnz += ncols * nrows - ncols * (ncols - 1) / 2;
+        }
+        min_pivot = L->min_pivot;
+        max_pivot = L->max_pivot;
+        spill_status(ctx);
+    }
+    if (stats->factor_nnz > 0) {
+        stats->fill_in = stats->factor_nnz - (K_free->nnz + n) / 2;
+        stats->min_pivot = min_pivot;
+        stats->max_pivot = max_pivot;
+    }
+}
+
+// Largest relative residual |F - K D| / |F| over the free DOFs of every
+// load case, checked against the assembled stiffness so that it also
+// covers low-rank updates and condensed substructure interiors
+void record_residual(TrussContext *ctx) {
+    const SparseMatrix *K = &ctx->K_global;
+    const int *dof_map = ctx->solver.dof_map;
+    double worst = 0.0;
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const double *F = ctx->F_global + (size_t)c * ctx->total_dofs;
+        const double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+        double norm_r = 0.0, norm_f = 0.0;
+        #pragma omp parallel for schedule(static) reduction(+:norm_r, norm_f)
+        for (int row = 0; row < K->n; row++) {
+            int i = full_dof(row, ctx->node_dofs);
+            if (dof_map[i] == -1) continue;
+            double r = F[i];
+            for (int p = K->row_ptr[row]; p < K->row_ptr[row + 1]; p++) {
+                r -= K->values[p] * D[full_dof(K->col_idx[p], ctx->node_dofs)];
+            }
+            norm_r += r * r;
+            norm_f += F[i] * F[i];
+        }
+        if (norm_f > 0.0) worst = fmax(worst, sqrt(norm_r / norm_f));
+    }
+    ctx->solver.stats.residual = worst;
+}
+
+// Solve the factored reduced system for nrhs right-hand sides
+int solve_factored(TrussContext *ctx, const double *F_reduced, double *D_reduced, int nrhs) {
+    SolverCache *cache = &ctx->solver;
+    if (cache->solver == SOLVER_PCG) {
+        return solve_pcg(ctx, &cache->K_free, &cache->pcg, F_reduced, D_reduced, nrhs);
+    }
+    if (cache->sparse.panels_single) return solve_refined(ctx, F_reduced, D_reduced, nrhs);
+    if (D_reduced != F_reduced) memcpy(D_reduced, F_reduced, (size_t)cache->n_free * nrhs * sizeof(double));
+    int failed = cache->solver == SOLVER_DENSE ? dense_cholesky_solve(&cache->dense, D_reduced, nrhs, &ctx->scratch)
+                                               : cholesky_solve(&cache->sparse, D_reduced, nrhs, &ctx->scratch);
+    if (failed) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+    return cache->solver == SOLVER_DENSE ? TRUSS_OK : spill_status(ctx);
+}
+
+// Solve with the stiffness of the n_changed members in changed[] altered
+// since the factorization. Each member adds dk b b^T to the reduced
+// stiffness K, where dk is its change in axial stiffness and b holds -cos
+// at its first node's free DOFs and +cos at its second node's. With U the
+// matrix of those b and C = diag(dk), the Sherman-Morrison-Woodbury
+// identity gives
+//   (K + U C U^T)^-1 F = X - Z S^-1 U^T X,  X = K^-1 F,  Z = K^-1 U,
+//   S = C^-1 + U^T Z,
+// so the cost is n_changed + nrhs substitutions and a small dense solve.
+// Returns 1 if S is too close to singular, so the caller refactors.
+int solve_low_rank(TrussContext *ctx, const int *changed, int n_changed,
+                   const double *F_reduced, double *D_reduced, int nrhs) {
+    SolverCache *cache = &ctx->solver;
+    int n_free = cache->n_free;
+    int r = n_changed;
+    int status = solve_factored(ctx, F_reduced, D_reduced, nrhs);
+    if (status != TRUSS_OK) return status;
+    
+    // Nonzeros of each b, at most 6
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int (*b_dof)[6] = arena_alloc(&ctx->scratch, r * sizeof(int[6]));
+    double (*b_val)[6] = arena_alloc(&ctx->scratch, r * sizeof(double[6]));
+    int *b_count = arena_calloc(&ctx->scratch, r, sizeof(int));
+    double *Z = arena_calloc(&ctx->scratch, (size_t)n_free * r, sizeof(double));
+    double *S = arena_alloc(&ctx->scratch, (size_t)r * r * sizeof(double));
+    double *Y = arena_alloc(&ctx->scratch, (size_t)r * nrhs * sizeof(double));
+    int *pivot = arena_alloc(&ctx->scratch, r * sizeof(int));
+    if (!b_dof || !b_val || !b_count || !Z || !S || !Y || !pivot) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory updating the stiffness");
+    }
+    
+    for (int t = 0; t < r; t++) {
+        int m = changed[t];
+        int ends[2] = {ctx->members[m].node1, ctx->members[m].node2};
+        for (int e = 0; e < 2; e++) {
+            for (int a = 0; a < 3; a++) {
+                int dof = cache->dof_map[3*ends[e] + a];
+                if (dof < 0) continue;
+                double value = e == 0 ? -ctx->member_geometry->cos[a][m] : ctx->member_geometry->cos[a][m];
+                b_dof[t][b_count[t]] = dof;
+                b_val[t][b_count[t]++] = value;
+                Z[(size_t)t * n_free + dof] = value;
+            }
+        }
+    }
+    status = solve_factored(ctx, Z, Z, r);
+    if (status != TRUSS_OK) {
+        arena_release(&ctx->scratch, mark);
+        return status;
+    }
+    
+    // S = C^-1 + U^T Z and Y = U^T X. The diagonal of S cancels when a
+    // change makes the structure unstable, so pivots are judged against
+    // the size of the terms rather than of S itself.
+    double scale = 0.0;
+    for (int s = 0; s < r; s++) {
+        for (int t = 0; t < r; t++) {
+            double sum = 0.0;
+            for (int k = 0; k < b_count[s]; k++) sum += b_val[s][k] * Z[(size_t)t * n_free + b_dof[s][k]];
+            S[(size_t)s * r + t] = sum;
+            scale = fmax(scale, fabs(sum));
+        }
+        int m = changed[s];
+        double inverse_change = 1.0 / (ctx->member_geometry->stiffness[m] - cache->factored_stiffness[m]);
+        S[(size_t)s * r + s] += inverse_change;
+        scale = fmax(scale, fabs(inverse_change));
+        for (int c = 0; c < nrhs; c++) {
+            double sum = 0.0;
+            for (int k = 0; k < b_count[s]; k++) sum += b_val[s][k] * D_reduced[(size_t)c * n_free + b_dof[s][k]];
+            Y[(size_t)c * r + s] = sum;
+        }
+    }
+    
+    // S is symmetric but indefinite when stiffness drops: LU with
+    // partial pivoting, then Y = S^-1 Y
+    int singular = 0;
+    for (int k = 0; k < r && !singular; k++) {
+        int best = k;
+        for (int i = k + 1; i < r; i++) {
+            if (fabs(S[(size_t)i * r + k]) > fabs(S[(size_t)best * r + k])) best = i;
+        }
+        pivot[k] = best;
+        if (!(fabs(S[(size_t)best * r + k]) > LOW_RANK_PIVOT_TOL * scale)) {
+            singular = 1;
+            break;
+        }
+        if (best != k) {
+            for (int j = 0; j < r; j++) {
+                double tmp = S[(size_t)k * r + j];
+                S[(size_t)k * r + j] = S[(size_t)best * r + j];
+                S[(size_t)best * r + j] = tmp;
+            }
+        }
+        for (int i = k + 1; i < r; i++) {
+            double factor = S[(size_t)i * r + k] /= S[(size_t)k * r + k];
+            for (int j = k + 1; j < r; j++) S[(size_t)i * r + j] -= factor * S[(size_t)k * r + j];
+        }
+    }
+    if (!singular) {
+        for (int c = 0; c < nrhs; c++) {
+            double *y = Y + (size_t)c * r;
+            for (int k = 0; k < r; k++) {
+                double tmp = y[k];
+                y[k] = y[pivot[k]];
+                y[pivot[k]] = tmp;
+            }
+            for (int i = 1; i < r; i++) {
+                for (int j = 0; j < i; j++) y[i] -= S[(size_t)i * r + j] * y[j];
+            }
+            for (int i = r - 1; i >= 0; i--) {
+                for (int j = i + 1; j < r; j++) y[i] -= S[(size_t)i * r + j] * y[j];
+                y[i] /= S[(size_t)i * r + i];
+            }
+            
+            // D = X - Z y
+            double *D = D_reduced + (size_t)c * n_free;
+            for (int t = 0; t < r; t++) {
+                const double *z = Z + (size_t)t * n_free;
+                double yt = y[t];
+                #pragma omp simd
+                for (int i = 0; i < n_free; i++) D[i] -= z[i] * yt;
+            }
+        }
+    }
+    
+    arena_release(&ctx->scratch, mark);
+    return singular;
+}
+
+// Drop the factorization, keeping the arena's memory for the next one
+void solver_cache_free(SolverCache *cache) {
+    spill_close(&cache->spill);
+    Arena arena = cache->arena;
+    arena_reset(&arena);
+    memset(cache, 0, sizeof(SolverCache));
+    cache->arena = arena;
+}
+
+void *aligned_malloc(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size > 0 ? size : 64, 64);
+#else
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, 64, size > 0 ? size : 64) != 0) return NULL;
+    return ptr;
+#endif
+}
+
+void aligned_free(void *ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// size bytes, 64-byte aligned and uninitialized, or NULL when out of
+// memory. A new block is sized for the request, or for the arena's peak
+// when it has none, so a reset arena serves a repeat run from one block.
+void *arena_alloc(Arena *arena, size_t size) {
+    if (size > SIZE_MAX - ARENA_HEADER - ARENA_BLOCK_BYTES) return NULL;
+    size = (size + 63) & ~(size_t)63;
+    ArenaBlock *block = arena->block;
+    if (!block || block->size - block->used < size) {
+        size_t capacity = size > ARENA_BLOCK_BYTES ? size : ARENA_BLOCK_BYTES;
+        if (!block && arena->peak > capacity) capacity = arena->peak;
+        block = aligned_malloc(ARENA_HEADER + capacity);
+        if (!block) return NULL;
+        block->prev = arena->block;
+        block->size = capacity;
+        block->used = 0;
+        arena->block = block;
+    }
+    void *ptr = (char *)block + ARENA_HEADER + block->used;
+    block->used += size;
+    arena->in_use += size;
+    arena->allocated += size;
+    if (arena->in_use > arena->peak) arena->peak = arena->in_use;
+    return ptr;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    if (size > 0 && count > SIZE_MAX / size) return NULL;
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark = {arena->block, arena->block ? arena->block->used : 0, arena->in_use};
+    return mark;
+}
+
+// Free everything allocated since mark. Releasing to an empty arena is a
+// reset, so scratch space settles into a single block.
+void arena_release(Arena *arena, ArenaMark mark) {
+    if (mark.in_use == 0) {
+        arena_reset(arena);
+        return;
+    }
+    while (arena->block != mark.block) {
+        ArenaBlock *prev = arena->block->prev;
+        aligned_free(arena->block);
+        arena->block = prev;
+    }
+    arena->block->used = mark.used;
+    arena->in_use = mark.in_use;
+}
+
+// Free every allocation. A single block is kept as it is; a chain is
+// freed so that the next allocation takes one block of the peak size.
+void arena_reset(Arena *arena) {
+    if (arena->block && arena->block->prev) {
+        size_t peak = arena->peak;
+        size_t allocated = arena->allocated;
+        arena_free(arena);
+        arena->peak = peak;
+        arena->allocated = allocated;
+    }
+    if (arena->block) arena->block->used = 0;
+    arena->in_use = 0;
+}
+
+void arena_free(Arena *arena) {
+    while (arena->block) {
+        ArenaBlock *prev = arena->block->prev;
+        aligned_free(arena->block);
+        arena->block = prev;
+    }
+    memset(arena, 0, sizeof(Arena));
+}
+
+// Unblocked Cholesky of the diagonal tile at rows/columns k0..k0+kb-1.
+// Returns -1, or the row whose pivot is not positive relative to the
+// original diagonal diag.
+int dense_potrf_tile(DenseMatrix *A, int k0, int kb, const double *diag) {
+    int ld = A->ld;
+    double *T = A->a + (size_t)k0 * ld + k0;
+    for (int j = 0; j < kb; j++) {
+        double *Tj = T + (size_t)j * ld;
+        if (!(Tj[j] > TOL * fabs(diag[k0 + j]))) return k0 + j;
+        double ljj = sqrt(Tj[j]);
+        Tj[j] = ljj;
+        for (int i = j + 1; i < kb; i++) {
+            double *Ti = T + (size_t)i * ld;
+            Ti[j] /= ljj;
+            double lij = Ti[j];
+            for (int t = j + 1; t <= i; t++) {
+                Ti[t] -= lij * T[(size_t)t * ld + j];
+            }
+        }
+    }
+    return -1;
+}
+
+// Rows i0..i0+ib-1 of block column k0: solve X L_kk^T = A_ik in place
+SIMD_CLONES
+void dense_trsm_tile(DenseMatrix *A, int i0, int ib, int k0, int kb) {
+    int ld = A->ld;
+    const double *Lkk = A->a + (size_t)k0 * ld + k0;
+    for (int i = 0; i < ib; i++) {
+        double *x = A->a + (size_t)(i0 + i) * ld + k0;
+        for (int j = 0; j < kb; j++) {
+            const double *Lj = Lkk + (size_t)j * ld;
+            double sum = x[j];
+            #pragma omp simd reduction(-:sum)
+            for (int t = 0; t < j; t++) sum -= x[t] * Lj[t];
+            x[j] = sum / Lj[j];
+        }
+    }
+}
+
+// C (mi x mj) -= A (mi x mk) * B (mj x mk)^T, all sharing row stride ld.
+// B is packed transposed so the innermost loop runs along contiguous
+// rows; a 4 x 8 block of C is accumulated in registers across k.
+SIMD_CLONES
+void dense_gemm_tile(double *C, const double *A, const double *B, int ld, int mi, int mj, int mk) {
+    double bt[DENSE_TILE * DENSE_TILE] __attribute__((aligned(64)));
+    for (int j = 0; j < mj; j++) {
+        for (int k = 0; k < mk; k++) {
+            bt[k * DENSE_TILE + j] = B[(size_t)j * ld + k];
+        }
+    }
+    
+    int i = 0;
+    for (; i + 4 <= mi; i += 4) {
+        const double *a0 = A + (size_t)i * ld;
+        const double *a1 = a0 + ld;
+        const double *a2 = a1 + ld;
+        const double *a3 = a2 + ld;
+        int j = 0;
+        for (; j + 8 <= mj; j += 8) {
+            double acc[4][8] = {{0}};
+            for (int k = 0; k < mk; k++) {
+                const double *b = bt + k * DENSE_TILE + j;
+                double x0 = a0[k], x1 = a1[k], x2 = a2[k], x3 = a3[k];
+                #pragma omp simd
+                for (int jj = 0; jj < 8; jj++) {
+                    acc[0][jj] += x0 * b[jj];
+                    acc[1][jj] += x1 * b[jj];
+                    acc[2][jj] += x2 * b[jj];
+                    acc[3][jj] += x3 * b[jj];
+                }
+            }
+            for (int r = 0; r < 4; r++) {
+                double *c = C + (size_t)(i + r) * ld + j;
+                for (int jj = 0; jj < 8; jj++) c[jj] -= acc[r][jj];
+            }
+        }
+        for (; j < mj; j++) {
+            double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+            for (int k = 0; k < mk; k++) {
+                double b = bt[k * DENSE_TILE + j];
+                s0 += a0[k] * b;
+                s1 += a1[k] * b;
+                s2 += a2[k] * b;
+                s3 += a3[k] * b;
+            }
+            C[(size_t)i * ld + j] -= s0;
+            C[(size_t)(i + 1) * ld + j] -= s1;
+            C[(size_t)(i + 2) * ld + j] -= s2;
+            C[(size_t)(i + 3) * ld + j] -= s3;
+        }
+    }
+    for (; i < mi; i++) {
+        const double *a = A + (size_t)i * ld;
+        double *c = C + (size_t)i * ld;
+        for (int k = 0; k < mk; k++) {
+            double x = a[k];
+            const double *b = bt + k * DENSE_TILE;
+            #pragma omp simd
+            for (int j = 0; j < mj; j++) c[j] -= x * b[j];
+        }
+    }
+}
+
+// Tiled right-looking Cholesky, A = L L^T with L in the lower triangle.
+// Each tile operation is an OpenMP task whose dependencies follow the
+// tiles it reads and writes, so independent updates of the trailing
+// matrix run concurrently while every tile is still updated in k order.
+// L has no nonzeros left of A's envelope, so tiles left of the first
+// nonzero of every row in their tile row are skipped; with a banded
+// numbering that leaves only the tiles near the diagonal.
+// Pivots are tested against pivot_diag, or A's own diagonal when it is
+// NULL. Returns -1 on success, the row at which A is not positive
+// definite, or CHOLESKY_OUT_OF_MEMORY.
+int dense_cholesky(DenseMatrix *A, const double *pivot_diag, Arena *scratch) {
+    int n = A->n;
+    int ld = A->ld;
+    int nt = (n + DENSE_TILE - 1) / DENSE_TILE;
+    ArenaMark mark = arena_mark(scratch);
+    double *diag = arena_alloc(scratch, n * sizeof(double));
+    char *deps = arena_alloc(scratch, (size_t)nt * nt);   // only named in task dependencies
+    int *first_tile = arena_alloc(scratch, nt * sizeof(int));
+    if (!diag || !deps || !first_tile) {
+        arena_release(scratch, mark);
+        return CHOLESKY_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < n; i++) diag[i] = pivot_diag ? pivot_diag[i] : A->a[(size_t)i * ld + i];
+    for (int t = 0; t < nt; t++) first_tile[t] = t;
+    for (int i = 0; i < n; i++) {
+        const double *row = A->a + (size_t)i * ld;
+        int j = 0;
+        while (j < i && row[j] == 0.0) j++;
+        if (j / DENSE_TILE < first_tile[i / DENSE_TILE]) first_tile[i / DENSE_TILE] = j / DENSE_TILE;
+    }
+    int failed = -1;
+    
+    #pragma omp parallel
+    #pragma omp single
+    for (int k = 0; k < nt; k++) {
+        int k0 = k * DENSE_TILE;
+        int kb = n - k0 < DENSE_TILE ? n - k0 : DENSE_TILE;
+        
+        #pragma omp task depend(inout: deps[(size_t)k * nt + k]) shared(failed)
+        {
+            int status;
+            #pragma omp atomic read
+            status = failed;
+            if (status < 0) {
+                status = dense_potrf_tile(A, k0, kb, diag);
+                if (status >= 0) {
+                    #pragma omp atomic write
+                    failed = status;
+                }
+            }
+        }
+        
+        for (int i = k + 1; i < nt; i++) {
+            if (first_tile[i] > k) continue;
+            int i0 = i * DENSE_TILE;
+            int ib = n - i0 < DENSE_TILE ? n - i0 : DENSE_TILE;
+            #pragma omp task depend(in: deps[(size_t)k * nt + k]) depend(inout: deps[(size_t)i * nt + k]) shared(failed)
+            {
+                int status;
+                #pragma omp atomic read
+                status = failed;
+                if (status < 0) dense_trsm_tile(A, i0, ib, k0, kb);
+            }
+        }
+        
+        for (int i = k + 1; i < nt; i++) {
+            if (first_tile[i] > k) continue;
+            int i0 = i * DENSE_TILE;
+            int ib = n - i0 < DENSE_TILE ? n - i0 : DENSE_TILE;
+            for (int j = k + 1; j <= i; j++) {
+                if (first_tile[j] > k) continue;
+                int j0 = j * DENSE_TILE;
+                int jb = n - j0 < DENSE_TILE ? n - j0 : DENSE_TILE;
+                #pragma omp task depend(in: deps[(size_t)i * nt + k], deps[(size_t)j * nt + k]) depend(inout: deps[(size_t)i * nt + j]) shared(failed)
+                {
+                    int status;
+                    #pragma omp atomic read
+                    status = failed;
+                    if (status < 0) {
+                        dense_gemm_tile(A->a + (size_t)i0 * ld + j0, A->a + (size_t)i0 * ld + k0,
+                                        A->a + (size_t)j0 * ld + k0, ld, ib, jb, kb);
+                    }
+                }
+            }
+        }
+    }
+    
+    arena_release(scratch, mark);
+    return failed;
+}
+
+// Solve L L^T X = B in place for nrhs columns of B (column-major).
+// Returns 0, or -1 when out of memory.
+int dense_cholesky_solve(const DenseMatrix *L, double *B, int nrhs, Arena *scratch) {
+    ArenaMark mark = arena_mark(scratch);
+    double *X = arena_alloc(scratch, (size_t)L->n * SOLVE_BLOCK_RHS * sizeof(double));
+    if (!X) return -1;
+    dense_solve_columns(L, B, nrhs, X);
+    arena_release(scratch, mark);
+    return 0;
+}
+
+// dense_cholesky_solve with the work block X, n x SOLVE_BLOCK_RHS, given:
+// SOLVE_BLOCK_RHS right-hand sides at a time are copied into X row-major
+SIMD_CLONES
+void dense_solve_columns(const DenseMatrix *L, double *B, int nrhs, double *X) {
+    int n = L->n;
+    int ld = L->ld;
+    for (int c0 = 0; c0 < nrhs; c0 += SOLVE_BLOCK_RHS) {
+        int nb = nrhs - c0 < SOLVE_BLOCK_RHS ? nrhs - c0 : SOLVE_BLOCK_RHS;
+        for (int i = 0; i < n; i++) {
+            for (int r = 0; r < nb; r++) X[(size_t)i * nb + r] = B[(size_t)(c0 + r) * n + i];
+        }
+        
+        // Forward substitution, row i of L at a time
+        for (int i = 0; i < n; i++) {
+            const double *Li = L->a + (size_t)i * ld;
+            double *xi = X + (size_t)i * nb;
+            for (int j = 0; j < i; j++) {
+                double lij = Li[j];
+                const double *xj = X + (size_t)j * nb;
+                #pragma omp simd
+                for (int r = 0; r < nb; r++) xi[r] -= lij * xj[r];
+            }
+            double inv = 1.0 / Li[i];
+            for (int r = 0; r < nb; r++) xi[r] *= inv;
+        }
+        
+        // Back substitution with L^T, scattering row i of L
+        for (int i = n - 1; i >= 0; i--) {
+            const double *Li = L->a + (size_t)i * ld;
+            double *xi = X + (size_t)i * nb;
+            double inv = 1.0 / Li[i];
+            for (int r = 0; r < nb; r++) xi[r] *= inv;
+            for (int j = 0; j < i; j++) {
+                double lij = Li[j];
+                double *xj = X + (size_t)j * nb;
+                #pragma omp simd
+                for (int r = 0; r < nb; r++) xj[r] -= lij * xi[r];
+            }
+        }
+        
+        for (int i = 0; i < n; i++) {
+            for (int r = 0; r < nb; r++) B[(size_t)(c0 + r) * n + i] = X[(size_t)i * nb + r];
+        }
+    }
+}
+
+// Factor the reduced system by blocked dense Cholesky into K_reduced,
+// allocated from the solver cache's arena
+int factor_dense(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, DenseMatrix *K_reduced) {
+    int n_free = K_free->n;
+    K_reduced->n = n_free;
+    K_reduced->ld = (n_free + 7) / 8 * 8;
+    K_reduced->a = arena_alloc(&ctx->solver.arena, (size_t)n_free * K_reduced->ld * sizeof(double));
+    if (!K_reduced->a) {
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Not enough memory for a dense %d x %d system; use --solver=sparse", n_free, n_free);
+    }
+    
+    // Lower triangle only
+    for (int i = 0; i < n_free; i++) {
+        double *row = K_reduced->a + (size_t)i * K_reduced->ld;
+        memset(row, 0, (i + 1) * sizeof(double));
+        for (int p = K_free->row_ptr[i]; p < K_free->row_ptr[i + 1] && K_free->col_idx[p] <= i; p++) {
+            row[K_free->col_idx[p]] = K_free->values[p];
+        }
+    }
+    
+    int failed = dense_cholesky(K_reduced, ctx->solver.pivot_diag, &ctx->scratch);
+    if (failed == CHOLESKY_OUT_OF_MEMORY) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory factoring the stiffness");
+    if (failed >= 0) return report_unstable_dof(ctx, dof_map, failed);
+    return TRUSS_OK;
+}
+
+// Factor the reduced system by sparse Cholesky into L, allocated from
+// the solver cache's arena, out of core if it exceeds the memory budget
+int factor_sparse(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, int single, CholeskyFactor *L) {
+    int failed = cholesky_factor(K_free, ctx->solver.pivot_diag, ctx->solver.sparse_perm, single, L, &ctx->solver.spill,
+                                 &ctx->solver.arena, &ctx->scratch);
+    if (failed == CHOLESKY_SPILL_FAILED) return spill_status(ctx);
+    if (failed == CHOLESKY_OUT_OF_MEMORY) {
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Not enough memory for the sparse Cholesky factor");
+    }
+    if (failed >= 0) return report_unstable_dof(ctx, dof_map, failed);
+    log_spill(ctx, L);
+    return TRUSS_OK;
+}
+
+// Note an out-of-core factor's split between memory and its spill file
+void log_spill(TrussContext *ctx, const CholeskyFactor *L) {
+    if (!L->spill) return;
+    size_t element = L->panels_single ? sizeof(float) : sizeof(double);
+    log_warning(ctx, "Out-of-core factor: %.1f MB of panels over a %.1f MB budget, %.1f MB spilled "
+                "(%d of %d supernodes)\n", L->panel_ptr[L->n_super] * element / 1e6, L->spill->budget / 1e6,
+                L->panel_ptr[L->first_resident] * element / 1e6, L->first_resident, L->n_super);
+}
+
+// Factor cache->K_free in single precision for solves refined to double
+// precision, which halves the factor's memory and traffic. A stiffness
+// too ill-conditioned for refinement to converge, or whose single
+// precision factorization breaks down, is factored in double instead.
+int factor_mixed(TrussContext *ctx) {
+    SolverCache *cache = &ctx->solver;
+    const SparseMatrix *K = &cache->K_free;
+    cache->stiffness_norm = 0.0;
+    for (int i = 0; i < K->n; i++) {
+        double sum = 0.0;
+        for (int p = K->row_ptr[i]; p < K->row_ptr[i + 1]; p++) sum += fabs(K->values[p]);
+        cache->stiffness_norm = fmax(cache->stiffness_norm, sum);
+    }
+    
+    cache->reduced = arena_mark(&cache->arena);
+    int failed = cholesky_factor(K, cache->pivot_diag, cache->sparse_perm, 1, &cache->sparse, &cache->spill,
+                                 &cache->arena, &ctx->scratch);
+    if (failed == CHOLESKY_SPILL_FAILED) return spill_status(ctx);
+    if (failed == CHOLESKY_OUT_OF_MEMORY) {
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Not enough memory for the sparse Cholesky factor");
+    }
+    cache->condition = failed < 0 ? condition_estimate(ctx) : INFINITY;
+    if (failed < 0 && cache->condition <= MIXED_MAX_CONDITION) {
+        log_warning(ctx, "Mixed precision factorization: condition estimate %.2e\n", cache->condition);
+        log_spill(ctx, &cache->sparse);
+        return spill_status(ctx);
+    }
+    if (failed >= 0) {
+        log_warning(ctx, "Mixed precision factorization broke down; factoring in double precision\n");
+    } else {
+        log_warning(ctx, "Mixed precision: condition estimate %.2e is too high for refinement; "
+                    "factoring in double precision\n", cache->condition);
+    }
+    arena_release(&cache->arena, cache->reduced);
+    return factor_sparse(ctx, K, cache->dof_map, 0, &cache->sparse);
+}
+
+// Estimate of the 1-norm condition number |K| |K^-1| of the reduced
+// stiffness from its factor, by Hager's method as refined by Higham: a
+// few solves look for the unit vector that K^-1 magnifies most. K is
+// symmetric, so its 1-norm is stiffness_norm and K^-T = K^-1. Without
+// the memory for the solves the estimate is infinite, which keeps the
+// factor in double precision.
+double condition_estimate(TrussContext *ctx) {
+    const SolverCache *cache = &ctx->solver;
+    int n = cache->n_free;
+    if (n == 0) return 0.0;
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    double *x = arena_alloc(&ctx->scratch, n * sizeof(double));
+    double *y = arena_alloc(&ctx->scratch, n * sizeof(double));
+    if (!x || !y) {
+        arena_release(&ctx->scratch, mark);
+        return INFINITY;
+    }
+    for (int i = 0; i < n; i++) x[i] = 1.0 / n;
+    
+    double estimate = 0.0;
+    for (int iteration = 0; iteration < 5; iteration++) {
+        memcpy(y, x, n * sizeof(double));
+        if (cholesky_solve(&cache->sparse, y, 1, &ctx->scratch) != 0) {
+            estimate = INFINITY;
+            break;
+        }
+        double norm = 0.0;
+        for (int i = 0; i < n; i++) norm += fabs(y[i]);
+        if (iteration > 0 && norm <= estimate) break;
+        estimate = norm;
+        
+        // Gradient of |K^-1 x|_1 is K^-1 sign(K^-1 x); move to the unit
+        // vector of its largest entry unless that cannot do better
+        for (int i = 0; i < n; i++) y[i] = y[i] >= 0.0 ? 1.0 : -1.0;
+        if (cholesky_solve(&cache->sparse, y, 1, &ctx->scratch) != 0) {
+            estimate = INFINITY;
+            break;
+        }
+        int j = 0;
+        double gain = 0.0;
+        for (int i = 0; i < n; i++) {
+            if (fabs(y[i]) > fabs(y[j])) j = i;
+            gain += y[i] * x[i];
+        }
+        if (iteration > 0 && fabs(y[j]) <= gain) break;
+        memset(x, 0, n * sizeof(double));
+        x[j] = 1.0;
+    }
+    arena_release(&ctx->scratch, mark);
+    return estimate * cache->stiffness_norm;
+}
+
+// Solve with a single precision factor, refining every load case in
+// double precision: D += K^-1 (F - K D) with the residual taken against
+// K_free, until the normwise backward error |F - K D| / (|K| |D| + |F|)
+// in the infinity norm is within sqrt(n) of the double precision unit
+// roundoff. If refinement stalls the factor is redone in double.
+int solve_refined(TrussContext *ctx, const double *F_reduced, double *D_reduced, int nrhs) {
+    SolverCache *cache = &ctx->solver;
+    int n = cache->n_free;
+    size_t size = (size_t)n * nrhs;
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    double *F = arena_alloc(&ctx->scratch, size * sizeof(double));
+    double *R = arena_alloc(&ctx->scratch, size * sizeof(double));
+    if (!F || !R) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+    }
+    memcpy(F, F_reduced, size * sizeof(double));
+    memcpy(D_reduced, F, size * sizeof(double));
+    if (cholesky_solve(&cache->sparse, D_reduced, nrhs, &ctx->scratch) != 0) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+    }
+    
+    double tolerance = sqrt((double)n) * DBL_EPSILON;
+    double previous = INFINITY;
+    double worst;
+    int steps = 0;
+    for (;;) {
+        worst = 0.0;
+        for (int c = 0; c < nrhs; c++) {
+            const double *f = F + (size_t)c * n;
+            const double *d = D_reduced + (size_t)c * n;
+            double *r = R + (size_t)c * n;
+            sparse_multiply(&cache->K_free, d, r);
+            double norm_r = 0.0, norm_d = 0.0, norm_f = 0.0;
+            for (int i = 0; i < n; i++) {
+                r[i] = f[i] - r[i];
+                norm_r = fmax(norm_r, fabs(r[i]));
+                norm_d = fmax(norm_d, fabs(d[i]));
+                norm_f = fmax(norm_f, fabs(f[i]));
+            }
+            double scale = cache->stiffness_norm * norm_d + norm_f;
+            if (scale > 0.0) worst = fmax(worst, norm_r / scale);
+        }
+        if (worst <= tolerance || steps == MIXED_MAX_REFINEMENTS || worst > MIXED_STALL_RATIO * previous) break;
+        previous = worst;
+        if (cholesky_solve(&cache->sparse, R, nrhs, &ctx->scratch) != 0) {
+            arena_release(&ctx->scratch, mark);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+        }
+        for (size_t k = 0; k < size; k++) D_reduced[k] += R[k];
+        steps++;
+    }
+    
+    int status = TRUSS_OK;
+    if (worst > tolerance) {
+        log_warning(ctx, "Mixed precision: refinement stalled at backward error %.2e after %d step%s; "
+                    "factoring in double precision\n", worst, steps, steps == 1 ? "" : "s");
+        ProfileClock start = profile_clock(ctx);
+        arena_release(&cache->arena, cache->reduced);
+        cache->condition = 0.0;
+        status = factor_sparse(ctx, &cache->K_free, cache->dof_map, 0, &cache->sparse);
+        if (status == TRUSS_OK) {
+            record_factor_stats(ctx, &cache->K_free);
+            memcpy(D_reduced, F, size * sizeof(double));
+            if (cholesky_solve(&cache->sparse, D_reduced, nrhs, &ctx->scratch) != 0) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory solving for displacements");
+            }
+        } else {
+            solver_cache_free(cache);
+        }
+        profile_phase(ctx, TRUSS_PHASE_REDUCE, start, profile_clock(ctx));
+    } else {
+        if (steps > cache->stats.refinements) cache->stats.refinements = steps;
+        cache->stats.backward_error = fmax(cache->stats.backward_error, worst);
+    }
+    if (status == TRUSS_OK) status = spill_status(ctx);
+    arena_release(&ctx->scratch, mark);
+    return status;
+}
+
+// Elimination order of the reduced DOFs for sparse Cholesky: nodes by
+// nested dissection, each node's free DOFs consecutively so they end up
+// in the same supernode. Returns 0, or -1 when out of memory.
+int sparse_order(TrussContext *ctx, const int *dof_map, int *perm) {
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *node_order = arena_alloc(&ctx->scratch, ctx->n_nodes * sizeof(int));
+    int n_ordered = node_order ? nested_dissection_order(ctx, dof_map, node_order) : -1;
+    if (n_ordered < 0) {
+        arena_release(&ctx->scratch, mark);
+        return -1;
+    }
+    int k = 0;
+    for (int p = 0; p < n_ordered; p++) {
+        for (int a = 0; a < 3; a++) {
+            int dof = dof_map[3*node_order[p] + a];
+            if (dof >= 0) perm[k++] = dof;
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    return 0;
+}
+
+// Report a mechanism at a reduced DOF, mapped back to its node and
+// direction
+int report_unstable_dof(TrussContext *ctx, const int *dof_map, int reduced_dof) {
+    int dof = 0;
+    while (dof_map[dof] != reduced_dof) dof++;
+    const char *dir[3] = {"X", "Y", "Z"};
+    return set_error(ctx, TRUSS_ERROR_UNSTABLE, "Structure is unstable - stiffness matrix is singular at node %d (%s direction)", ctx->nodes[dof / 3].id, dir[dof % 3]);
+}
+
+// y = A * x; rows are independent, so the result does not depend on
+// the thread count
+void sparse_multiply(const SparseMatrix *A, const double *x, double *y) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < A->n; i++) {
+        double sum = 0.0;
+        for (int p = A->row_ptr[i]; p < A->row_ptr[i + 1]; p++) {
+            sum += A->values[p] * x[A->col_idx[p]];
+        }
+        y[i] = sum;
+    }
+}
+
+// Build the PCG preconditioner: the inverse of every diagonal block of
+// the reduced matrix. It needs at most one 3x3 block per node, so with
+// the CSR matrix and a few work vectors PCG memory stays O(nnz).
+int pcg_setup(TrussContext *ctx, const SparseMatrix *K_free, const int *dof_map, PcgPreconditioner *pre) {
+    int n_free = K_free->n;
+    
+    // A node's free DOFs are consecutive in the reduced numbering, so each
+    // node contributes one diagonal block of size 1..3 (all 1 for Jacobi).
+    // Nodes may be renumbered, so the blocks are listed by first DOF.
+    int *block_start = arena_alloc(&ctx->solver.arena, (n_free + 1) * sizeof(int));
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *node_size = arena_calloc(&ctx->scratch, n_free, sizeof(int));
+    if (!block_start || !node_size) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory building the PCG preconditioner");
+    }
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        int size = 0;
+        int first = -1;
+        for (int a = 0; a < 3; a++) {
+            if (dof_map[3*i + a] >= 0) {
+                if (first < 0) first = dof_map[3*i + a];
+                size++;
+            }
+        }
+        if (size > 0) node_size[first] = size;
+    }
+    int n_blocks = 0;
+    for (int first = 0; first < n_free; first += node_size[first]) {
+        if (ctx->preconditioner == PRECOND_BLOCK_JACOBI) {
+            block_start[n_blocks++] = first;
+        } else {
+            for (int a = 0; a < node_size[first]; a++) block_start[n_blocks++] = first + a;
+        }
+    }
+    block_start[n_blocks] = n_free;
+    arena_release(&ctx->scratch, mark);
+    
+    // Invert each diagonal block: Cholesky, then L^-T L^-1 column by column
+    double (*block_inv)[9] = arena_alloc(&ctx->solver.arena, n_blocks * sizeof(double[9]));
+    if (!block_inv) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory building the PCG preconditioner");
+    int status = TRUSS_OK;
+    for (int b = 0; b < n_blocks && status == TRUSS_OK; b++) {
+        int first = block_start[b];
+        int size = block_start[b + 1] - first;
+        double Lb[3][3] = {{0}};
+        for (int r = 0; r < size; r++) {
+            int row = first + r;
+            for (int p = K_free->row_ptr[row]; p < K_free->row_ptr[row + 1]; p++) {
+                int c = K_free->col_idx[p] - first;
+                if (c >= 0 && c < size) Lb[r][c] = K_free->values[p];
+            }
+        }
+        double a_diag[3] = {Lb[0][0], Lb[1][1], Lb[2][2]};
+        for (int r = 0; r < size && ctx->solver.pivot_diag; r++) a_diag[r] = ctx->solver.pivot_diag[first + r];
+        for (int j = 0; j < size; j++) {
+            for (int t = 0; t < j; t++) Lb[j][j] -= Lb[j][t] * Lb[j][t];
+            if (!(Lb[j][j] > TOL * fabs(a_diag[j]))) {
+                status = report_unstable_dof(ctx, dof_map, first + j);
+                break;
+            }
+            Lb[j][j] = sqrt(Lb[j][j]);
+            for (int i = j + 1; i < size; i++) {
+                for (int t = 0; t < j; t++) Lb[i][j] -= Lb[i][t] * Lb[j][t];
+                Lb[i][j] /= Lb[j][j];
+            }
+        }
+        if (status != TRUSS_OK) break;
+        for (int c = 0; c < size; c++) {
+            double e[3] = {0.0, 0.0, 0.0};
+            e[c] = 1.0;
+            for (int i = 0; i < size; i++) {
+                for (int t = 0; t < i; t++) e[i] -= Lb[i][t] * e[t];
+                e[i] /= Lb[i][i];
+            }
+            for (int i = size - 1; i >= 0; i--) {
+                for (int t = i + 1; t < size; t++) e[i] -= Lb[t][i] * e[t];
+                e[i] /= Lb[i][i];
+            }
+            for (int r = 0; r < size; r++) block_inv[b][r*size + c] = e[r];
+        }
+    }
+    
+    pre->n_blocks = n_blocks;
+    pre->block_start = block_start;
+    pre->block_inv = block_inv;
+    return status;
+}
+
+// Solve the reduced system by preconditioned conjugate gradients, one
+// load case after the other
+int solve_pcg(TrussContext *ctx, const SparseMatrix *K_free, const PcgPreconditioner *pre,
+              const double *F_reduced, double *D_reduced, int nrhs) {
+    int n_free = K_free->n;
+    int n_blocks = pre->n_blocks;
+    const int *block_start = pre->block_start;
+    double (*block_inv)[9] = pre->block_inv;
+    int status = TRUSS_OK;
+    
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    double *r = arena_alloc(&ctx->scratch, n_free * sizeof(double));
+    double *z = arena_alloc(&ctx->scratch, n_free * sizeof(double));
+    double *p = arena_alloc(&ctx->scratch, n_free * sizeof(double));
+    double *q = arena_alloc(&ctx->scratch, n_free * sizeof(double));
+    if (!r || !z || !p || !q) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory in the PCG solver");
+    }
+    
+    int max_iterations = ctx->pcg_max_iterations > 0 ? ctx->pcg_max_iterations : 2 * n_free;
+    
+    for (int c = 0; c < nrhs && status == TRUSS_OK; c++) {
+        const double *F = F_reduced + (size_t)c * n_free;
+        double *D = D_reduced + (size_t)c * n_free;
+        double norm_b = 0.0;
+        for (int i = 0; i < n_free; i++) {
+            D[i] = 0.0;
+            r[i] = F[i];
+            norm_b += r[i] * r[i];
+        }
+        norm_b = sqrt(norm_b);
+        
+        int iterations = 0;
+        double rel_residual = 0.0;
+        double rz = 0.0;
+        
+        while (norm_b > 0.0) {
+            // z = M^-1 r
+            for (int b = 0; b < n_blocks; b++) {
+                int first = block_start[b];
+                int size = block_start[b + 1] - first;
+                for (int i = 0; i < size; i++) {
+                    double sum = 0.0;
+                    for (int j = 0; j < size; j++) sum += block_inv[b][i*size + j] * r[first + j];
+                    z[first + i] = sum;
+                }
+            }
+            
+            double rz_new = 0.0;
+            for (int i = 0; i < n_free; i++) rz_new += r[i] * z[i];
+            if (iterations == 0) {
+                memcpy(p, z, n_free * sizeof(double));
+            } else {
+                double beta = rz_new / rz;
+                for (int i = 0; i < n_free; i++) p[i] = z[i] + beta * p[i];
+            }
+            rz = rz_new;
+            
+            sparse_multiply(K_free, p, q);
+            double pq = 0.0;
+            for (int i = 0; i < n_free; i++) pq += p[i] * q[i];
+            if (!(pq > 0.0)) {
+                status = set_error(ctx, TRUSS_ERROR_UNSTABLE, "Structure is unstable - stiffness matrix is not positive definite");
+                break;
+            }
+            double alpha = rz / pq;
+            
+            double norm_r = 0.0;
+            for (int i = 0; i < n_free; i++) {
+                D[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+                norm_r += r[i] * r[i];
+            }
+            iterations++;
+            rel_residual = sqrt(norm_r) / norm_b;
+            if (rel_residual <= ctx->pcg_tolerance || iterations >= max_iterations) break;
+        }
+        
+        if (status != TRUSS_OK) break;
+        if (iterations > ctx->solver.stats.iterations) ctx->solver.stats.iterations = iterations;
+        ctx->solver.stats.residual = fmax(ctx->solver.stats.residual, rel_residual);
+        char case_label[32] = "";
+        if (nrhs > 1) snprintf(case_label, sizeof(case_label), "Load case %d: ", c + 1);
+        if (rel_residual <= ctx->pcg_tolerance) {
+            log_message(ctx, "%sPCG converged in %d iterations (relative residual %.3e)\n",
+                        case_label, iterations, rel_residual);
+        } else if (nrhs > 1) {
+            log_warning(ctx, "Warning: PCG did not converge in %d iterations (relative residual %.3e) for load case %d\n",
+                        iterations, rel_residual, c + 1);
+        } else {
+            log_warning(ctx, "Warning: PCG did not converge in %d iterations (relative residual %.3e)\n",
+                        iterations, rel_residual);
+        }
+    }
+    
+    arena_release(&ctx->scratch, mark);
+    return status;
+}
+
+// Reactions R = K D - F at the fixed DOFs, from the rows of K_global
+// for the supports only, so the cost follows the members meeting the
+// supports; free DOFs get R = 0, and the Z DOFs of a planar model, which
+// have no row, R = -F. As a check on the solve, the sums of
+// reactions and loads in each direction, which vanish at equilibrium,
+// are kept per load case.
+int compute_reactions(TrussContext *ctx) {
+    const SolverCache *cache = &ctx->solver;
+    const SparseMatrix *K = &ctx->K_global;
+    int nrhs = ctx->n_load_cases;
+    ctx->reactions = arena_calloc(&ctx->solve_arena, (size_t)ctx->total_dofs * nrhs, sizeof(double));
+    ctx->equilibrium = arena_calloc(&ctx->solve_arena, (size_t)nrhs * 3, sizeof(double));
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    NonlinearState nl;
+    int status = ctx->nonlinear ? nonlinear_state(ctx, &nl, &ctx->scratch) : TRUSS_OK;
+    if (!ctx->reactions || !ctx->equilibrium || status != TRUSS_OK) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory computing reactions");
+    }
+    
+    double worst = 0.0;
+    int worst_case = 0;
+    for (int c = 0; c < nrhs; c++) {
+        double *R = ctx->reactions + (size_t)c * ctx->total_dofs;
+        const double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+        const double *F = ctx->F_global + (size_t)c * ctx->total_dofs;
+        
+        if (ctx->nonlinear) {
+            // Supports balance the members' forces in the deformed
+            // geometry. The tangent factorization and its numbering are
+            // gone by now, so fixed DOFs come from the nodes.
+            deform_members(ctx, &nl, D);
+            internal_forces(ctx, &nl);
+            for (int i = 0; i < ctx->total_dofs; i++) {
+                if (ctx->nodes[i / 3].constraints[i % 3]) R[i] = nl.internal[i] - F[i];
+            }
+        } else {
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < cache->n_fixed; k++) {
+                int i = cache->fixed_dofs[k];
+                int d = ctx->node_dofs;
+                double sum = 0.0;
+                if (i % 3 < d) {
+                    int row = d * (i / 3) + i % 3;
+                    for (int p = K->row_ptr[row]; p < K->row_ptr[row + 1]; p++) {
+                        sum += K->values[p] * D[full_dof(K->col_idx[p], d)];
+                    }
+                }
+                R[i] = sum - F[i];
+            }
+        }
+        
+        // Imbalance relative to the total magnitude of loads and reactions
+        double *sums = ctx->equilibrium + 3 * c;
+        double scale = 0.0;
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            sums[i % 3] += R[i] + F[i];
+            scale += fabs(R[i]) + fabs(F[i]);
+        }
+        double imbalance = sqrt(sums[0] * sums[0] + sums[1] * sums[1] + sums[2] * sums[2]);
+        double relative = scale > 0.0 ? imbalance / scale : 0.0;
+        if (relative > worst || c == 0) {
+            worst = relative;
+            worst_case = c;
+        }
+    }
+    ctx->solver.stats.imbalance = worst;
+    arena_release(&ctx->scratch, mark);
+    
+    char case_label[32] = "";
+    if (nrhs > 1) snprintf(case_label, sizeof(case_label), " (load case %d)", worst_case + 1);
+    if (worst > EQUILIBRIUM_TOL) {
+        log_warning(ctx, "Warning: Loads and reactions are out of balance by %.3e of their magnitude%s\n",
+                    worst, case_label);
+    } else {
+        log_warning(ctx, "Equilibrium check: loads and reactions balance to %.3e of their magnitude%s\n",
+                    worst, case_label);
+    }
+    return TRUSS_OK;
+}
+
+int compute_member_forces(TrussContext *ctx) {
+    if (ctx->n_members == 0) return TRUSS_OK;
+    
+    ctx->member_results = arena_alloc(&ctx->solve_arena, (size_t)ctx->n_members * ctx->n_load_cases * sizeof(MemberResult));
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    NonlinearState nl;
+    int status = ctx->nonlinear ? nonlinear_state(ctx, &nl, &ctx->scratch) : TRUSS_OK;
+    if (!ctx->member_results || status != TRUSS_OK) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory computing member forces");
+    }
+    
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+        MemberResult *results = ctx->member_results + (size_t)c * ctx->n_members;
+        
+        if (ctx->nonlinear) {
+            deform_members(ctx, &nl, D);
+            #pragma omp parallel for schedule(static)
+            for (int b = 0; b < ctx->n_members; b += MEMBER_BATCH) {
+                deformed_force_kernel(nl.deformed, nl.axial, results, b,
+                                      b + MEMBER_BATCH < ctx->n_members ? b + MEMBER_BATCH : ctx->n_members);
+            }
+            continue;
+        }
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < ctx->n_members; b += MEMBER_BATCH) {
+            member_force_kernel(ctx->member_geometry, D, results, b,
+                                b + MEMBER_BATCH < ctx->n_members ? b + MEMBER_BATCH : ctx->n_members);
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    return TRUSS_OK;
+}
+
+// Axial deformation, force and stress of members begin..end-1 under the
+// displacements D of one load case
+SIMD_CLONES
+void member_force_kernel(const MemberGeometry *g, const double *D, MemberResult *results, int begin, int end) {
+    #pragma omp simd
+    for (int m = begin; m < end; m++) {
+        int i = 3*g->node1[m];
+        int j = 3*g->node2[m];
+        double delta = g->cos[0][m]*(D[j] - D[i]) +
+                       g->cos[1][m]*(D[j+1] - D[i+1]) +
+                       g->cos[2][m]*(D[j+2] - D[i+2]);
+        double force = g->stiffness[m] * delta;
+        results[m].force = force;
+        results[m].stress = force / g->area[m];
+        results[m].length = g->length[m];
+        results[m].status = force > 0 ? TRUSS_TENSION : TRUSS_COMPRESSION;
+        results[m].reserved = 0;
+    }
+}
+
+// Results of members begin..end-1 of a nonlinear analysis: their axial
+// forces and lengths in the deformed geometry d
+SIMD_CLONES
+void deformed_force_kernel(const MemberGeometry *d, const double *axial, MemberResult *results, int begin, int end) {
+    #pragma omp simd
+    for (int m = begin; m < end; m++) {
+        results[m].force = axial[m];
+        results[m].stress = axial[m] / d->area[m];
+        results[m].length = d->length[m];
+        results[m].status = axial[m] > 0 ? TRUSS_TENSION : TRUSS_COMPRESSION;
+        results[m].reserved = 0;
+    }
+}
+
+const char *member_status_name(int status) {
+    return status == TRUSS_TENSION ? "Tension" : "Compression";
+}
+
+// Work arrays for deform_members, from arena
+int nonlinear_state(TrussContext *ctx, NonlinearState *nl, Arena *arena) {
+    const MemberGeometry *g = ctx->member_geometry;
+    MemberGeometry *d = arena_alloc(arena, sizeof(MemberGeometry));
+    nl->deformed = d;
+    nl->axial = arena_alloc(arena, ctx->n_members * sizeof(double));
+    nl->internal = arena_alloc(arena, ctx->total_dofs * sizeof(double));
+    if (!d || !nl->axial || !nl->internal) return TRUSS_ERROR_MEMORY;
+    *d = *g;
+    d->x = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    d->y = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    d->z = arena_alloc(arena, ctx->n_nodes * sizeof(double));
+    d->length = arena_alloc(arena, ctx->n_members * sizeof(double));
+    for (int a = 0; a < 3; a++) d->cos[a] = arena_alloc(arena, ctx->n_members * sizeof(double));
+    d->stiffness = arena_alloc(arena, ctx->n_members * sizeof(double));
+    if (!d->x || !d->y || !d->z || !d->length || !d->cos[0] || !d->cos[1] || !d->cos[2] || !d->stiffness) {
+        return TRUSS_ERROR_MEMORY;
+    }
+    return TRUSS_OK;
+}
+
+// Move the nodes by the total displacements D and recompute the member
+// geometry and axial forces: a corotational truss, in which members keep
+// their linear axial stiffness EA / L and turn with their nodes
+void deform_members(TrussContext *ctx, NonlinearState *nl, const double *D) {
+    const MemberGeometry *g = ctx->member_geometry;
+    MemberGeometry *d = nl->deformed;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        d->x[i] = g->x[i] + D[3*i];
+        d->y[i] = g->y[i] + D[3*i + 1];
+        d->z[i] = g->z[i] + D[3*i + 2];
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < ctx->n_members; b += MEMBER_BATCH) {
+        int end = b + MEMBER_BATCH < ctx->n_members ? b + MEMBER_BATCH : ctx->n_members;
+        member_geometry_kernel(d, b, end);
+        axial_force_kernel(g, d, D, nl->axial, b, end);
+    }
+}
+
+// Axial forces EA (l - L) / L of members begin..end-1. The elongation is
+// taken as (l^2 - L^2) / (l + L), with l^2 - L^2 expanded in the end
+// displacements, so it does not cancel for small strains and small
+// loads give the linear member forces.
+SIMD_CLONES
+void axial_force_kernel(const MemberGeometry *g, const MemberGeometry *d, const double *D, double *axial,
+                        int begin, int end) {
+    #pragma omp simd
+    for (int m = begin; m < end; m++) {
+        int i = 3*g->node1[m];
+        int j = 3*g->node2[m];
+        double ux = D[j] - D[i];
+        double uy = D[j+1] - D[i+1];
+        double uz = D[j+2] - D[i+2];
+        double L = g->length[m];
+        double stretch = 2.0 * L * (g->cos[0][m]*ux + g->cos[1][m]*uy + g->cos[2][m]*uz) + ux*ux + uy*uy + uz*uz;
+        axial[m] = g->stiffness[m] * stretch / (d->length[m] + L);
+    }
+}
+
+// Nodal forces of the members on the deformed geometry, each axial force
+// along its member, gathered color by color like the stiffness
+void internal_forces(TrussContext *ctx, NonlinearState *nl) {
+    const MemberGeometry *d = nl->deformed;
+    double *f = nl->internal;
+    memset(f, 0, ctx->total_dofs * sizeof(double));
+    for (int c = 0; c < ctx->n_member_colors; c++) {
+        #pragma omp parallel for schedule(static)
+        for (int idx = ctx->color_ptr[c]; idx < ctx->color_ptr[c + 1]; idx++) {
+            int m = ctx->color_members[idx];
+            int i = 3*d->node1[m];
+            int j = 3*d->node2[m];
+            for (int a = 0; a < 3; a++) {
+                double t = nl->axial[m] * d->cos[a][m];
+                f[i + a] -= t;
+                f[j + a] += t;
+            }
+        }
+    }
+}
+
+// Tangent stiffness of the deformed state into values, which has the
+// pattern of K_global
+void assemble_tangent(TrussContext *ctx, const NonlinearState *nl, double *values) {
+    const MemberGeometry *d = nl->deformed;
+    memset(values, 0, ctx->K_global.nnz * sizeof(double));
+    for (int c = 0; c < ctx->n_member_colors; c++) {
+        #pragma omp parallel for schedule(static)
+        for (int idx = ctx->color_ptr[c]; idx < ctx->color_ptr[c + 1]; idx++) {
+            int m = ctx->color_members[idx];
+            scatter_member_tangent(ctx, d, m, ctx->member_geometry->stiffness[m], nl->axial[m] / d->length[m], values);
+        }
+    }
+}
+
+// Out-of-balance force r = load_factor F - f(D) on the free DOFs, with
+// f the members' nodal forces at displacements D; returns its norm
+double nonlinear_residual(TrussContext *ctx, NonlinearState *nl, const double *F, double load_factor,
+                          const double *D, double *r) {
+    const int *dof_map = ctx->solver.dof_map;
+    deform_members(ctx, nl, D);
+    internal_forces(ctx, nl);
+    double norm = 0.0;
+    for (int i = 0; i < ctx->total_dofs; i++) {
+        int k = dof_map[i];
+        if (k < 0) continue;
+        r[k] = load_factor * F[i] - nl->internal[i];
+        norm += r[k] * r[k];
+    }
+    return sqrt(norm);
+}
+
+// Move D by the Newton correction du. With line search on, the step
+// eta du is shortened or lengthened by secant steps on the residual's
+// component along the correction, g(eta) = du . r(D + eta du), until
+// |g| falls to LINE_SEARCH_RATIO of g(0); otherwise eta = 1. Leaves the
+// residual at the new D in r and returns its norm; evaluations beyond
+// the first are added to *trials.
+double line_search(TrussContext *ctx, NonlinearState *nl, const double *F, double load_factor,
+                   double *D, const double *du, double *r, int *trials) {
+    const int *dof_map = ctx->solver.dof_map;
+    int n_free = ctx->solver.n_free;
+    double g0 = 0.0;
+    for (int k = 0; k < n_free; k++) g0 += du[k] * r[k];
+    
+    double eta = 1.0, applied = 0.0, norm_r;
+    for (int trial = 0; ; trial++) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0) D[i] += (eta - applied) * du[dof_map[i]];
+        }
+        applied = eta;
+        norm_r = nonlinear_residual(ctx, nl, F, load_factor, D, r);
+        if (!ctx->line_search || trial == LINE_SEARCH_TRIALS || !(g0 > 0.0)) break;
+        
+        double g = 0.0;
+        for (int k = 0; k < n_free; k++) g += du[k] * r[k];
+        if (fabs(g) <= LINE_SEARCH_RATIO * g0) break;
+        double next = g < g0 ? eta * g0 / (g0 - g) : 0.5 * eta;
+        next = fmin(fmax(next, LINE_SEARCH_MIN_STEP), 1.0);
+        if (next == eta) break;
+        eta = next;
+        (*trials)++;
+    }
+    return norm_r;
+}
+
+// Strain energy of the members in the deformed state of nl, N^2 / 2k
+// for each member of axial force N and stiffness k
+double strain_energy(const TrussContext *ctx, const NonlinearState *nl) {
+    const double *stiffness = ctx->member_geometry->stiffness;
+    double energy = 0.0;
+    for (int m = 0; m < ctx->n_members; m++) {
+        if (stiffness[m] > 0.0) energy += 0.5 * nl->axial[m] * nl->axial[m] / stiffness[m];
+    }
+    return energy;
+}
+
+// Whether the load step from D0 to D1 passed a limit point, so that
+// Newton-Raphson converged on another equilibrium branch. Both ends are
+// tangent-stable, so a check of the converged tangents alone would miss
+// the snap; instead the members' resistance along the step, g(t) =
+// d . f(D0 + t d) with d = D1 - D0, must not drop. Its integral is the
+// change in strain energy, so the ends alone bound how it can behave: a
+// nondecreasing g keeps the mean (U(b) - U(a)) / (b - a) over [a, b]
+// between g(a) and g(b), and a nondecreasing quadratic keeps it within
+// (g(b) - g(a)) / 6 of the trapezoid (g(a) + g(b)) / 2. Only an interval
+// that is not that smooth is bisected, at most LIMIT_POINT_DEPTH times,
+// so a gentle step costs no evaluation beyond the internal forces f0 and
+// strain energy at D0 and those nl holds at D1. D and d are work arrays;
+// nl is left deformed to some point along the step.
+int passes_limit_point(TrussContext *ctx, NonlinearState *nl, const double *D0, const double *D1,
+                       const double *f0, double energy0, double *D, double *d) {
+    const int *dof_map = ctx->solver.dof_map;
+    double t[2] = {0.0, 1.0};
+    double g[2] = {0.0, 0.0};
+    double energy[2] = {energy0, strain_energy(ctx, nl)};
+    double scale = 0.0;
+    for (int i = 0; i < ctx->total_dofs; i++) {
+        if (dof_map[i] < 0) continue;
+        d[dof_map[i]] = D1[i] - D0[i];
+        g[0] += d[dof_map[i]] * f0[i];
+        g[1] += d[dof_map[i]] * nl->internal[i];
+        scale += fabs(d[dof_map[i]] * f0[i]) + fabs(d[dof_map[i]] * nl->internal[i]);
+    }
+    return limit_point_interval(ctx, nl, D0, D1, d, D, t, g, energy, 0, LIMIT_POINT_TOL * scale);
+}
+
+// Check the interval t[0]..t[1] of a load step for a limit point, given
+// g and the strain energy at both ends; see passes_limit_point. The
+// energies carry the rounding of the whole load path, so the mean is
+// compared with a tolerance relative to them as well.
+int limit_point_interval(TrussContext *ctx, NonlinearState *nl, const double *D0, const double *D1,
+                         const double *d, double *D, const double *t, const double *g, const double *energy,
+                         int depth, double tolerance) {
+    double width = t[1] - t[0];
+    double mean = (energy[1] - energy[0]) / width;
+    double mean_tolerance = tolerance + LIMIT_POINT_TOL * (fabs(energy[0]) + fabs(energy[1])) / width;
+    if (g[1] < g[0] - tolerance || mean < g[0] - mean_tolerance || mean > g[1] + mean_tolerance) return 1;
+    if (depth == LIMIT_POINT_DEPTH || fabs(mean - 0.5 * (g[0] + g[1])) <= (g[1] - g[0]) / 6.0 + mean_tolerance) {
+        return 0;
+    }
+    
+    double mid = 0.5 * (t[0] + t[1]);
+    for (int i = 0; i < ctx->total_dofs; i++) D[i] = D0[i] + mid * (D1[i] - D0[i]);
+    deform_members(ctx, nl, D);
+    internal_forces(ctx, nl);
+    const int *dof_map = ctx->solver.dof_map;
+    double g_mid = 0.0;
+    for (int i = 0; i < ctx->total_dofs; i++) {
+        if (dof_map[i] >= 0) g_mid += d[dof_map[i]] * nl->internal[i];
+    }
+    double energy_mid = strain_energy(ctx, nl);
+    
+    double t_left[2] = {t[0], mid}, g_left[2] = {g[0], g_mid}, energy_left[2] = {energy[0], energy_mid};
+    double t_right[2] = {mid, t[1]}, g_right[2] = {g_mid, g[1]}, energy_right[2] = {energy_mid, energy[1]};
+    return limit_point_interval(ctx, nl, D0, D1, d, D, t_left, g_left, energy_left, depth + 1, tolerance) ||
+           limit_point_interval(ctx, nl, D0, D1, d, D, t_right, g_right, energy_right, depth + 1, tolerance);
+}
+
+// Geometrically nonlinear analysis of every load case. The loads are
+// applied in ctx->load_steps equal increments, each brought to
+// equilibrium by Newton-Raphson iterations on the deformed geometry;
+// every load case starts from the undeformed structure. Full Newton
+// factors the tangent stiffness at every iteration, modified Newton only
+// at the start of a load step and when an iteration barely reduces the
+// residual. Refactorizations keep the DOF numbering and fill-reducing
+// order of the first.
+int solve_nonlinear(TrussContext *ctx) {
+    SolverCache *cache = &ctx->solver;
+    
+    // The tangent of the undeformed structure is the linear stiffness, so
+    // a factorization of it from an earlier solve serves the first
+    // iteration if no member has changed since and no substructures were
+    // condensed in it
+    if (cache->condensed) solver_cache_free(cache);
+    for (int m = 0; m < ctx->n_members && cache->valid; m++) {
+        if (ctx->member_geometry->stiffness[m] != cache->factored_stiffness[m]) solver_cache_free(cache);
+    }
+    if (cache->valid) {
+        log_message(ctx, "Reusing stiffness factorization (0 member updates)\n");
+        cache->stats.reused = 1;
+    } else {
+        int status = factor_stiffness(ctx);
+        if (status != TRUSS_OK) return status;
+    }
+    cache->stats.iterations = 0;
+    cache->stats.refinements = 0;
+    cache->stats.residual = -1.0;
+    cache->stats.backward_error = -1.0;
+    int n_free = cache->n_free;
+    const int *dof_map = cache->dof_map;
+    int steps = ctx->load_steps;
+    int nrhs = ctx->n_load_cases;
+    
+    ctx->displacements = arena_calloc(&ctx->solve_arena, (size_t)ctx->total_dofs * nrhs, sizeof(double));
+    ctx->step_reports = arena_calloc(&ctx->solve_arena, (size_t)nrhs * steps, sizeof(TrussStepReport));
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    NonlinearState nl;
+    int status = nonlinear_state(ctx, &nl, &ctx->scratch);
+    SparseMatrix tangent = ctx->K_global;
+    tangent.values = arena_alloc(&ctx->scratch, ctx->K_global.nnz * sizeof(double));
+    double *r = arena_alloc(&ctx->scratch, (n_free > 0 ? n_free : 1) * sizeof(double));
+    double *du = arena_alloc(&ctx->scratch, (n_free > 0 ? n_free : 1) * sizeof(double));
+    double *D_step = arena_alloc(&ctx->scratch, ctx->total_dofs * sizeof(double));
+    double *f_step = arena_alloc(&ctx->scratch, ctx->total_dofs * sizeof(double));
+    double *D_trial = arena_alloc(&ctx->scratch, ctx->total_dofs * sizeof(double));
+    if (!ctx->displacements || !ctx->step_reports || status != TRUSS_OK || !tangent.values || !r || !du ||
+        !D_step || !f_step || !D_trial) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory in the nonlinear analysis");
+    }
+    
+    int linear = 1;             // the factorization is still that of K_global
+    double worst = 0.0;
+    for (int c = 0; c < nrhs && status == TRUSS_OK; c++) {
+        double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+        const double *F = ctx->F_global + (size_t)c * ctx->total_dofs;
+        double norm_f = 0.0;
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0) norm_f += F[i] * F[i];
+        }
+        norm_f = sqrt(norm_f);
+        char case_label[32] = "";
+        if (nrhs > 1) snprintf(case_label, sizeof(case_label), ", load case %d", c + 1);
+        int current = linear;   // the factorization is the tangent at D
+        
+        for (int s = 1; s <= steps && status == TRUSS_OK; s++) {
+            double start = wall_time();
+            TrussStepReport *report = &ctx->step_reports[ctx->n_step_reports++];
+            report->load_case = c;
+            report->step = s;
+            report->load_factor = (double)s / steps;
+            double target = ctx->newton_tolerance * report->load_factor * norm_f;
+            memcpy(D_step, D, ctx->total_dofs * sizeof(double));
+            double norm_r = nonlinear_residual(ctx, &nl, F, report->load_factor, D, r);
+            memcpy(f_step, nl.internal, ctx->total_dofs * sizeof(double));
+            double energy_step = strain_energy(ctx, &nl);
+            double previous = INFINITY;
+            while (norm_r > target) {
+                if (!isfinite(norm_r) || report->iterations == ctx->newton_max_iterations) {
+                    status = set_error(ctx, TRUSS_ERROR_UNSTABLE, "No convergence at load step %d of %d%s: relative "
+                                       "residual %.3e after %d iterations; try more load steps", s, steps, case_label,
+                                       norm_r / (report->load_factor * norm_f), report->iterations);
+                    break;
+                }
+                if (!current && (!ctx->modified_newton || report->iterations == 0 ||
+                                 norm_r > NEWTON_STALL_RATIO * previous)) {
+                    assemble_tangent(ctx, &nl, tangent.values);
+                    status = refactor_stiffness(ctx, &tangent);
+                    linear = 0;
+                    if (status != TRUSS_OK) {
+                        char reason[sizeof(ctx->error)];
+                        memcpy(reason, ctx->error, sizeof(reason));
+                        set_error(ctx, status, "%s at load step %d of %d%s", reason, s, steps, case_label);
+                        break;
+                    }
+                    report->factorizations++;
+                    current = 1;
+                }
+                status = solve_factored(ctx, r, du, 1);
+                if (status != TRUSS_OK) break;
+                previous = norm_r;
+                norm_r = line_search(ctx, &nl, F, report->load_factor, D, du, r, &report->line_search_trials);
+                current = 0;
+                report->iterations++;
+            }
+            if (status == TRUSS_OK && passes_limit_point(ctx, &nl, D_step, D, f_step, energy_step, D_trial, du)) {
+                status = set_error(ctx, TRUSS_ERROR_UNSTABLE, "Limit point passed at load step %d of %d%s: the "
+                                   "structure snaps through or buckles, which load control cannot follow",
+                                   s, steps, case_label);
+            }
+            report->residual = norm_f > 0.0 ? norm_r / (report->load_factor * norm_f) : 0.0;
+            report->wall_time = wall_time() - start;
+            worst = fmax(worst, report->residual);
+            log_warning(ctx, "Load step %d/%d%s: %d iteration%s, %d factorization%s, relative residual %.3e, %.3f s\n",
+                        s, steps, case_label, report->iterations, report->iterations == 1 ? "" : "s",
+                        report->factorizations, report->factorizations == 1 ? "" : "s",
+                        report->residual, report->wall_time);
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    
+    // Later solves cannot use the factorization of a tangent stiffness
+    if (!linear) {
+        TrussSolverStats stats = cache->stats;
+        solver_cache_free(cache);
+        cache->stats = stats;
+    }
+    if (status == TRUSS_OK) cache->stats.residual = worst;
+    return status;
+}
+
+// Mass matrix of the members into ctx->mass, which has the pattern of
+// K_global. Each member's mass, density x A x L, is lumped, half at
+// either end node in every direction, or consistent, the bar's
+// m / 6 [2I I; I 2I].
+int assemble_mass(TrussContext *ctx) {
+    if (!(ctx->density > 0.0)) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Modal analysis needs the members' mass density; set the density option");
+    }
+    ctx->mass = arena_calloc(&ctx->solve_arena, ctx->K_global.nnz > 0 ? ctx->K_global.nnz : 1, sizeof(double));
+    if (!ctx->mass) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory assembling the mass matrix");
+    const MemberGeometry *g = ctx->member_geometry;
+    for (int c = 0; c < ctx->n_member_colors; c++) {
+        #pragma omp parallel for schedule(static)
+        for (int idx = ctx->color_ptr[c]; idx < ctx->color_ptr[c + 1]; idx++) {
+            int m = ctx->color_members[idx];
+            scatter_member_mass(ctx, m, ctx->density * g->area[m] * g->length[m], ctx->mass);
+        }
+    }
+    return TRUSS_OK;
+}
+
+// Add the element mass matrix of member m, whose total mass is mass,
+// into values, which has the pattern of K_global
+void scatter_member_mass(TrussContext *ctx, int m, double mass, double *values) {
+    int D = ctx->node_dofs;
+    int elem_nodes[2] = {ctx->members[m].node1, ctx->members[m].node2};
+    for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 2; b++) {
+            double mab = ctx->consistent_mass ? mass * (a == b ? 2.0 : 1.0) / 6.0 : (a == b ? 0.5 * mass : 0.0);
+            if (mab == 0.0) continue;
+            int block_col = D * find_adjacent_node(ctx, elem_nodes[a], elem_nodes[b]);
+            for (int d = 0; d < D; d++) {
+                values[ctx->K_global.row_ptr[D*elem_nodes[a] + d] + block_col + d] += mab;
+            }
+        }
+    }
+}
+
+// Lowest ctx->requested_modes natural modes, K phi = omega^2 M phi, by
+// block Lanczos with full reorthogonalization on the shift-inverted
+// problem K^-1 M phi = phi / omega^2 (shift zero). The lowest modes are
+// its largest eigenvalues, which Lanczos finds first, and each step
+// only solves with the stiffness factorization of static analysis, so
+// one factorization serves every iteration and the cost follows the
+// sparse factor. The basis grows LANCZOS_BLOCK M-orthonormal vectors at
+// a time from a pseudo-random start, which also finds repeated
+// frequencies such as the sway pairs of a symmetric tower; T = V^T M
+// K^-1 M V, block tridiagonal, is diagonalized by Jacobi rotations
+// whenever the basis has grown by an eighth.
+int solve_modal(TrussContext *ctx) {
+    if (ctx->solver_type == SOLVER_PCG) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Modal analysis needs a direct solver, not PCG");
+    }
+    SolverCache *cache = &ctx->solver;
+    if (cache->condensed) solver_cache_free(cache);
+    for (int m = 0; m < ctx->n_members && cache->valid; m++) {
+        if (ctx->member_geometry->stiffness[m] != cache->factored_stiffness[m]) solver_cache_free(cache);
+    }
+    if (cache->valid) {
+        log_message(ctx, "Reusing stiffness factorization (0 member updates)\n");
+        cache->stats.reused = 1;
+    } else {
+        int status = factor_stiffness(ctx);
+        if (status != TRUSS_OK) return status;
+    }
+    cache->stats.iterations = 0;
+    cache->stats.refinements = 0;
+    cache->stats.residual = -1.0;
+    cache->stats.backward_error = -1.0;
+    int n = cache->n_free;
+    const int *dof_map = cache->dof_map;
+    int want = ctx->requested_modes < n ? ctx->requested_modes : n;
+    int p = LANCZOS_BLOCK < n ? LANCZOS_BLOCK : n;
+    int max_basis = LANCZOS_BASIS_PER_MODE * want > LANCZOS_MIN_BASIS ? LANCZOS_BASIS_PER_MODE * want : LANCZOS_MIN_BASIS;
+    if (max_basis > n) max_basis = n;
+    int max_blocks = p > 0 ? (max_basis + p - 1) / p : 0;
+    int cap = max_blocks * p;
+    
+    ctx->modes = arena_calloc(&ctx->solve_arena, want > 0 ? want : 1, sizeof(TrussMode));
+    ctx->mode_shapes = arena_calloc(&ctx->solve_arena, (size_t)(want > 0 ? want : 1) * ctx->total_dofs, sizeof(double));
+    if (!ctx->modes || !ctx->mode_shapes) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory in the modal analysis");
+    if (want == 0) return TRUSS_OK;
+    
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    SparseMatrix mass = ctx->K_global;
+    mass.values = ctx->mass;
+    SparseMatrix M;
+    int extracted = sparse_extract_free(&mass, ctx->node_dofs, dof_map, n, &M, &ctx->scratch);
+    double *V = arena_alloc(&ctx->scratch, (size_t)(cap + p) * n * sizeof(double));
+    double *MQ = arena_alloc(&ctx->scratch, (size_t)p * n * sizeof(double));
+    double *T = arena_calloc(&ctx->scratch, (size_t)cap * cap, sizeof(double));
+    double *a = arena_alloc(&ctx->scratch, (size_t)cap * cap * sizeof(double));
+    double *S = arena_alloc(&ctx->scratch, (size_t)cap * cap * sizeof(double));
+    double *R = arena_alloc(&ctx->scratch, (size_t)p * p * sizeof(double));
+    double *coef = arena_alloc(&ctx->scratch, 2 * (size_t)(cap + p) * sizeof(double));
+    int *order = arena_alloc(&ctx->scratch, cap * sizeof(int));
+    if (extracted != 0 || !V || !MQ || !T || !a || !S || !R || !coef || !order) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory in the modal analysis");
+    }
+    
+    uint32_t seed = 1;
+    lanczos_random(V, p * n, &seed);
+    lanczos_normalize(&M, V, 0, p, MQ, R, coef, &seed);
+    int status = TRUSS_OK;
+    int m = 0, converged = 0, next_check = want;
+    for (int j = 0; j < max_blocks; j++) {
+        // W = K^-1 M Q_j, the next block, and T's diagonal block Q_j^T M W
+        double *W = V + (size_t)(j + 1) * p * n;
+        status = solve_factored(ctx, MQ, W, p);
+        if (status != TRUSS_OK) break;
+        ctx->lanczos_steps++;
+        for (int r = 0; r < p; r++) {
+            for (int c = 0; c < p; c++) {
+                double dot = 0.0;
+                for (int i = 0; i < n; i++) dot += MQ[(size_t)r * n + i] * W[(size_t)c * n + i];
+                T[(size_t)(j*p + r) * cap + j*p + c] = dot;
+            }
+        }
+        for (int r = 0; r < p; r++) {
+            for (int c = r + 1; c < p; c++) {
+                double mean = 0.5 * (T[(size_t)(j*p + r) * cap + j*p + c] + T[(size_t)(j*p + c) * cap + j*p + r]);
+                T[(size_t)(j*p + r) * cap + j*p + c] = mean;
+                T[(size_t)(j*p + c) * cap + j*p + r] = mean;
+            }
+        }
+        
+        // W = Q_j+1 R, R the subdiagonal block of T
+        lanczos_normalize(&M, V, (j + 1) * p, p, MQ, R, coef, &seed);
+        if (j + 1 < max_blocks) {
+            for (int r = 0; r < p; r++) {
+                for (int c = 0; c < p; c++) {
+                    T[(size_t)((j + 1)*p + r) * cap + j*p + c] = R[r * p + c];
+                    T[(size_t)(j*p + c) * cap + (j + 1)*p + r] = R[r * p + c];
+                }
+            }
+        }
+        m = (j + 1) * p;
+        if (m < next_check && j + 1 < max_blocks) continue;
+        next_check = m + (m / 8 > p ? m / 8 : p);
+        
+        // Ritz values theta of T, largest first. The residual of the Ritz
+        // vector V s is Q_j+1 R s_j, s_j the last block of s, so its
+        // M-norm is |R s_j|.
+        for (int r = 0; r < m; r++) memcpy(a + (size_t)r * m, T + (size_t)r * cap, m * sizeof(double));
+        jacobi_eigen(a, m, S);
+        for (int i = 0; i < m; i++) {
+            int k = i;
+            while (k > 0 && a[(size_t)order[k - 1] * m + order[k - 1]] < a[(size_t)i * m + i]) {
+                order[k] = order[k - 1];
+                k--;
+            }
+            order[k] = i;
+        }
+        converged = 0;
+        while (converged < want) {
+            int i = order[converged];
+            double theta = a[(size_t)i * m + i];
+            if (!(theta > 0.0)) break;
+            double norm = 0.0;
+            for (int r = 0; r < p; r++) {
+                double sum = 0.0;
+                for (int c = r; c < p; c++) sum += R[r * p + c] * S[(size_t)(m - p + c) * m + i];
+                norm += sum * sum;
+            }
+            ctx->modes[converged].residual = sqrt(norm) / theta;
+            if (ctx->modes[converged].residual > LANCZOS_TOL) break;
+            converged++;
+        }
+        if (converged == want) break;
+    }
+    if (status == TRUSS_OK && converged == 0) {
+        status = set_error(ctx, TRUSS_ERROR_UNSTABLE, "No mode converged in %d Lanczos vectors", m);
+    }
+    if (status != TRUSS_OK) {
+        arena_release(&ctx->scratch, mark);
+        return status;
+    }
+    if (converged < want) {
+        log_warning(ctx, "Warning: Only the lowest %d of %d modes converged in %d Lanczos vectors\n", converged, want, m);
+    }
+    
+    // Mode shapes phi = V s, each mass-normalized with its largest
+    // component positive, and the participation factors phi^T M r
+    double *phi = arena_calloc(&ctx->scratch, (size_t)converged * n, sizeof(double));
+    double *mr = arena_calloc(&ctx->scratch, (size_t)3 * n, sizeof(double));
+    double *r = arena_calloc(&ctx->scratch, n, sizeof(double));
+    if (!phi || !mr || !r) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory in the modal analysis");
+    }
+    // Rows in blocks of 1024, which stay in cache while every basis vector
+    // is added in
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < n; b += 1024) {
+        int end = b + 1024 < n ? b + 1024 : n;
+        for (int q = 0; q < converged; q++) {
+            for (int l = 0; l < m; l++) {
+                double s = S[(size_t)l * m + order[q]];
+                const double *v = V + (size_t)l * n;
+                for (int i = b; i < end; i++) phi[(size_t)q * n + i] += s * v[i];
+            }
+        }
+    }
+    double free_mass[3];
+    for (int d = 0; d < 3; d++) {
+        memset(r, 0, n * sizeof(double));
+        for (int i = d; i < ctx->total_dofs; i += 3) {
+            if (dof_map[i] >= 0) r[dof_map[i]] = 1.0;
+        }
+        sparse_multiply(&M, r, mr + (size_t)d * n);
+        free_mass[d] = 0.0;
+        for (int i = 0; i < n; i++) free_mass[d] += r[i] * mr[(size_t)d * n + i];
+    }
+    for (int q = 0; q < converged; q++) {
+        TrussMode *mode = &ctx->modes[q];
+        double *x = phi + (size_t)q * n;
+        double *shape = ctx->mode_shapes + (size_t)q * ctx->total_dofs;
+        int largest = -1;
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0 && (largest < 0 || fabs(x[dof_map[i]]) > fabs(x[dof_map[largest]]))) largest = i;
+        }
+        double sign = x[dof_map[largest]] < 0.0 ? -1.0 : 1.0;
+        for (int i = 0; i < n; i++) x[i] *= sign;
+        for (int i = 0; i < ctx->total_dofs; i++) {
+            if (dof_map[i] >= 0) shape[i] = x[dof_map[i]];
+        }
+        
+        double theta = a[(size_t)order[q] * m + order[q]];
+        mode->circular_frequency = sqrt(1.0 / theta);
+        mode->frequency = mode->circular_frequency / (2.0 * M_PI);
+        mode->period = 1.0 / mode->frequency;
+        for (int d = 0; d < 3; d++) {
+            double gamma = 0.0;
+            for (int i = 0; i < n; i++) gamma += x[i] * mr[(size_t)d * n + i];
+            mode->participation[d] = gamma;
+            mode->mass_ratio[d] = free_mass[d] > 0.0 ? gamma * gamma / free_mass[d] : 0.0;
+        }
+    }
+    ctx->n_modes = converged;
+    ctx->lanczos_vectors = m;
+    arena_release(&ctx->scratch, mark);
+    log_warning(ctx, "Modal analysis: %d mode%s, %.6g to %.6g Hz, from %d Lanczos vectors in %d block steps\n",
+                converged, converged == 1 ? "" : "s", ctx->modes[0].frequency, ctx->modes[converged - 1].frequency,
+                m, ctx->lanczos_steps);
+    return TRUSS_OK;
+}
+
+// Uniform pseudo-random values in [-1, 1) from a xorshift generator, so
+// the Lanczos start is the same on every platform
+void lanczos_random(double *x, int n, uint32_t *seed) {
+    uint32_t s = *seed;
+    for (int i = 0; i < n; i++) {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        x[i] = s / 2147483648.0 - 1.0;
+    }
+    *seed = s;
+}
+
+// Remove from w its M-components along the first n_basis columns of V
+// (M->n rows each), which are M-orthonormal or zero, by two passes of
+// classical Gram-Schmidt; the second pass takes out what rounding left
+// of the first. coef has room for 2 n_basis values, the first n_basis
+// receiving the coefficients removed, and mw is used as scratch. Returns
+// the M-norm of w as it came in. Products are summed in a fixed order,
+// so results do not depend on the thread count.
+double lanczos_orthogonalize(const SparseMatrix *M, const double *V, int n_basis, double *w, double *mw, double *coef) {
+    int n = M->n;
+    double *pass_coef = coef + n_basis;
+    double norm = 0.0;
+    for (int l = 0; l < n_basis; l++) coef[l] = 0.0;
+    for (int pass = 0; pass < 2; pass++) {
+        sparse_multiply(M, w, mw);
+        if (pass == 0) {
+            for (int i = 0; i < n; i++) norm += w[i] * mw[i];
+        }
+        #pragma omp parallel for schedule(static)
+        for (int l = 0; l < n_basis; l++) {
+            const double *v = V + (size_t)l * n;
+            double dot = 0.0;
+            for (int i = 0; i < n; i++) dot += v[i] * mw[i];
+            pass_coef[l] = dot;
+            coef[l] += dot;
+        }
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < n; b += 1024) {
+            int end = b + 1024 < n ? b + 1024 : n;
+            for (int l = 0; l < n_basis; l++) {
+                const double *v = V + (size_t)l * n;
+                double c = pass_coef[l];
+                for (int i = b; i < end; i++) w[i] -= c * v[i];
+            }
+        }
+    }
+    return sqrt(norm);
+}
+
+// M-orthonormalize the nw columns that follow the n_basis basis vectors
+// in V, against the basis and one another, as W = Q R with R upper
+// triangular (nw x nw, row-major); MQ receives M Q. A column that
+// vanishes, where the Krylov space has run into an invariant subspace,
+// is replaced by a random one with a zero in R, and stays zero if that
+// vanishes too because the basis already spans every free DOF.
+void lanczos_normalize(const SparseMatrix *M, double *V, int n_basis, int nw, double *MQ, double *R, double *coef,
+                       uint32_t *seed) {
+    int n = M->n;
+    memset(R, 0, (size_t)nw * nw * sizeof(double));
+    for (int k = 0; k < nw; k++) {
+        double *w = V + (size_t)(n_basis + k) * n;
+        double *mw = MQ + (size_t)k * n;
+        double before = lanczos_orthogonalize(M, V, n_basis + k, w, mw, coef);
+        for (int l = 0; l < k; l++) R[l * nw + k] = coef[n_basis + l];
+        
+        int replaced = 0;
+        for (;;) {
+            sparse_multiply(M, w, mw);
+            double norm = 0.0;
+            for (int i = 0; i < n; i++) norm += w[i] * mw[i];
+            norm = sqrt(norm);
+            if (norm > LANCZOS_BREAKDOWN * before) {
+                if (!replaced) R[k * nw + k] = norm;
+                for (int i = 0; i < n; i++) {
+                    w[i] /= norm;
+                    mw[i] /= norm;
+                }
+                break;
+            }
+            if (replaced) {
+                memset(w, 0, n * sizeof(double));
+                memset(mw, 0, n * sizeof(double));
+                break;
+            }
+            lanczos_random(w, n, seed);
+            before = lanczos_orthogonalize(M, V, n_basis + k, w, mw, coef);
+            replaced = 1;
+        }
+    }
+}
+
+// Eigenvalues and eigenvectors of the symmetric n x n row-major matrix
+// a by cyclic Jacobi rotations: a ends up diagonal, holding the
+// eigenvalues, and column i of vectors is the eigenvector of a[i][i]
+void jacobi_eigen(double *a, int n, double *vectors) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) vectors[(size_t)i * n + j] = i == j ? 1.0 : 0.0;
+    }
+    for (int sweep = 0; sweep < JACOBI_MAX_SWEEPS; sweep++) {
+        double off = 0.0, diagonal = 0.0;
+        for (int i = 0; i < n; i++) {
+            diagonal += a[(size_t)i * n + i] * a[(size_t)i * n + i];
+            for (int j = i + 1; j < n; j++) off += a[(size_t)i * n + j] * a[(size_t)i * n + j];
+        }
+        if (off <= DBL_EPSILON * DBL_EPSILON * diagonal) break;
+        
+        for (int p = 0; p < n; p++) {
+            for (int q = p + 1; q < n; q++) {
+                double apq = a[(size_t)p * n + q];
+                if (apq == 0.0) continue;
+                // Rotation by angle phi with tan phi = t zeroing a[p][q]
+                double theta = (a[(size_t)q * n + q] - a[(size_t)p * n + p]) / (2.0 * apq);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + hypot(theta, 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                for (int k = 0; k < n; k++) {
+                    double akp = a[(size_t)k * n + p], akq = a[(size_t)k * n + q];
+                    a[(size_t)k * n + p] = c * akp - s * akq;
+                    a[(size_t)k * n + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; k++) {
+                    double apk = a[(size_t)p * n + k], aqk = a[(size_t)q * n + k];
+                    a[(size_t)p * n + k] = c * apk - s * aqk;
+                    a[(size_t)q * n + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; k++) {
+                    double vkp = vectors[(size_t)k * n + p], vkq = vectors[(size_t)k * n + q];
+                    vectors[(size_t)k * n + p] = c * vkp - s * vkq;
+                    vectors[(size_t)k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// Parse a substructures file: MODULE[, name] sections holding node and
+// member records as in the model file, with local IDs and coordinates, a
+// BOUNDARY line and the INSTANCE lines that copy the module into the
+// model. Instances are expanded as they are read; on failure the model is
+// left as it was.
+int read_substructures(TrussContext *ctx, const char *data, size_t size) {
+    int n_model_nodes = ctx->n_nodes;
+    int n_model_members = ctx->n_members;
+    int node_capacity = ctx->n_nodes;
+    int member_capacity = ctx->n_members;
+    int module_capacity = 0;
+    int module_node_capacity = 0;
+    int module_member_capacity = 0;
+    int instance_capacity = 0;
+    int boundary_capacity = 0;
+    int n_instance_boundary = 0;
+    int *boundary_ids = NULL;       // BOUNDARY line of the current module
+    int boundary_id_capacity = 0;
+    int n_boundary_ids = -1;        // -1 before the BOUNDARY line
+    int expanding = 0;              // the current module's instances have started
+    double tolerance = 0.0;         // of boundary node positions in the current module
+    double *values = NULL;
+    int value_capacity = 0;
+    int line_number = 0;
+    int status = TRUSS_OK;
+    char *last_line = NULL;
+    const char *p = data;
+    const char *data_end = data + size;
+    
+    while (p < data_end) {
+        const char *line = p;
+        const char *eol = memchr(p, '\n', data_end - p);
+        if (eol) {
+            p = eol + 1;
+        } else {
+            // Copy the unterminated last line, as parse_chunk does
+            size_t length = data_end - line;
+            last_line = malloc(length + 1);
+            if (!last_line) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            memcpy(last_line, line, length);
+            last_line[length] = '\0';
+            line = last_line;
+            eol = last_line + length;
+            p = data_end;
+        }
+        line_number++;
+        
+        while (line < eol && isspace((unsigned char)*line)) line++;
+        const char *end = eol;
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        if (line == end || line[0] == '#') continue;
+        
+        if (match_keyword(line, end, "MODULE")) {
+            if (!grow_array(&ctx->modules, &module_capacity, ctx->n_modules + 1, sizeof(Module))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            Module *module = &ctx->modules[ctx->n_modules++];
+            memset(module, 0, sizeof(Module));
+            const char *name = memchr(line, ',', end - line);
+            if (name) {
+                name++;
+                while (name < end && isspace((unsigned char)*name)) name++;
+            }
+            if (name && name < end) {
+                snprintf(module->name, sizeof(module->name), "%.*s", (int)(end - name), name);
+            } else {
+                snprintf(module->name, sizeof(module->name), "Module %d", ctx->n_modules);
+            }
+            module->first_node = ctx->n_module_nodes;
+            module->first_member = ctx->n_module_members;
+            n_boundary_ids = -1;
+            expanding = 0;
+            continue;
+        }
+        
+        // Keyword lines have any number of values after the keyword
+        int boundary = match_keyword(line, end, "BOUNDARY");
+        int instance = match_keyword(line, end, "INSTANCE");
+        const char *fields = boundary || instance ? memchr(line, ',', end - line) : line;
+        if (fields && fields != line) fields++;
+        int n_values = fields ? parse_csv_record(fields, end, values, value_capacity) : 0;
+        if (n_values > value_capacity) {
+            if (!grow_array(&values, &value_capacity, n_values, sizeof(double))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            parse_csv_record(fields, end, values, value_capacity);
+        }
+        if (ctx->n_modules == 0 || (!boundary && !instance && n_values != 10 && n_values != 5)) {
+            log_warning(ctx, "Warning: Skipping line %d of the substructures file\n", line_number);
+            continue;
+        }
+        Module *module = &ctx->modules[ctx->n_modules - 1];
+        if (expanding && !instance) {
+            status = set_error(ctx, TRUSS_ERROR_FORMAT, "Records of module \"%s\" must come before its instances (line %d)",
+                               module->name, line_number);
+            break;
+        }
+        
+        if (boundary) {
+            if (n_boundary_ids >= 0 || n_values == 0) {
+                status = set_error(ctx, TRUSS_ERROR_FORMAT, "Module \"%s\" needs one BOUNDARY line of node IDs (line %d)",
+                                   module->name, line_number);
+                break;
+            }
+            if (!grow_array(&boundary_ids, &boundary_id_capacity, n_values, sizeof(int))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            for (int b = 0; b < n_values; b++) boundary_ids[b] = (int)values[b];
+            n_boundary_ids = n_values;
+            continue;
+        }
+        
+        if (instance) {
+            if (!expanding) {
+                if (n_boundary_ids < 0) {
+                    status = set_error(ctx, TRUSS_ERROR_FORMAT, "Module \"%s\" needs a BOUNDARY line before its instances",
+                                       module->name);
+                    break;
+                }
+                status = finish_module(ctx, module, boundary_ids, n_boundary_ids);
+                if (status != TRUSS_OK) break;
+                
+                // Boundary nodes may be off their module position by a
+                // fraction of the module's size
+                const Node *local = ctx->module_nodes + module->first_node;
+                double lower[3] = {INFINITY, INFINITY, INFINITY}, upper[3] = {-INFINITY, -INFINITY, -INFINITY};
+                for (int i = 0; i < module->n_boundary + module->n_interior; i++) {
+                    double xyz[3] = {local[i].x, local[i].y, local[i].z};
+                    for (int a = 0; a < 3; a++) {
+                        lower[a] = fmin(lower[a], xyz[a]);
+                        upper[a] = fmax(upper[a], xyz[a]);
+                    }
+                }
+                double extent = 1.0;
+                for (int a = 0; a < 3; a++) extent = fmax(extent, upper[a] - lower[a]);
+                tolerance = SUBSTRUCTURE_POSITION_TOL * extent;
+                expanding = 1;
+            }
+            int nb = module->n_boundary;
+            int ni = module->n_interior;
+            if (n_values != 4 + nb) {
+                status = set_error(ctx, TRUSS_ERROR_FORMAT, "INSTANCE of module \"%s\" on line %d needs an ID offset, "
+                                   "a shift and %d boundary node IDs", module->name, line_number, nb);
+                break;
+            }
+            if (!grow_array(&ctx->instances, &instance_capacity, ctx->n_instances + 1, sizeof(Instance)) ||
+                !grow_array(&ctx->instance_boundary, &boundary_capacity, n_instance_boundary + nb, sizeof(int)) ||
+                !grow_array(&ctx->nodes, &node_capacity, ctx->n_nodes + ni, sizeof(Node)) ||
+                !grow_array(&ctx->members, &member_capacity, ctx->n_members + module->n_members, sizeof(Member))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            
+            // ID offset, shift, then the model nodes the boundary nodes
+            // are, which must be where the shift puts them
+            int id_offset = (int)values[0];
+            const double *shift = values + 1;
+            const Node *local = ctx->module_nodes + module->first_node;
+            Instance *copy = &ctx->instances[ctx->n_instances];
+            copy->module = ctx->n_modules - 1;
+            copy->first_node = ctx->n_nodes;
+            copy->first_member = ctx->n_members;
+            copy->first_boundary = n_instance_boundary;
+            int *boundary_nodes = ctx->instance_boundary + n_instance_boundary;
+            for (int b = 0; b < nb && status == TRUSS_OK; b++) {
+                int id = (int)values[4 + b];
+                int node = find_node_index(ctx, id);
+                if (node < 0 || node >= n_model_nodes) {
+                    status = set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID %d in an instance of module \"%s\" (line %d)",
+                                       id, module->name, line_number);
+                } else if (fabs(ctx->nodes[node].x - local[b].x - shift[0]) > tolerance ||
+                           fabs(ctx->nodes[node].y - local[b].y - shift[1]) > tolerance ||
+                           fabs(ctx->nodes[node].z - local[b].z - shift[2]) > tolerance) {
+                    status = set_error(ctx, TRUSS_ERROR_INVALID, "Node %d is not where boundary node %d of module \"%s\" "
+                                       "is shifted to (line %d)", id, local[b].id, module->name, line_number);
+                }
+                boundary_nodes[b] = node;
+            }
+            if (status != TRUSS_OK) break;
+            
+            for (int q = 0; q < ni; q++) {
+                Node *node = &ctx->nodes[ctx->n_nodes++];
+                *node = local[nb + q];
+                node->id += id_offset;
+                node->x += shift[0];
+                node->y += shift[1];
+                node->z += shift[2];
+            }
+            for (int j = 0; j < module->n_members; j++) {
+                Member *m = &ctx->members[ctx->n_members++];
+                *m = ctx->module_members[module->first_member + j];
+                m->id += id_offset;
+                m->node1 = m->node1 < nb ? boundary_nodes[m->node1] : copy->first_node + m->node1 - nb;
+                m->node2 = m->node2 < nb ? boundary_nodes[m->node2] : copy->first_node + m->node2 - nb;
+            }
+            n_instance_boundary += nb;
+            ctx->n_instances++;
+            continue;
+        }
+        
+        // Module node and member records; members hold node IDs until
+        // finish_module resolves them
+        if (n_values == 10) {
+            if (!grow_array(&ctx->module_nodes, &module_node_capacity, ctx->n_module_nodes + 1, sizeof(Node))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            Node *n = &ctx->module_nodes[ctx->n_module_nodes++];
+            n->id = (int)values[0];
+            n->x = values[1];
+            n->y = values[2];
+            n->z = values[3];
+            for (int a = 0; a < 3; a++) {
+                n->constraints[a] = (int)values[4 + a];
+                n->loads[a] = values[7 + a];
+            }
+        } else {
+            if (!grow_array(&ctx->module_members, &module_member_capacity, ctx->n_module_members + 1, sizeof(Member))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+                break;
+            }
+            Member *m = &ctx->module_members[ctx->n_module_members++];
+            m->id = (int)values[0];
+            m->node1 = (int)values[1];
+            m->node2 = (int)values[2];
+            m->E = values[3];
+            m->A = values[4];
+        }
+    }
+    free(last_line);
+    free(boundary_ids);
+    free(values);
+    if (status == TRUSS_OK && ctx->n_instances == 0) {
+        status = set_error(ctx, TRUSS_ERROR_FORMAT, "No INSTANCE lines in the substructures file");
+    }
+    if (status == TRUSS_OK) {
+        int duplicate = build_node_index(ctx);
+        if (duplicate == -2) {
+            status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory indexing nodes");
+        } else if (duplicate >= 0) {
+            status = set_error(ctx, TRUSS_ERROR_INVALID, "Duplicate node ID %d", ctx->nodes[duplicate].id);
+        }
+    }
+    if (status != TRUSS_OK) {
+        ctx->n_nodes = n_model_nodes;
+        ctx->n_members = n_model_members;
+        reset_substructures(ctx);
+        build_node_index(ctx);
+        return status;
+    }
+    
+    ctx->total_dofs = 3 * ctx->n_nodes;
+    free(ctx->member_index);
+    ctx->member_index = NULL;
+    ctx->member_index_mask = 0;
+    reset_results(ctx);
+    reset_variants(ctx);
+    update_load_cases(ctx);
+    log_message(ctx, "Found %d instance%s of %d module%s, adding %d nodes and %d members\n", ctx->n_instances,
+                ctx->n_instances == 1 ? "" : "s", ctx->n_modules, ctx->n_modules == 1 ? "" : "s",
+                ctx->n_nodes - n_model_nodes, ctx->n_members - n_model_members);
+    return TRUSS_OK;
+}
+
+// Put a module's boundary nodes first, in the order of its BOUNDARY
+// line, and turn the node IDs its members refer to into local indices
+int finish_module(TrussContext *ctx, Module *module, const int *boundary_ids, int n_boundary) {
+    int n = ctx->n_module_nodes - module->first_node;
+    Node *nodes = ctx->module_nodes + module->first_node;
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *keys = arena_alloc(&ctx->scratch, (size_t)(n > 0 ? n : 1) * 2 * sizeof(int));
+    int *local = arena_alloc(&ctx->scratch, (size_t)(n > 0 ? n : 1) * sizeof(int));
+    Node *sorted = arena_alloc(&ctx->scratch, (size_t)(n > 0 ? n : 1) * sizeof(Node));
+    if (!keys || !local || !sorted) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading substructures");
+    }
+    
+    // (ID, position) pairs sorted by ID
+    for (int i = 0; i < n; i++) {
+        keys[2*i] = nodes[i].id;
+        keys[2*i + 1] = i;
+        local[i] = -1;
+    }
+    qsort(keys, n, 2 * sizeof(int), compare_ints);
+    int status = TRUSS_OK;
+    for (int i = 1; i < n && status == TRUSS_OK; i++) {
+        if (keys[2*i] == keys[2*i - 2]) {
+            status = set_error(ctx, TRUSS_ERROR_INVALID, "Duplicate node ID %d in module \"%s\"", keys[2*i], module->name);
+        }
+    }
+    for (int b = 0; b < n_boundary && status == TRUSS_OK; b++) {
+        const int *key = n > 0 ? bsearch(&boundary_ids[b], keys, n, 2 * sizeof(int), compare_ints) : NULL;
+        if (!key || local[key[1]] >= 0) {
+            status = set_error(ctx, TRUSS_ERROR_INVALID, "Invalid boundary node ID %d in module \"%s\"",
+                               boundary_ids[b], module->name);
+        } else {
+            local[key[1]] = b;
+        }
+    }
+    if (status == TRUSS_OK) {
+        int next = n_boundary;
+        for (int i = 0; i < n; i++) {
+            if (local[i] < 0) local[i] = next++;
+            sorted[local[i]] = nodes[i];
+        }
+        memcpy(nodes, sorted, n * sizeof(Node));
+        module->n_boundary = n_boundary;
+        module->n_interior = n - n_boundary;
+        module->n_members = ctx->n_module_members - module->first_member;
+    }
+    for (int j = 0; j < module->n_members && status == TRUSS_OK; j++) {
+        Member *m = &ctx->module_members[module->first_member + j];
+        const int *key1 = bsearch(&m->node1, keys, n, 2 * sizeof(int), compare_ints);
+        const int *key2 = bsearch(&m->node2, keys, n, 2 * sizeof(int), compare_ints);
+        if (!key1 || !key2) {
+            status = set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID in member %d of module \"%s\" (nodes: %d->%d)",
+                               m->id, module->name, m->node1, m->node2);
+        } else {
+            m->node1 = local[key1[1]];
+            m->node2 = local[key2[1]];
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    return status;
+}
+
+// Drop the substructures, leaving their expanded nodes and members in
+// the model as ordinary ones
+void reset_substructures(TrussContext *ctx) {
+    substructure_cache_free(&ctx->substructures);
+    free(ctx->modules);
+    free(ctx->module_nodes);
+    free(ctx->module_members);
+    free(ctx->instances);
+    free(ctx->instance_boundary);
+    ctx->modules = NULL;
+    ctx->n_modules = 0;
+    ctx->module_nodes = NULL;
+    ctx->n_module_nodes = 0;
+    ctx->module_members = NULL;
+    ctx->n_module_members = 0;
+    ctx->instances = NULL;
+    ctx->n_instances = 0;
+    ctx->instance_boundary = NULL;
+}
+
+// Drop the condensations, keeping the arena's memory for the next ones
+void substructure_cache_free(SubstructureCache *cache) {
+    Arena arena = cache->arena;
+    arena_reset(&arena);
+    memset(cache, 0, sizeof(SubstructureCache));
+    cache->arena = arena;
+}
+
+// Nonlinear and modal analyses solve the expanded model as it is
+int substructures_condensed(const TrussContext *ctx) {
+    return ctx->n_instances > 0 && ctx->condense && !ctx->nonlinear && !ctx->modal;
+}
+
+// Full DOF of boundary DOF p of an instance, node_dofs per boundary node
+int boundary_dof(const TrussContext *ctx, const Instance *instance, int p) {
+    int d = ctx->node_dofs;
+    return 3 * ctx->instance_boundary[instance->first_boundary + p / d] + p % d;
+}
+
+// Condense every instance onto its boundary, reusing the condensations
+// of an earlier factorization while all instances still match them.
+// Instances matching one computed for another share it.
+int condense_substructures(TrussContext *ctx) {
+    SubstructureCache *cache = &ctx->substructures;
+    int reuse = cache->valid && cache->node_dofs == ctx->node_dofs;
+    for (int k = 0; k < ctx->n_instances && reuse; k++) {
+        reuse = instance_matches(ctx, k, &cache->condensations[cache->instance_condensation[k]]);
+    }
+    if (reuse) {
+        cache->computed = 0;
+        return TRUSS_OK;
+    }
+    
+    substructure_cache_free(cache);
+    cache->condensations = arena_alloc(&cache->arena, ctx->n_instances * sizeof(Condensation));
+    cache->instance_condensation = arena_alloc(&cache->arena, ctx->n_instances * sizeof(int));
+    if (!cache->condensations || !cache->instance_condensation) {
+        substructure_cache_free(cache);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory condensing substructures");
+    }
+    cache->node_dofs = ctx->node_dofs;
+    for (int k = 0; k < ctx->n_instances; k++) {
+        int c = 0;
+        while (c < cache->n_condensations && !instance_matches(ctx, k, &cache->condensations[c])) c++;
+        if (c == cache->n_condensations) {
+            int status = condense_instance(ctx, k, &cache->condensations[c]);
+            if (status != TRUSS_OK) {
+                substructure_cache_free(cache);
+                return status;
+            }
+            cache->n_condensations++;
+        }
+        cache->instance_condensation[k] = c;
+        cache->condensed_dofs += cache->condensations[c].n_interior;
+    }
+    cache->computed = cache->n_condensations;
+    cache->valid = 1;
+    return TRUSS_OK;
+}
+
+// Whether the condensation of instance k would equal cond: the same
+// module with the same free interior DOFs, and members of the same
+// stiffness along the same directions
+int instance_matches(const TrussContext *ctx, int k, const Condensation *cond) {
+    const Instance *instance = &ctx->instances[k];
+    const Module *module = &ctx->modules[instance->module];
+    if (instance->module != cond->module) return 0;
+    const MemberGeometry *g = ctx->member_geometry;
+    for (int j = 0; j < module->n_members; j++) {
+        int m = instance->first_member + j;
+        if (fabs(g->stiffness[m] - cond->stiffness[j]) > SUBSTRUCTURE_MATCH_TOL * fabs(cond->stiffness[j])) return 0;
+        for (int a = 0; a < 3; a++) {
+            if (fabs(g->cos[a][m] - cond->cosines[3*j + a]) > SUBSTRUCTURE_MATCH_TOL) return 0;
+        }
+    }
+    int n = 0;
+    for (int q = 0; q < module->n_interior; q++) {
+        const Node *node = &ctx->nodes[instance->first_node + q];
+        for (int a = 0; a < ctx->node_dofs; a++) {
+            if (node->constraints[a]) continue;
+            if (n == cond->n_interior || cond->interior_dofs[n] != 3*q + a) return 0;
+            n++;
+        }
+    }
+    return n == cond->n_interior;
+}
+
+// Statically condense instance k into cond, allocated from the
+// substructure cache's arena: factor K_ii, solve for X and form S
+int condense_instance(TrussContext *ctx, int k, Condensation *cond) {
+    const Instance *instance = &ctx->instances[k];
+    const Module *module = &ctx->modules[instance->module];
+    const MemberGeometry *g = ctx->member_geometry;
+    Arena *arena = &ctx->substructures.arena;
+    int d = ctx->node_dofs;
+    int nb = module->n_boundary;
+    int nbd = d * nb;
+    
+    // Free interior DOFs, numbered in node order
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *interior_index = arena_alloc(&ctx->scratch, (size_t)(3 * module->n_interior + 1) * sizeof(int));
+    cond->interior_dofs = arena_alloc(arena, (size_t)(3 * module->n_interior + 1) * sizeof(int));
+    if (!interior_index || !cond->interior_dofs) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory condensing substructures");
+    }
+    int ni = 0;
+    for (int q = 0; q < module->n_interior; q++) {
+        const Node *node = &ctx->nodes[instance->first_node + q];
+        for (int a = 0; a < 3; a++) {
+            interior_index[3*q + a] = -1;
+            if (a < d && !node->constraints[a]) {
+                interior_index[3*q + a] = ni;
+                cond->interior_dofs[ni++] = 3*q + a;
+            }
+        }
+    }
+    cond->module = instance->module;
+    cond->n_interior = ni;
+    cond->n_boundary = nbd;
+    cond->factor.n = ni;
+    cond->factor.ld = (ni + 7) / 8 * 8;
+    cond->factor.a = arena_calloc(arena, (size_t)(ni > 0 ? ni : 1) * cond->factor.ld, sizeof(double));
+    cond->coupling = arena_calloc(arena, (size_t)ni * nbd + 1, sizeof(double));
+    cond->schur = arena_calloc(arena, (size_t)nbd * nbd + 1, sizeof(double));
+    cond->stiffness = arena_alloc(arena, (module->n_members + 1) * sizeof(double));
+    cond->cosines = arena_alloc(arena, (3 * module->n_members + 1) * sizeof(double));
+    double *K_ib = arena_alloc(&ctx->scratch, ((size_t)ni * nbd + 1) * sizeof(double));
+    if (!cond->factor.a || !cond->coupling || !cond->schur || !cond->stiffness || !cond->cosines || !K_ib) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory condensing substructures");
+    }
+    
+    // Lower triangle of K_ii and all of K_ib from the k c c^T blocks of
+    // the members; their boundary-boundary blocks are in K_global
+    for (int j = 0; j < module->n_members; j++) {
+        const Member *member = &ctx->module_members[module->first_member + j];
+        int m = instance->first_member + j;
+        cond->stiffness[j] = g->stiffness[m];
+        for (int a = 0; a < 3; a++) cond->cosines[3*j + a] = g->cos[a][m];
+        int ends[2] = {member->node1, member->node2};
+        for (int e = 0; e < 2; e++) {
+            if (ends[e] < nb) continue;
+            for (int f = 0; f < 2; f++) {
+                double k = e == f ? g->stiffness[m] : -g->stiffness[m];
+                for (int a = 0; a < d; a++) {
+                    int i = interior_index[3 * (ends[e] - nb) + a];
+                    if (i < 0) continue;
+                    for (int b = 0; b < d; b++) {
+                        double value = k * g->cos[a][m] * g->cos[b][m];
+                        if (ends[f] < nb) {
+                            cond->coupling[(size_t)(d * ends[f] + b) * ni + i] += value;
+                        } else {
+                            int col = interior_index[3 * (ends[f] - nb) + b];
+                            if (col >= 0 && col <= i) cond->factor.a[(size_t)i * cond->factor.ld + col] += value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    if (ni > 0) {
+        int failed = dense_cholesky(&cond->factor, NULL, &ctx->scratch);
+        if (failed == CHOLESKY_OUT_OF_MEMORY) {
+            arena_release(&ctx->scratch, mark);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory condensing substructures");
+        }
+        if (failed >= 0) {
+            int dof = cond->interior_dofs[failed];
+            const char *dir[3] = {"X", "Y", "Z"};
+            arena_release(&ctx->scratch, mark);
+            return set_error(ctx, TRUSS_ERROR_UNSTABLE, "Substructure \"%s\" is unstable - its interior stiffness "
+                             "is singular at node %d (%s direction)", module->name,
+                             ctx->nodes[instance->first_node + dof / 3].id, dir[dof % 3]);
+        }
+        
+        // X = K_ii^-1 K_ib, S = -K_ib^T X
+        memcpy(K_ib, cond->coupling, (size_t)ni * nbd * sizeof(double));
+        if (dense_cholesky_solve(&cond->factor, cond->coupling, nbd, &ctx->scratch) != 0) {
+            arena_release(&ctx->scratch, mark);
+            return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory condensing substructures");
+        }
+        for (int p = 0; p < nbd; p++) {
+            for (int q = 0; q < nbd; q++) {
+                double sum = 0.0;
+                for (int i = 0; i < ni; i++) sum += K_ib[(size_t)p * ni + i] * cond->coupling[(size_t)q * ni + i];
+                cond->schur[(size_t)p * nbd + q] = -sum;
+            }
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    return TRUSS_OK;
+}
+
+// Add the super-element of every instance to the reduced stiffness,
+// whose pattern has the boundary nodes of each instance coupled
+void add_super_elements(TrussContext *ctx, SparseMatrix *K_free) {
+    const SubstructureCache *cache = &ctx->substructures;
+    const int *dof_map = ctx->solver.dof_map;
+    for (int k = 0; k < ctx->n_instances; k++) {
+        const Instance *instance = &ctx->instances[k];
+        const Condensation *cond = &cache->condensations[cache->instance_condensation[k]];
+        int nbd = cond->n_boundary;
+        for (int p = 0; p < nbd; p++) {
+            int row = dof_map[boundary_dof(ctx, instance, p)];
+            if (row < 0) continue;
+            for (int q = 0; q < nbd; q++) {
+                int col = dof_map[boundary_dof(ctx, instance, q)];
+                if (col < 0) continue;
+                int lo = K_free->row_ptr[row], hi = K_free->row_ptr[row + 1] - 1;
+                while (lo < hi) {
+                    int mid = (lo + hi) / 2;
+                    if (K_free->col_idx[mid] < col) lo = mid + 1;
+                    else hi = mid;
+                }
+                K_free->values[lo] += cond->schur[(size_t)p * nbd + q];
+            }
+        }
+    }
+}
+
+// Carry the loads on every instance's interior to its boundary:
+// F_b -= X^T F_i for the nrhs columns of F_reduced
+void condense_loads(TrussContext *ctx, double *F_reduced, int nrhs) {
+    const SubstructureCache *cache = &ctx->substructures;
+    const int *dof_map = ctx->solver.dof_map;
+    int n_free = ctx->solver.n_free;
+    for (int k = 0; k < ctx->n_instances; k++) {
+        const Instance *instance = &ctx->instances[k];
+        const Condensation *cond = &cache->condensations[cache->instance_condensation[k]];
+        int ni = cond->n_interior;
+        for (int q = 0; q < cond->n_boundary; q++) {
+            int row = dof_map[boundary_dof(ctx, instance, q)];
+            if (row < 0) continue;
+            const double *x = cond->coupling + (size_t)q * ni;
+            for (int c = 0; c < nrhs; c++) {
+                const double *F = ctx->F_global + (size_t)c * ctx->total_dofs + 3 * instance->first_node;
+                double sum = 0.0;
+                for (int i = 0; i < ni; i++) sum += x[i] * F[cond->interior_dofs[i]];
+                F_reduced[(size_t)c * n_free + row] -= sum;
+            }
+        }
+    }
+}
+
+// Interior displacements of every instance from its boundary ones,
+// u_i = K_ii^-1 F_i - X u_b. Instances sharing a condensation are solved
+// together, enough of them at a time to fill a SOLVE_BLOCK_RHS block of
+// right-hand sides, and the groups run in parallel. Each instance only
+// writes its own interior DOFs, so results do not depend on the threads.
+int recover_interiors(TrussContext *ctx) {
+    const SubstructureCache *cache = &ctx->substructures;
+    int nrhs = ctx->n_load_cases;
+    int group_size = SOLVE_BLOCK_RHS / nrhs > 1 ? SOLVE_BLOCK_RHS / nrhs : 1;
+    int max_ni = 1;
+    for (int c = 0; c < cache->n_condensations; c++) {
+        if (cache->condensations[c].n_interior > max_ni) max_ni = cache->condensations[c].n_interior;
+    }
+    
+    // Instances ordered by condensation, and groups of them sharing one
+    int n = ctx->n_instances;
+    int n_threads = profile_threads(ctx);
+    size_t work_size = (size_t)max_ni * (group_size * nrhs + SOLVE_BLOCK_RHS);
+    ArenaMark mark = arena_mark(&ctx->scratch);
+    int *order = arena_alloc(&ctx->scratch, n * sizeof(int));
+    int *group_start = arena_alloc(&ctx->scratch, (n + 1) * sizeof(int));
+    int *position = arena_calloc(&ctx->scratch, cache->n_condensations + 1, sizeof(int));
+    double *work = arena_alloc(&ctx->scratch, work_size * n_threads * sizeof(double));
+    if (!order || !group_start || !position || !work) {
+        arena_release(&ctx->scratch, mark);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory recovering substructure interiors");
+    }
+    for (int k = 0; k < n; k++) position[cache->instance_condensation[k] + 1]++;
+    for (int c = 0; c < cache->n_condensations; c++) position[c + 1] += position[c];
+    for (int k = 0; k < n; k++) order[position[cache->instance_condensation[k]]++] = k;
+    int n_groups = 0;
+    for (int p = 0; p < n; p++) {
+        int c = cache->instance_condensation[order[p]];
+        if (p == 0 || p - group_start[n_groups - 1] == group_size ||
+            c != cache->instance_condensation[order[group_start[n_groups - 1]]]) {
+            group_start[n_groups++] = p;
+        }
+    }
+    group_start[n_groups] = n;
+    
+    #pragma omp parallel num_threads(n_threads)
+    {
+        int self = 0;
+#ifdef _OPENMP
+        self = omp_get_thread_num();
+#endif
+        double *U = work + work_size * self;
+        double *X = U + (size_t)max_ni * group_size * nrhs;
+        #pragma omp for schedule(dynamic, 1)
+        for (int g = 0; g < n_groups; g++) {
+            int count = group_start[g + 1] - group_start[g];
+            const int *members = order + group_start[g];
+            const Condensation *cond = &cache->condensations[cache->instance_condensation[members[0]]];
+            int ni = cond->n_interior;
+            if (ni == 0) continue;
+            for (int e = 0; e < count; e++) {
+                const Instance *instance = &ctx->instances[members[e]];
+                for (int c = 0; c < nrhs; c++) {
+                    const double *F = ctx->F_global + (size_t)c * ctx->total_dofs + 3 * instance->first_node;
+                    double *u = U + (size_t)(e * nrhs + c) * ni;
+                    for (int i = 0; i < ni; i++) u[i] = F[cond->interior_dofs[i]];
+                }
+            }
+            dense_solve_columns(&cond->factor, U, count * nrhs, X);
+            for (int e = 0; e < count; e++) {
+                const Instance *instance = &ctx->instances[members[e]];
+                for (int c = 0; c < nrhs; c++) {
+                    double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+                    double *u = U + (size_t)(e * nrhs + c) * ni;
+                    for (int q = 0; q < cond->n_boundary; q++) {
+                        double u_b = D[boundary_dof(ctx, instance, q)];
+                        if (u_b == 0.0) continue;
+                        const double *x = cond->coupling + (size_t)q * ni;
+                        for (int i = 0; i < ni; i++) u[i] -= x[i] * u_b;
+                    }
+                    for (int i = 0; i < ni; i++) D[3 * instance->first_node + cond->interior_dofs[i]] = u[i];
+                }
+            }
+        }
+    }
+    arena_release(&ctx->scratch, mark);
+    return TRUSS_OK;
+}
+
+// Parse a variants file: VARIANT[, name] headers, each followed by
+// override records. Node and member IDs are resolved against the loaded
+// model here, so workers apply overrides by index.
+int read_variants(TrussContext *ctx, const char *data, size_t size) {
+    static const struct {
+        const char *keyword;
+        OverrideKind kind;
+        int n_values;
+    } records[3] = {
+        {"NODE", OVERRIDE_NODE, 4},
+        {"MEMBER", OVERRIDE_MEMBER, 3},
+        {"LOAD", OVERRIDE_LOAD, 4}
+    };
+    int variant_capacity = 0;
+    int override_capacity = 0;
+    int line_number = 0;
+    int status = TRUSS_OK;
+    char *last_line = NULL;
+    const char *p = data;
+    const char *data_end = data + size;
+    
+    while (p < data_end) {
+        const char *line = p;
+        const char *eol = memchr(p, '\n', data_end - p);
+        if (eol) {
+            p = eol + 1;
+        } else {
+            // Copy the unterminated last line, as parse_chunk does
+            size_t length = data_end - line;
+            last_line = malloc(length + 1);
+            if (!last_line) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading variants");
+                break;
+            }
+            memcpy(last_line, line, length);
+            last_line[length] = '\0';
+            line = last_line;
+            eol = last_line + length;
+            p = data_end;
+        }
+        line_number++;
+        
+        while (line < eol && isspace((unsigned char)*line)) line++;
+        const char *end = eol;
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        if (line == end || line[0] == '#') continue;
+        
+        if (match_keyword(line, end, "VARIANT")) {
+            if (!grow_array(&ctx->variants, &variant_capacity, ctx->n_variants + 1, sizeof(Variant))) {
+                status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading variants");
+                break;
+            }
+            Variant *v = &ctx->variants[ctx->n_variants++];
+            const char *name = memchr(line, ',', end - line);
+            if (name) {
+                name++;
+                while (name < end && isspace((unsigned char)*name)) name++;
+            }
+            if (name && name < end) {
+                snprintf(v->name, sizeof(v->name), "%.*s", (int)(end - name), name);
+            } else {
+                snprintf(v->name, sizeof(v->name), "Variant %d", ctx->n_variants);
+            }
+            v->first = ctx->n_overrides;
+            v->n_overrides = 0;
+            v->moves_nodes = 0;
+            v->n_member_overrides = 0;
+            continue;
+        }
+        
+        int r = 0;
+        while (r < 3 && !match_keyword(line, end, records[r].keyword)) r++;
+        const char *fields = r < 3 ? memchr(line, ',', end - line) : NULL;
+        double values[4];
+        int n_values = fields ? parse_csv_record(fields + 1, end, values, 4) : 0;
+        if (!fields || n_values != records[r].n_values || ctx->n_variants == 0) {
+            log_warning(ctx, "Warning: Skipping line %d of the variants file\n", line_number);
+            continue;
+        }
+        
+        Variant *v = &ctx->variants[ctx->n_variants - 1];
+        int id = (int)values[0];
+        int target = records[r].kind == OVERRIDE_MEMBER ? find_member_index(ctx, id) : find_node_index(ctx, id);
+        if (target < 0) {
+            status = set_error(ctx, TRUSS_ERROR_INVALID, "Invalid %s ID %d in variant \"%s\"",
+                               records[r].kind == OVERRIDE_MEMBER ? "member" : "node", id, v->name);
+            break;
+        }
+        if (!grow_array(&ctx->overrides, &override_capacity, ctx->n_overrides + 1, sizeof(VariantOverride))) {
+            status = set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory reading variants");
+            break;
+        }
+        VariantOverride *o = &ctx->overrides[ctx->n_overrides++];
+        o->kind = records[r].kind;
+        o->target = target;
+        o->values[0] = values[1];
+        o->values[1] = values[2];
+        o->values[2] = n_values == 4 ? values[3] : 0.0;
+        v->n_overrides++;
+        if (o->kind == OVERRIDE_NODE) v->moves_nodes = 1;
+        if (o->kind == OVERRIDE_MEMBER) v->n_member_overrides++;
+    }
+    free(last_line);
+    if (status == TRUSS_OK && ctx->n_variants == 0) {
+        status = set_error(ctx, TRUSS_ERROR_FORMAT, "No VARIANT sections in the variants file");
+    }
+    if (status == TRUSS_OK) {
+        log_message(ctx, "Found %d variants with %d overrides\n", ctx->n_variants, ctx->n_overrides);
+    }
+    return status;
+}
+
+void reset_variant_results(TrussContext *ctx) {
+    if (ctx->variant_errors) {
+        for (int v = 0; v < ctx->n_variants; v++) free(ctx->variant_errors[v]);
+    }
+    free(ctx->variant_summaries);
+    free(ctx->variant_errors);
+    ctx->variant_summaries = NULL;
+    ctx->variant_errors = NULL;
+}
+
+void reset_variants(TrussContext *ctx) {
+    reset_variant_results(ctx);
+    free(ctx->variants);
+    free(ctx->overrides);
+    ctx->variants = NULL;
+    ctx->n_variants = 0;
+    ctx->overrides = NULL;
+    ctx->n_overrides = 0;
+}
+
+// Copy the options and model of src into the empty context dst. The
+// copy has no node index, so it is only changed by index.
+int copy_model(TrussContext *dst, const TrussContext *src) {
+    dst->solver_type = src->solver_type;
+    dst->preconditioner = src->preconditioner;
+    dst->pcg_tolerance = src->pcg_tolerance;
+    dst->pcg_max_iterations = src->pcg_max_iterations;
+    dst->reorder = src->reorder;
+    dst->mixed_precision = src->mixed_precision;
+    dst->nonlinear = src->nonlinear;
+    dst->load_steps = src->load_steps;
+    dst->modified_newton = src->modified_newton;
+    dst->line_search = src->line_search;
+    dst->newton_tolerance = src->newton_tolerance;
+    dst->newton_max_iterations = src->newton_max_iterations;
+    dst->modal = src->modal;
+    dst->requested_modes = src->requested_modes;
+    dst->consistent_mass = src->consistent_mass;
+    dst->density = src->density;
+    dst->condense = src->condense;
+    dst->memory_budget = src->memory_budget;
+    memcpy(dst->scratch_dir, src->scratch_dir, sizeof(dst->scratch_dir));
+    dst->decimal_places = src->decimal_places;
+    
+    dst->nodes = malloc((src->n_nodes > 0 ? src->n_nodes : 1) * sizeof(Node));
+    dst->members = malloc((src->n_members > 0 ? src->n_members : 1) * sizeof(Member));
+    dst->load_cases = malloc((src->n_load_cases + 1) * sizeof(LoadCase));
+    dst->case_loads = malloc((src->n_case_loads + 1) * sizeof(NodeLoad));
+    if (!dst->nodes || !dst->members || !dst->load_cases || !dst->case_loads) {
+        reset_model(dst);
+        return set_error(dst, TRUSS_ERROR_MEMORY, "Out of memory copying the model");
+    }
+    memcpy(dst->nodes, src->nodes, src->n_nodes * sizeof(Node));
+    memcpy(dst->members, src->members, src->n_members * sizeof(Member));
+    memcpy(dst->load_cases, src->load_cases, src->n_load_cases * sizeof(LoadCase));
+    memcpy(dst->case_loads, src->case_loads, src->n_case_loads * sizeof(NodeLoad));
+    dst->n_nodes = src->n_nodes;
+    dst->n_members = src->n_members;
+    dst->total_dofs = src->total_dofs;
+    dst->n_load_cases = src->n_load_cases;
+    dst->node_loads_case = src->node_loads_case;
+    dst->n_case_loads = src->n_case_loads;
+    return TRUSS_OK;
+}
+
+// Apply a variant's overrides to ctx, a copy of base, or with restore
+// put back the base values they replaced. Returns 1 if nodes moved;
+// the caller then updates the member geometry.
+int apply_overrides(TrussContext *ctx, const TrussContext *base, const Variant *variant, int restore) {
+    int moved = 0;
+    for (int k = variant->first; k < variant->first + variant->n_overrides; k++) {
+        const VariantOverride *o = &base->overrides[k];
+        if (o->kind == OVERRIDE_NODE) {
+            Node *n = &ctx->nodes[o->target];
+            const Node *b = &base->nodes[o->target];
+            n->x = restore ? b->x : o->values[0];
+            n->y = restore ? b->y : o->values[1];
+            n->z = restore ? b->z : o->values[2];
+            moved = 1;
+        } else if (o->kind == OVERRIDE_MEMBER) {
+            const Member *b = &base->members[o->target];
+            set_member_properties(ctx, o->target, restore ? b->E : o->values[0], restore ? b->A : o->values[1]);
+        } else {
+            memcpy(ctx->nodes[o->target].loads, restore ? base->nodes[o->target].loads : o->values,
+                   sizeof(ctx->nodes[o->target].loads));
+        }
+    }
+    return moved;
+}
+
+// Analyze variant v of ctx on a worker. Variants that change loads and
+// at most LOW_RANK_MAX_MEMBERS members are solved against the worker's
+// factorization of the base model; the others (moved nodes, many
+// members, PCG) are factored on their own. Which way a variant goes
+// depends only on the variant, and K_global is assembled afresh before
+// every factorization rather than carrying the round-off of earlier
+// in-place updates, so results do not depend on which worker ran a
+// variant or on what it ran before.
+void analyze_variant(TrussContext *ctx, BatchWorker *worker, int v) {
+    TrussContext *w = worker->ctx;
+    const Variant *variant = &ctx->variants[v];
+    TrussVariantSummary *summary = &ctx->variant_summaries[v];
+    int direct = variant->moves_nodes || variant->n_member_overrides > LOW_RANK_MAX_MEMBERS ||
+                 ctx->solver_type == SOLVER_PCG || ctx->nonlinear || worker->base_unstable;
+    
+    int moved = worker->applied >= 0 && apply_overrides(w, ctx, &ctx->variants[worker->applied], 1);
+    worker->applied = -1;
+    if (!direct && !worker->base_factored) {
+        int status = w->member_geometry ? update_member_geometry(w) : assemble_global_stiffness(w);
+        moved = 0;
+        if (status == TRUSS_OK && factor_stiffness(w) == TRUSS_OK) {
+            worker->base_factored = 1;
+        } else {
+            worker->base_unstable = 1;
+            direct = 1;
+        }
+    }
+    
+    moved |= apply_overrides(w, ctx, variant, 0);
+    worker->applied = v;
+    // A reassembly that runs out of memory leaves no stiffness, and
+    // truss_solve then reports the failure
+    if ((moved || direct) && w->member_geometry) update_member_geometry(w);
+    if (direct) worker->base_factored = 0;
+    update_load_cases(w);
+    
+    summary->status = truss_solve(w);
+    if (!direct && worker->base_factored) {
+        // An update too close to singular refactors the variant itself
+        worker->base_factored = w->solver.valid;
+        for (int k = variant->first; k < variant->first + variant->n_overrides && worker->base_factored; k++) {
+            int m = ctx->overrides[k].target;
+            if (ctx->overrides[k].kind == OVERRIDE_MEMBER &&
+                w->solver.factored_stiffness[m] != ctx->members[m].E * ctx->members[m].A / w->member_geometry->length[m]) {
+                worker->base_factored = 0;
+            }
+        }
+    }
+    
+    summary->displacement_case = -1;
+    summary->stress_case = -1;
+    if (summary->status == TRUSS_OK) {
+        summarize_variant(w, summary);
+    } else {
+        size_t length = strlen(w->error);
+        ctx->variant_errors[v] = malloc(length + 1);
+        if (ctx->variant_errors[v]) memcpy(ctx->variant_errors[v], w->error, length + 1);
+    }
+}
+
+// Largest displacement magnitude and largest stress over every load case
+void summarize_variant(const TrussContext *ctx, TrussVariantSummary *summary) {
+    for (int c = 0; c < ctx->n_load_cases; c++) {
+        const double *D = ctx->displacements + (size_t)c * ctx->total_dofs;
+        for (int i = 0; i < ctx->n_nodes; i++) {
+            double magnitude = sqrt(D[3*i]*D[3*i] + D[3*i+1]*D[3*i+1] + D[3*i+2]*D[3*i+2]);
+            if (magnitude > summary->max_displacement || summary->displacement_case < 0) {
+                summary->max_displacement = magnitude;
+                summary->node = ctx->nodes[i].id;
+                summary->displacement_case = c;
+            }
+        }
+        const MemberResult *results = ctx->member_results + (size_t)c * ctx->n_members;
+        for (int m = 0; m < ctx->n_members; m++) {
+            if (fabs(results[m].stress) > fabs(summary->max_stress) || summary->stress_case < 0) {
+                summary->max_stress = results[m].stress;
+                summary->member = ctx->members[m].id;
+                summary->stress_case = c;
+            }
+        }
+    }
+}
+
+void queue_lock(VariantQueue *queue) {
+#ifdef _OPENMP
+    omp_set_lock(&queue->lock);
+#else
+    (void)queue;
+#endif
+}
+
+void queue_unlock(VariantQueue *queue) {
+#ifdef _OPENMP
+    omp_unset_lock(&queue->lock);
+#else
+    (void)queue;
+#endif
+}
+
+// Next variant for worker self: the head of its own queue or, once that
+// is empty, the back half of the fullest other queue is moved over
+// first. Returns -1 when every queue is empty; no work is added during a
+// batch, so there is then nothing left to wait for.
+int take_variant(VariantQueue *queues, int n_workers, int self) {
+    VariantQueue *own = &queues[self];
+    while (1) {
+        int v = -1;
+        queue_lock(own);
+        if (own->head < own->tail) v = own->head++;
+        queue_unlock(own);
+        if (v >= 0) return v;
+        
+        int victim = -1;
+        int most = 0;
+        for (int k = 0; k < n_workers; k++) {
+            if (k == self) continue;
+            queue_lock(&queues[k]);
+            int remaining = queues[k].tail - queues[k].head;
+            queue_unlock(&queues[k]);
+            if (remaining > most) {
+                most = remaining;
+                victim = k;
+            }
+        }
+        if (victim < 0) return -1;
+        
+        queue_lock(&queues[victim]);
+        int tail = queues[victim].tail;
+        int stolen = (tail - queues[victim].head + 1) / 2;
+        queues[victim].tail -= stolen;
+        queue_unlock(&queues[victim]);
+        if (stolen > 0) {
+            queue_lock(own);
+            own->head = tail - stolen;
+            own->tail = tail;
+            queue_unlock(own);
+        }
+    }
+}
+
+const char *variant_status_name(int status) {
+    if (status == TRUSS_OK) return "OK";
+    if (status == TRUSS_ERROR_UNSTABLE) return "Unstable";
+    return "Failed";
+}
+
+int write_variant_summary(TrussContext *ctx, const char *filename, OutputFormat format) {
+    FILE *file = stdout;
+    if (filename) {
+        file = fopen(filename, "w");
+        if (!file) {
+            return set_error(ctx, TRUSS_ERROR_IO, "Cannot open output file %s: %s", filename, strerror(errno));
+        }
+    } else {
+        fflush(stdout);
+    }
+    OutputBuffer out;
+    output_open(&out, file);
+    if (format == FORMAT_CSV || format == FORMAT_TSV) {
+        write_variant_delimited(ctx, &out, format == FORMAT_CSV ? ',' : '\t');
+    } else {
+        write_variant_table(ctx, &out);
+    }
+    int ok = output_close(&out);
+    if (filename) {
+        if (fclose(file) != 0) ok = 0;
+    } else {
+        fflush(stdout);
+    }
+    if (!ok) {
+        return set_error(ctx, TRUSS_ERROR_IO, "Could not write the variant summary to %s",
+                         filename ? filename : "standard output");
+    }
+    if (filename) log_message(ctx, "Variant summary written to %s\n", filename);
+    return TRUSS_OK;
+}
+
+// One table row per variant; variants that failed show only their status
+void write_variant_table(TrussContext *ctx, OutputBuffer *out) {
+    static const char *headers[8] = {
+        "Variant", "Status", "Max Disp (in)", "Node", "Case", "Max Stress (ksi)", "Member", "Case"
+    };
+    char buffer[400];
+    int widths[8];
+    ColumnWidth columns[2];
+    
+    for (int j = 0; j < 8; j++) widths[j] = strlen(headers[j]);
+    column_init(&columns[0], headers[2]);
+    column_init(&columns[1], headers[5]);
+    for (int v = 0; v < ctx->n_variants; v++) {
+        const TrussVariantSummary *s = &ctx->variant_summaries[v];
+        int w = strlen(ctx->variants[v].name);
+        if (w > widths[0]) widths[0] = w;
+        w = strlen(variant_status_name(s->status));
+        if (w > widths[1]) widths[1] = w;
+        if (s->displacement_case >= 0) {
+            column_add(ctx, &columns[0], s->max_displacement);
+            if ((w = int_width(s->node)) > widths[3]) widths[3] = w;
+            if ((w = int_width(s->displacement_case + 1)) > widths[4]) widths[4] = w;
+        }
+        if (s->stress_case >= 0) {
+            column_add(ctx, &columns[1], s->max_stress);
+            if ((w = int_width(s->member)) > widths[6]) widths[6] = w;
+            if ((w = int_width(s->stress_case + 1)) > widths[7]) widths[7] = w;
+        }
+    }
+    widths[2] = column_width(ctx, &columns[0]);
+    widths[5] = column_width(ctx, &columns[1]);
+    
+    output_string(out, "\nVARIANT SUMMARY:\n");
+    output_border(out, widths, 8);
+    output_string(out, "|");
+    for (int j = 0; j < 8; j++) output_cell(out, headers[j], strlen(headers[j]), widths[j], 0);
+    output_string(out, "\n");
+    output_border(out, widths, 8);
+    for (int v = 0; v < ctx->n_variants; v++) {
+        const TrussVariantSummary *s = &ctx->variant_summaries[v];
+        const char *status = variant_status_name(s->status);
+        output_string(out, "|");
+        output_cell(out, ctx->variants[v].name, strlen(ctx->variants[v].name), widths[0], 0);
+        output_cell(out, status, strlen(status), widths[1], 0);
+        if (s->displacement_case >= 0) {
+            output_number_cell(ctx, out, s->max_displacement, widths[2]);
+            output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", s->node), widths[3], 1);
+            output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", s->displacement_case + 1), widths[4], 1);
+        } else {
+            for (int j = 2; j < 5; j++) output_cell(out, "", 0, widths[j], 0);
+        }
+        if (s->stress_case >= 0) {
+            output_number_cell(ctx, out, s->max_stress, widths[5]);
+            output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", s->member), widths[6], 1);
+            output_cell(out, buffer, snprintf(buffer, sizeof(buffer), "%d", s->stress_case + 1), widths[7], 1);
+        } else {
+            for (int j = 5; j < 8; j++) output_cell(out, "", 0, widths[j], 0);
+        }
+        output_string(out, "\n");
+    }
+    output_border(out, widths, 8);
+}
+
+// Header row and one full-precision row per variant; fields of variants
+// that failed are left empty
+void write_variant_delimited(TrussContext *ctx, OutputBuffer *out, char separator) {
+    char buffer[128];
+    int length;
+    const char *sep = separator == ',' ? "," : "\t";
+    
+    length = snprintf(buffer, sizeof(buffer),
+                      "variant%sname%sstatus%smax_displacement%snode%sdisplacement_case%smax_stress%smember%sstress_case\n",
+                      sep, sep, sep, sep, sep, sep, sep, sep);
+    output_text(out, buffer, length);
+    for (int v = 0; v < ctx->n_variants; v++) {
+        const TrussVariantSummary *s = &ctx->variant_summaries[v];
+        length = snprintf(buffer, sizeof(buffer), "%d%s", v + 1, sep);
+        output_text(out, buffer, length);
+        output_delimited_name(out, ctx->variants[v].name, separator);
+        length = snprintf(buffer, sizeof(buffer), "%s%s", sep, variant_status_name(s->status));
+        output_text(out, buffer, length);
+        if (s->displacement_case >= 0) {
+            output_delimited_number(out, s->max_displacement, separator);
+            length = snprintf(buffer, sizeof(buffer), "%s%d%s%d", sep, s->node, sep, s->displacement_case + 1);
+        } else {
+            length = snprintf(buffer, sizeof(buffer), "%s%s%s", sep, sep, sep);
+        }
+        output_text(out, buffer, length);
+        if (s->stress_case >= 0) {
+            output_delimited_number(out, s->max_stress, separator);
+            length = snprintf(buffer, sizeof(buffer), "%s%d%s%d", sep, s->member, sep, s->stress_case + 1);
+        } else {
+            length = snprintf(buffer, sizeof(buffer), "%s%s%s", sep, sep, sep);
+        }
+        output_text(out, buffer, length);
+        output_string(out, "\n");
+    }
+}
+
+// Record an error message on the context and return its status code
+int set_error(TrussContext *ctx, int code, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(ctx->error, sizeof(ctx->error), format, args);
+    va_end(args);
+    return code;
+}
+
+void log_message(TrussContext *ctx, const char *format, ...) {
+    if (!ctx->log_stream) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(ctx->log_stream, format, args);
+    va_end(args);
+}
+
+void log_warning(TrussContext *ctx, const char *format, ...) {
+    if (!ctx->diag_stream) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(ctx->diag_stream, format, args);
+    va_end(args);
+}
+
+// Library interface
+
+TrussContext *truss_create(void) {
+    TrussContext *ctx = calloc(1, sizeof(TrussContext));
+    if (!ctx) return NULL;
+    ctx->solver_type = SOLVER_AUTO;
+    ctx->preconditioner = PRECOND_BLOCK_JACOBI;
+    ctx->pcg_tolerance = 1e-10;
+    ctx->decimal_places = 6;
+    ctx->node_loads_case = -1;
+    ctx->reorder = 1;
+    ctx->load_steps = 10;
+    ctx->newton_tolerance = 1e-8;
+    ctx->newton_max_iterations = 25;
+    ctx->requested_modes = 10;
+    ctx->condense = 1;
+    return ctx;
+}
+
+void truss_destroy(TrussContext *ctx) {
+    if (!ctx) return;
+    reset_model(ctx);
+    arena_free(&ctx->solver.arena);
+    arena_free(&ctx->substructures.arena);
+    arena_free(&ctx->model_arena);
+    arena_free(&ctx->solve_arena);
+    arena_free(&ctx->scratch);
+    free(ctx);
+}
+
+const char *truss_error_message(const TrussContext *ctx) {
+    return ctx ? ctx->error : "No context";
+}
+
+int truss_set_option(TrussContext *ctx, const char *name, const char *value) {
+    if (strcmp(name, "solver") == 0) {
+        if (strcmp(value, "auto") == 0) ctx->solver_type = SOLVER_AUTO;
+        else if (strcmp(value, "dense") == 0) ctx->solver_type = SOLVER_DENSE;
+        else if (strcmp(value, "sparse") == 0) ctx->solver_type = SOLVER_SPARSE;
+        else if (strcmp(value, "pcg") == 0) ctx->solver_type = SOLVER_PCG;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid solver %s", value);
+    } else if (strcmp(name, "precond") == 0) {
+        if (strcmp(value, "block") == 0) ctx->preconditioner = PRECOND_BLOCK_JACOBI;
+        else if (strcmp(value, "jacobi") == 0) ctx->preconditioner = PRECOND_JACOBI;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid preconditioner %s", value);
+    } else if (strcmp(name, "tol") == 0) {
+        double tolerance = atof(value);
+        if (!(tolerance > 0.0)) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid tolerance %s", value);
+        ctx->pcg_tolerance = tolerance;
+    } else if (strcmp(name, "max-iter") == 0) {
+        int iterations = atoi(value);
+        if (iterations < 1) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid iteration cap %s", value);
+        ctx->pcg_max_iterations = iterations;
+    } else if (strcmp(name, "threads") == 0) {
+        int threads = atoi(value);
+        if (threads < 1) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid thread count %s", value);
+        ctx->n_threads = threads;
+    } else if (strcmp(name, "reorder") == 0) {
+        if (strcmp(value, "rcm") == 0) ctx->reorder = 1;
+        else if (strcmp(value, "none") == 0) ctx->reorder = 0;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid reordering %s", value);
+    } else if (strcmp(name, "precision") == 0) {
+        if (strcmp(value, "double") == 0) ctx->mixed_precision = 0;
+        else if (strcmp(value, "mixed") == 0) ctx->mixed_precision = 1;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid precision %s", value);
+    } else if (strcmp(name, "analysis") == 0) {
+        if (strcmp(value, "linear") != 0 && strcmp(value, "nonlinear") != 0 && strcmp(value, "modal") != 0) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid analysis %s", value);
+        }
+        ctx->nonlinear = strcmp(value, "nonlinear") == 0;
+        ctx->modal = strcmp(value, "modal") == 0;
+    } else if (strcmp(name, "steps") == 0) {
+        int steps = atoi(value);
+        if (steps < 1) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid number of load steps %s", value);
+        ctx->load_steps = steps;
+    } else if (strcmp(name, "newton") == 0) {
+        if (strcmp(value, "full") == 0) ctx->modified_newton = 0;
+        else if (strcmp(value, "modified") == 0) ctx->modified_newton = 1;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid Newton method %s", value);
+    } else if (strcmp(name, "line-search") == 0) {
+        if (strcmp(value, "0") != 0 && strcmp(value, "1") != 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid line search setting %s", value);
+        ctx->line_search = value[0] == '1';
+    } else if (strcmp(name, "nl-tol") == 0) {
+        double tolerance = atof(value);
+        if (!(tolerance > 0.0)) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid tolerance %s", value);
+        ctx->newton_tolerance = tolerance;
+    } else if (strcmp(name, "nl-max-iter") == 0) {
+        int iterations = atoi(value);
+        if (iterations < 1) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid iteration cap %s", value);
+        ctx->newton_max_iterations = iterations;
+    } else if (strcmp(name, "modes") == 0) {
+        int modes = atoi(value);
+        if (modes < 1) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid number of modes %s", value);
+        ctx->requested_modes = modes;
+    } else if (strcmp(name, "mass") == 0) {
+        if (strcmp(value, "lumped") == 0) ctx->consistent_mass = 0;
+        else if (strcmp(value, "consistent") == 0) ctx->consistent_mass = 1;
+        else return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid mass matrix %s", value);
+    } else if (strcmp(name, "density") == 0) {
+        double density = atof(value);
+        if (!(density > 0.0)) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid density %s", value);
+        ctx->density = density;
+    } else if (strcmp(name, "condense") == 0) {
+        if (strcmp(value, "0") != 0 && strcmp(value, "1") != 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid condense setting %s", value);
+        // The stiffness pattern couples instance boundaries only when condensing
+        if (ctx->condense != (value[0] == '1') && ctx->n_instances > 0) reset_results(ctx);
+        ctx->condense = value[0] == '1';
+    } else if (strcmp(name, "memory-budget") == 0) {
+        double megabytes = atof(value);
+        if (!(megabytes >= 0.0)) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid memory budget %s", value);
+        ctx->memory_budget = (long long)(megabytes * 1e6);
+    } else if (strcmp(name, "scratch-dir") == 0) {
+        if (strlen(value) >= sizeof(ctx->scratch_dir)) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Scratch directory name is too long");
+        }
+        snprintf(ctx->scratch_dir, sizeof(ctx->scratch_dir), "%s", value);
+    } else if (strcmp(name, "profile") == 0) {
+        if (strcmp(value, "0") != 0 && strcmp(value, "1") != 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid profile setting %s", value);
+        ctx->profile = value[0] == '1';
+    } else if (strcmp(name, "decimals") == 0) {
+        int decimals = atoi(value);
+        if (decimals < 1 || decimals > 12) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid decimal places %s", value);
+        ctx->decimal_places = decimals;
+    } else {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Unknown option %s", name);
+    }
+    return TRUSS_OK;
+}
+
+void truss_set_streams(TrussContext *ctx, FILE *log, FILE *diagnostics) {
+    ctx->log_stream = log;
+    ctx->diag_stream = diagnostics;
+}
+
+// The model arrays are allocated outside the arenas; the read phase
+// counts them as they end up
+int truss_load_file(TrussContext *ctx, const char *filename) {
+    ProfileClock start = profile_clock(ctx);
+    reset_model(ctx);
+    int status = read_input(ctx, filename);
+    if (status != TRUSS_OK) reset_model(ctx);
+    memset(ctx->phase_profile, 0, sizeof(ctx->phase_profile));
+    profile_phase(ctx, TRUSS_PHASE_READ, start, profile_clock(ctx));
+    ctx->phase_profile[TRUSS_PHASE_READ].allocated += model_bytes(ctx);
+    return status;
+}
+
+int truss_load_text(TrussContext *ctx, const char *text, size_t length) {
+    ProfileClock start = profile_clock(ctx);
+    reset_model(ctx);
+    int status = read_csv(ctx, text, length);
+    if (status != TRUSS_OK) reset_model(ctx);
+    memset(ctx->phase_profile, 0, sizeof(ctx->phase_profile));
+    profile_phase(ctx, TRUSS_PHASE_READ, start, profile_clock(ctx));
+    ctx->phase_profile[TRUSS_PHASE_READ].allocated += model_bytes(ctx);
+    return status;
+}
+
+int truss_set_nodes(TrussContext *ctx, int n_nodes, const int *ids, const double *xyz,
+                    const int *constraints, const double *loads) {
+    if (n_nodes < 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node count %d", n_nodes);
+    reset_model(ctx);
+    ctx->nodes = malloc((n_nodes > 0 ? n_nodes : 1) * sizeof(Node));
+    ctx->members = malloc(sizeof(Member));
+    ctx->case_loads = malloc(sizeof(NodeLoad));
+    ctx->load_cases = malloc(sizeof(LoadCase));
+    if (!ctx->nodes || !ctx->members || !ctx->case_loads || !ctx->load_cases) {
+        reset_model(ctx);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory storing nodes");
+    }
+    for (int i = 0; i < n_nodes; i++) {
+        Node *n = &ctx->nodes[i];
+        n->id = ids[i];
+        n->x = xyz[3*i];
+        n->y = xyz[3*i + 1];
+        n->z = xyz[3*i + 2];
+        for (int d = 0; d < 3; d++) {
+            n->constraints[d] = constraints[3*i + d] != 0;
+            n->loads[d] = loads ? loads[3*i + d] : 0.0;
+        }
+    }
+    ctx->n_nodes = n_nodes;
+    ctx->total_dofs = 3 * n_nodes;
+    
+    int duplicate = build_node_index(ctx);
+    if (duplicate != -1) {
+        int status = duplicate == -2
+            ? set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory indexing nodes")
+            : set_error(ctx, TRUSS_ERROR_INVALID, "Duplicate node ID %d", ctx->nodes[duplicate].id);
+        reset_model(ctx);
+        return status;
+    }
+    update_load_cases(ctx);
+    return TRUSS_OK;
+}
+
+int truss_set_members(TrussContext *ctx, int n_members, const int *ids, const int *node_ids,
+                      const double *E, const double *A) {
+    if (!ctx->node_index) return set_error(ctx, TRUSS_ERROR_STATE, "Members need nodes to be set first");
+    if (n_members < 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid member count %d", n_members);
+    Member *members = malloc((n_members > 0 ? n_members : 1) * sizeof(Member));
+    if (!members) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory storing members");
+    for (int m = 0; m < n_members; m++) {
+        members[m].id = ids[m];
+        members[m].node1 = find_node_index(ctx, node_ids[2*m]);
+        members[m].node2 = find_node_index(ctx, node_ids[2*m + 1]);
+        members[m].E = E[m];
+        members[m].A = A[m];
+        if (members[m].node1 == -1 || members[m].node2 == -1) {
+            free(members);
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID in member %d (nodes: %d->%d)",
+                             ids[m], node_ids[2*m], node_ids[2*m + 1]);
+        }
+    }
+    reset_results(ctx);
+    reset_variants(ctx);
+    reset_substructures(ctx);
+    free(ctx->members);
+    free(ctx->member_index);
+    ctx->members = members;
+    ctx->n_members = n_members;
+    ctx->member_index = NULL;
+    return TRUSS_OK;
+}
+
+int truss_add_load_case(TrussContext *ctx, const char *name, int n_loads,
+                        const int *node_ids, const double *loads) {
+    if (!ctx->node_index) return set_error(ctx, TRUSS_ERROR_STATE, "Load cases need nodes to be set first");
+    if (n_loads < 0) return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid load count %d", n_loads);
+    for (int l = 0; l < n_loads; l++) {
+        if (find_node_index(ctx, node_ids[l]) == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID %d in load case \"%s\"",
+                             node_ids[l], name ? name : "");
+        }
+    }
+    // Keep room for the node-load case that update_load_cases may insert
+    LoadCase *load_cases = realloc(ctx->load_cases, (ctx->n_load_cases + 2) * sizeof(LoadCase));
+    if (load_cases) ctx->load_cases = load_cases;
+    NodeLoad *case_loads = realloc(ctx->case_loads, (ctx->n_case_loads + n_loads + 1) * sizeof(NodeLoad));
+    if (case_loads) ctx->case_loads = case_loads;
+    if (!load_cases || !case_loads) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory storing load case");
+    
+    reset_solution(ctx);
+    int c = ctx->n_load_cases++;
+    if (name && name[0]) {
+        snprintf(ctx->load_cases[c].name, sizeof(ctx->load_cases[c].name), "%s", name);
+    } else {
+        snprintf(ctx->load_cases[c].name, sizeof(ctx->load_cases[c].name), "Case %d",
+                 ctx->n_load_cases - (ctx->node_loads_case == 0));
+    }
+    for (int l = 0; l < n_loads; l++) {
+        NodeLoad *nl = &ctx->case_loads[ctx->n_case_loads++];
+        nl->load_case = c;
+        nl->node = find_node_index(ctx, node_ids[l]);
+        for (int d = 0; d < 3; d++) nl->loads[d] = loads[3*l + d];
+    }
+    update_load_cases(ctx);
+    return TRUSS_OK;
+}
+
+// Change member m's E and A. Once the stiffness is assembled, the change
+// in axial stiffness is scattered into K_global in place; the solver
+// picks it up as a low-rank update of the cached factorization. A new
+// factorization reassembles K_global first, so a member set to zero
+// stiffness leaves an exact zero rather than round-off.
+void set_member_properties(TrussContext *ctx, int m, double E, double A) {
+    ctx->members[m].E = E;
+    ctx->members[m].A = A;
+    MemberGeometry *g = ctx->member_geometry;
+    if (!g) return;
+    g->ea[m] = E * A;
+    g->area[m] = A;
+    double stiffness = g->ea[m] / g->length[m];
+    if (stiffness != g->stiffness[m]) {
+        scatter_member_stiffness(ctx, m, stiffness - g->stiffness[m]);
+        g->stiffness[m] = stiffness;
+        ctx->stiffness_updated = 1;
+    }
+}
+
+int truss_set_member_properties(TrussContext *ctx, int n_members, const int *ids,
+                                const double *E, const double *A) {
+    for (int k = 0; k < n_members; k++) {
+        if (find_member_index(ctx, ids[k]) == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid member ID %d", ids[k]);
+        }
+    }
+    for (int k = 0; k < n_members; k++) {
+        set_member_properties(ctx, find_member_index(ctx, ids[k]), E[k], A[k]);
+    }
+    reset_solution(ctx);
+    return TRUSS_OK;
+}
+
+int truss_set_node_loads(TrussContext *ctx, int n_loads, const int *node_ids, const double *loads) {
+    if (!ctx->node_index) return set_error(ctx, TRUSS_ERROR_STATE, "No model loaded");
+    for (int l = 0; l < n_loads; l++) {
+        if (find_node_index(ctx, node_ids[l]) == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID %d", node_ids[l]);
+        }
+    }
+    for (int l = 0; l < n_loads; l++) {
+        Node *n = &ctx->nodes[find_node_index(ctx, node_ids[l])];
+        for (int d = 0; d < 3; d++) n->loads[d] = loads[3*l + d];
+    }
+    reset_solution(ctx);
+    update_load_cases(ctx);
+    return TRUSS_OK;
+}
+
+int truss_set_load_case_loads(TrussContext *ctx, int load_case, int n_loads,
+                              const int *node_ids, const double *loads) {
+    if (load_case < 0 || load_case >= ctx->n_load_cases || load_case == ctx->node_loads_case) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid load case %d", load_case);
+    }
+    for (int l = 0; l < n_loads; l++) {
+        if (find_node_index(ctx, node_ids[l]) == -1) {
+            return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid node ID %d in load case \"%s\"",
+                             node_ids[l], ctx->load_cases[load_case].name);
+        }
+    }
+    int kept = 0;
+    for (int l = 0; l < ctx->n_case_loads; l++) {
+        if (ctx->case_loads[l].load_case != load_case) ctx->case_loads[kept++] = ctx->case_loads[l];
+    }
+    ctx->n_case_loads = kept;
+    NodeLoad *case_loads = realloc(ctx->case_loads, (kept + n_loads + 1) * sizeof(NodeLoad));
+    if (!case_loads) return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory storing load case");
+    ctx->case_loads = case_loads;
+    for (int l = 0; l < n_loads; l++) {
+        NodeLoad *nl = &ctx->case_loads[ctx->n_case_loads++];
+        nl->load_case = load_case;
+        nl->node = find_node_index(ctx, node_ids[l]);
+        for (int d = 0; d < 3; d++) nl->loads[d] = loads[3*l + d];
+    }
+    reset_solution(ctx);
+    return TRUSS_OK;
+}
+
+int truss_update_model(TrussContext *ctx, const TrussContext *source) {
+    int same = ctx->nodes && ctx->n_nodes == source->n_nodes && ctx->n_members == source->n_members;
+    for (int i = 0; i < ctx->n_nodes && same; i++) {
+        const Node *a = &ctx->nodes[i];
+        const Node *b = &source->nodes[i];
+        same = a->id == b->id && a->x == b->x && a->y == b->y && a->z == b->z &&
+               !a->constraints[0] == !b->constraints[0] && !a->constraints[1] == !b->constraints[1] &&
+               !a->constraints[2] == !b->constraints[2];
+    }
+    for (int m = 0; m < ctx->n_members && same; m++) {
+        const Member *a = &ctx->members[m];
+        const Member *b = &source->members[m];
+        same = a->id == b->id && a->node1 == b->node1 && a->node2 == b->node2;
+    }
+    if (!same) return set_error(ctx, TRUSS_ERROR_INVALID, "The models differ in more than loads and member properties");
+    
+    LoadCase *load_cases = malloc((source->n_load_cases + 1) * sizeof(LoadCase));
+    NodeLoad *case_loads = malloc((source->n_case_loads + 1) * sizeof(NodeLoad));
+    if (!load_cases || !case_loads) {
+        free(load_cases);
+        free(case_loads);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory storing load cases");
+    }
+    memcpy(load_cases, source->load_cases, source->n_load_cases * sizeof(LoadCase));
+    memcpy(case_loads, source->case_loads, source->n_case_loads * sizeof(NodeLoad));
+    free(ctx->load_cases);
+    free(ctx->case_loads);
+    ctx->load_cases = load_cases;
+    ctx->case_loads = case_loads;
+    ctx->n_load_cases = source->n_load_cases;
+    ctx->n_case_loads = source->n_case_loads;
+    ctx->node_loads_case = source->node_loads_case;
+    for (int i = 0; i < ctx->n_nodes; i++) {
+        memcpy(ctx->nodes[i].loads, source->nodes[i].loads, sizeof(ctx->nodes[i].loads));
+    }
+    for (int m = 0; m < ctx->n_members; m++) {
+        set_member_properties(ctx, m, source->members[m].E, source->members[m].A);
+    }
+    reset_solution(ctx);
+    return TRUSS_OK;
+}
+
+int truss_solve(TrussContext *ctx) {
+    if (!ctx->nodes) return set_error(ctx, TRUSS_ERROR_STATE, "No model loaded");
+#ifdef _OPENMP
+    if (ctx->n_threads > 0) omp_set_num_threads(ctx->n_threads);
+#endif
+    for (int p = TRUSS_PHASE_ASSEMBLE; p <= TRUSS_PHASE_MEMBER_FORCES; p++) {
+        memset(&ctx->phase_profile[p], 0, sizeof(TrussPhaseProfile));
+    }
+    
+    // The stiffness is assembled once per model; member property
+    // changes are applied to it in place
+    ProfileClock start = profile_clock(ctx);
+    int status = ctx->member_geometry ? TRUSS_OK : assemble_global_stiffness(ctx);
+    reset_solution(ctx);
+    if (status == TRUSS_OK) status = assemble_loads(ctx);
+    if (status == TRUSS_OK && ctx->modal) status = assemble_mass(ctx);
+    ProfileClock assembled = profile_clock(ctx);
+    profile_phase(ctx, TRUSS_PHASE_ASSEMBLE, start, assembled);
+    
+    // Factorization inside counts as TRUSS_PHASE_REDUCE
+    if (status == TRUSS_OK) {
+        status = ctx->nonlinear ? solve_nonlinear(ctx) : ctx->modal ? solve_modal(ctx) : apply_boundary_conditions(ctx);
+    }
+    ProfileClock solved = profile_clock(ctx);
+    const TrussPhaseProfile *reduce = &ctx->phase_profile[TRUSS_PHASE_REDUCE];
+    assembled.wall += reduce->wall_time;
+    assembled.cpu += reduce->cpu_time;
+    assembled.allocated += reduce->allocated;
+    profile_phase(ctx, TRUSS_PHASE_SOLVE, assembled, solved);
+    if (status != TRUSS_OK) {
+        reset_solution(ctx);
+        return status;
+    }
+    if (ctx->modal) return TRUSS_OK;
+    if (ctx->profile && !ctx->nonlinear) record_residual(ctx);
+    status = compute_reactions(ctx);
+    ProfileClock reactions = profile_clock(ctx);
+    profile_phase(ctx, TRUSS_PHASE_REACTIONS, solved, reactions);
+    if (status == TRUSS_OK) status = compute_member_forces(ctx);
+    profile_phase(ctx, TRUSS_PHASE_MEMBER_FORCES, reactions, profile_clock(ctx));
+    if (status != TRUSS_OK) reset_solution(ctx);
+    return status;
+}
+
+int truss_write_results(TrussContext *ctx, const char *filename, const char *format) {
+    if (!ctx->displacements && !ctx->modes) return set_error(ctx, TRUSS_ERROR_STATE, "No results to write; solve first");
+    ProfileClock start = profile_clock(ctx);
+    int status;
+    if (strcmp(format, "binary") == 0) {
+        if (!filename) return set_error(ctx, TRUSS_ERROR_INVALID, "Binary results need an output file");
+        if (ctx->modes) return set_error(ctx, TRUSS_ERROR_INVALID, "Modal results cannot be written as binary");
+        status = write_binary(ctx, filename);
+    } else if (strcmp(format, "table") == 0) {
+        status = write_results(ctx, filename, FORMAT_TABLE);
+    } else if (strcmp(format, "csv") == 0) {
+        status = write_results(ctx, filename, FORMAT_CSV);
+    } else if (strcmp(format, "tsv") == 0) {
+        status = write_results(ctx, filename, FORMAT_TSV);
+    } else {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid results format %s", format);
+    }
+    memset(&ctx->phase_profile[TRUSS_PHASE_OUTPUT], 0, sizeof(TrussPhaseProfile));
+    profile_phase(ctx, TRUSS_PHASE_OUTPUT, start, profile_clock(ctx));
+    return status;
+}
+
+double truss_phase_time(const TrussContext *ctx, int phase) {
+    return phase >= 0 && phase < TRUSS_PHASE_COUNT ? ctx->phase_profile[phase].wall_time : 0.0;
+}
+
+const TrussPhaseProfile *truss_phase_profile(const TrussContext *ctx, int phase) {
+    return phase >= 0 && phase < TRUSS_PHASE_COUNT ? &ctx->phase_profile[phase] : NULL;
+}
+
+int truss_step_count(const TrussContext *ctx) {
+    return ctx->n_step_reports;
+}
+
+const TrussStepReport *truss_step_reports(const TrussContext *ctx) {
+    return ctx->n_step_reports > 0 ? ctx->step_reports : NULL;
+}
+
+int truss_mode_count(const TrussContext *ctx) {
+    return ctx->n_modes;
+}
+
+const TrussMode *truss_modes(const TrussContext *ctx) {
+    return ctx->n_modes > 0 ? ctx->modes : NULL;
+}
+
+const double *truss_mode_shapes(const TrussContext *ctx) {
+    return ctx->n_modes > 0 ? ctx->mode_shapes : NULL;
+}
+
+const TrussSolverStats *truss_solver_stats(const TrussContext *ctx) {
+    return &ctx->solver.stats;
+}
+
+int truss_write_profile(TrussContext *ctx, const char *filename, const char *format) {
+    int json = strcmp(format, "json") == 0;
+    if (!json && strcmp(format, "table") != 0) {
+        return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid profile format %s", format);
+    }
+    FILE *file = filename ? fopen(filename, "w") : stderr;
+    if (!file) return set_error(ctx, TRUSS_ERROR_IO, "Could not open profile file %s", filename);
+    int status = json ? write_profile_json(ctx, file) : write_profile_table(ctx, file);
+    if (filename) {
+        if (fclose(file) != 0 && status == TRUSS_OK) {
+            status = set_error(ctx, TRUSS_ERROR_IO, "Could not write profile file %s", filename);
+        }
+    } else {
+        fflush(file);
+    }
+    return status;
+}
+
+const char *truss_phase_name(int phase) {
+    static const char *names[TRUSS_PHASE_COUNT] = {
+        "read", "assemble", "reduce", "solve", "reactions", "member_forces", "output"
+    };
+    return phase >= 0 && phase < TRUSS_PHASE_COUNT ? names[phase] : "";
+}
+
+int truss_node_count(const TrussContext *ctx) {
+    return ctx->n_nodes;
+}
+
+int truss_member_count(const TrussContext *ctx) {
+    return ctx->n_members;
+}
+
+int truss_load_case_count(const TrussContext *ctx) {
+    return ctx->n_load_cases;
+}
+
+const char *truss_load_case_name(const TrussContext *ctx, int load_case) {
+    if (load_case < 0 || load_case >= ctx->n_load_cases) return NULL;
+    return ctx->load_cases[load_case].name;
+}
+
+int truss_node_loads_case(const TrussContext *ctx) {
+    return ctx->node_loads_case;
+}
+
+const TrussNode *truss_nodes(const TrussContext *ctx) {
+    return ctx->nodes;
+}
+
+const TrussMember *truss_members(const TrussContext *ctx) {
+    return ctx->members;
+}
+
+const double *truss_displacements(const TrussContext *ctx) {
+    return ctx->displacements;
+}
+
+const double *truss_reactions(const TrussContext *ctx) {
+    return ctx->reactions;
+}
+
+const double *truss_equilibrium(const TrussContext *ctx) {
+    return ctx->equilibrium;
+}
+
+const TrussMemberResult *truss_member_results(const TrussContext *ctx) {
+    return ctx->member_results;
+}
+
+int truss_load_variants(TrussContext *ctx, const char *filename) {
+    if (!ctx->node_index) return set_error(ctx, TRUSS_ERROR_STATE, "Variants need a model to be loaded first");
+    reset_variants(ctx);
+    const char *data;
+    size_t size;
+    int status = map_input(ctx, filename, &data, &size);
+    if (status != TRUSS_OK) return status;
+    status = read_variants(ctx, data, size);
+    unmap_input(data, size);
+    if (status != TRUSS_OK) reset_variants(ctx);
+    return status;
+}
+
+int truss_load_substructures(TrussContext *ctx, const char *filename) {
+    if (!ctx->node_index) return set_error(ctx, TRUSS_ERROR_STATE, "Substructures need a model to be loaded first");
+    if (ctx->n_instances > 0) {
+        return set_error(ctx, TRUSS_ERROR_STATE, "Substructures are already loaded; reload the model first");
+    }
+    const char *data;
+    size_t size;
+    int status = map_input(ctx, filename, &data, &size);
+    if (status != TRUSS_OK) return status;
+    status = read_substructures(ctx, data, size);
+    unmap_input(data, size);
+    return status;
+}
+
+int truss_solve_variants(TrussContext *ctx) {
+    if (ctx->n_variants == 0) return set_error(ctx, TRUSS_ERROR_STATE, "No variants loaded");
+    if (ctx->modal) return set_error(ctx, TRUSS_ERROR_INVALID, "Variant studies need a static analysis, not modal");
+    double start_time = wall_time();
+    reset_variant_results(ctx);
+    ctx->variant_summaries = calloc(ctx->n_variants, sizeof(TrussVariantSummary));
+    ctx->variant_errors = calloc(ctx->n_variants, sizeof(char *));
+    
+    int n_workers = 1;
+#ifdef _OPENMP
+    n_workers = ctx->n_threads > 0 ? ctx->n_threads : omp_get_max_threads();
+#endif
+    if (n_workers > ctx->n_variants) n_workers = ctx->n_variants;
+    VariantQueue *queues = malloc(n_workers * sizeof(VariantQueue));
+    if (!ctx->variant_summaries || !ctx->variant_errors || !queues) {
+        free(queues);
+        reset_variant_results(ctx);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory analyzing variants");
+    }
+    
+    // Each worker starts with a contiguous block of variants
+    for (int k = 0; k < n_workers; k++) {
+        queues[k].head = (int)((long long)ctx->n_variants * k / n_workers);
+        queues[k].tail = (int)((long long)ctx->n_variants * (k + 1) / n_workers);
+#ifdef _OPENMP
+        omp_init_lock(&queues[k].lock);
+#endif
+    }
+    
+    int failed = 0;
+    #pragma omp parallel num_threads(n_workers)
+    {
+        int self = 0;
+#ifdef _OPENMP
+        self = omp_get_thread_num();
+#endif
+        BatchWorker worker = {truss_create(), -1, 0, 0};
+        if (!worker.ctx || copy_model(worker.ctx, ctx) != TRUSS_OK) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        #pragma omp barrier
+        if (!failed) {
+            // Parallelism is across variants; each one solves serially
+            worker.ctx->n_threads = 1;
+            int v;
+            while ((v = take_variant(queues, n_workers, self)) >= 0) {
+                analyze_variant(ctx, &worker, v);
+            }
+        }
+        truss_destroy(worker.ctx);
+    }
+    
+#ifdef _OPENMP
+    for (int k = 0; k < n_workers; k++) omp_destroy_lock(&queues[k].lock);
+#endif
+    free(queues);
+    if (failed) {
+        reset_variant_results(ctx);
+        return set_error(ctx, TRUSS_ERROR_MEMORY, "Out of memory analyzing variants");
+    }
+    
+    int n_failed = 0;
+    for (int v = 0; v < ctx->n_variants; v++) {
+        if (ctx->variant_summaries[v].status == TRUSS_OK) continue;
+        n_failed++;
+        log_warning(ctx, "Warning: Variant \"%s\": %s\n", ctx->variants[v].name,
+                    ctx->variant_errors[v] ? ctx->variant_errors[v] : "Out of memory");
+    }
+    double elapsed = wall_time() - start_time;
+    log_warning(ctx, "Analyzed %d variants in %.3f s (%.1f variants/s, %d threads)\n",
+                ctx->n_variants, elapsed, elapsed > 0.0 ? ctx->n_variants / elapsed : 0.0, n_workers);
+    log_message(ctx, "Analyzed %d variants, %d failed\n", ctx->n_variants, n_failed);
+    return TRUSS_OK;
+}
+
+int truss_write_variant_summary(TrussContext *ctx, const char *filename, const char *format) {
+    if (!ctx->variant_summaries) return set_error(ctx, TRUSS_ERROR_STATE, "No variant results to write; solve the variants first");
+    if (strcmp(format, "table") == 0) return write_variant_summary(ctx, filename, FORMAT_TABLE);
+    if (strcmp(format, "csv") == 0) return write_variant_summary(ctx, filename, FORMAT_CSV);
+    if (strcmp(format, "tsv") == 0) return write_variant_summary(ctx, filename, FORMAT_TSV);
+    return set_error(ctx, TRUSS_ERROR_INVALID, "Invalid variant summary format %s", format);
+}
+
+int truss_variant_count(const TrussContext *ctx) {
+    return ctx->n_variants;
+}
+
+const char *truss_variant_name(const TrussContext *ctx, int variant) {
+    if (variant < 0 || variant >= ctx->n_variants) return NULL;
+    return ctx->variants[variant].name;
+}
+
+const TrussVariantSummary *truss_variant_summaries(const TrussContext *ctx) {
+    return ctx->variant_summaries;
+}